@@ -0,0 +1,562 @@
+// 图书馆核心操作基准测试
+// 用法: benchmark [--max <最大规模>] [--min <最小规模>] [--output <结果文件>]
+// 规模从min开始按10倍递增到max(默认10^3到10^6，可设到10^7)，每个规模生成同样数量的书籍与读者，
+// 依次测量各项操作(含书名检索、欠费查询、逾期结算、读者在借查询、报表导出与删除书籍)，批量借还每批256条计一次，每项输出一行JSON：吞吐、延迟分位数与进程峰值内存
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "library.h"
+#include "report_writer.h"
+
+using Clock = std::chrono::steady_clock;
+
+// 进程峰值内存(KB)
+static std::uint64_t peakMemoryKB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize / 1024;
+    }
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::uint64_t>(usage.ru_maxrss);
+#endif
+}
+
+// 单项操作的计时结果
+class OpStats {
+private:
+    static constexpr std::size_t kMaxSamples = 1 << 20;
+
+    std::vector<std::uint32_t> samples;  // 抽样的单次延迟(纳秒)
+    std::size_t stride;
+    std::size_t count = 0;
+    double seconds = 0;
+
+public:
+    // expected为预计操作次数，超过kMaxSamples时按固定步长抽样
+    explicit OpStats(std::size_t expected)
+        : stride(std::max<std::size_t>(1, expected / kMaxSamples)) {
+        samples.reserve(std::min(expected, kMaxSamples) + 1);
+    }
+
+    // 计时执行一次操作
+    template <typename F>
+    void measure(F&& f) {
+        auto start = Clock::now();
+        f();
+        auto elapsed = Clock::now() - start;
+        seconds += std::chrono::duration<double>(elapsed).count();
+        if (count++ % stride == 0) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+            samples.push_back(static_cast<std::uint32_t>(std::min<long long>(ns, UINT32_MAX)));
+        }
+    }
+
+    void report(std::ostream& os, std::size_t size, const char* op) {
+        std::sort(samples.begin(), samples.end());
+        auto pct = [&](double p) -> std::uint32_t {
+            if (samples.empty()) return 0;
+            return samples[std::min(samples.size() - 1, static_cast<std::size_t>(p * samples.size()))];
+        };
+        os << "{\"size\":" << size
+           << ",\"op\":\"" << op << "\""
+           << ",\"ops\":" << count
+           << ",\"seconds\":" << seconds
+           << ",\"opsPerSec\":" << (seconds > 0 ? count / seconds : 0)
+           << ",\"p50Ns\":" << pct(0.50)
+           << ",\"p90Ns\":" << pct(0.90)
+           << ",\"p99Ns\":" << pct(0.99)
+           << ",\"maxNs\":" << (samples.empty() ? 0 : samples.back())
+           << ",\"peakMemKB\":" << peakMemoryKB() << "}\n";
+        os.flush();
+    }
+};
+
+static std::string makeIsbn(std::size_t i) {
+    return std::to_string(i) + "-" + std::to_string(i % 97) + "-" + std::to_string(i % 13) + "-X";
+}
+
+// 批量导入的ISBN规则检查：校验和正确但格式不是n-n-n-x的行在任何规则下都应在解析阶段被拒绝，
+// 合并时不抛出异常，被拒绝的行都记入错误；多出一列的行按字段数错误拒绝
+static bool checkImportPolicies() {
+    constexpr std::string_view csv =
+        "0306406152,ISBN-10无连字符,作者,2000,1\n"
+        "978-0-306-40615-7,ISBN-13五段,作者,2000,1\n"
+        "0-306-406152,ISBN-10两段,作者,2000,1\n"
+        "0-306-40615-2,ISBN-10格式正确,作者,2000,1\n"
+        "978-0-30640615-7,ISBN-13格式正确,作者,2000,1\n"
+        "0-306-40615-2,多一列,作者,2000,1,附加\n";
+    const std::pair<IsbnPolicy, std::size_t> cases[] = {
+        {IsbnPolicy::format, 2}, {IsbnPolicy::isbn10, 1}, {IsbnPolicy::isbn13, 1}, {IsbnPolicy::checksum, 2}};
+    for (auto [policy, expected] : cases) {
+        Library lib;
+        ImportOptions options;
+        options.isbnPolicy = policy;
+        try {
+            auto batch = parseBookRecords(csv, options);
+            if (lib.addBooks(batch.rows, batch.errors) != expected || lib.getBooks().size() != expected ||
+                batch.errors.size() != 6 - expected) {
+                return false;
+            }
+            if (std::none_of(batch.errors.begin(), batch.errors.end(), [](const ImportError& e) {
+                    return e.line == 6 && e.reason == import_detail::fieldCountError("5", 6);
+                })) {
+                return false;
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 字符串池复用检查：重复加入被拒绝、删除后重新加入同一本书，都不应增加字符串池的占用
+static bool checkPoolReuse() {
+    Library lib;
+    auto make = [] { return Book("12345678901234-5-6-X", "池复用检查", "池复用作者", 2000, Genre::fiction); };
+    lib.addBook(make());
+    std::size_t before = StringPool::global().bytesUsed();
+    for (int r = 0; r < 1000; ++r) {
+        try {
+            lib.addBook(make());
+            return false;
+        } catch (const std::exception&) {
+        }
+        lib.removeBook("12345678901234-5-6-X");
+        lib.addBook(make());
+    }
+    return StringPool::global().bytesUsed() == before;
+}
+
+// 句柄复用检查：同一槽位反复删除再插入超过256次，旧句柄都不应重新生效，新句柄也不应与旧句柄重复
+static bool checkHandleReuse() {
+    SlotMap<int> map;
+    std::vector<SlotHandle> dead;
+    for (int r = 0; r < 1000; ++r) {
+        SlotHandle h = map.emplace(r);
+        if (std::find(dead.begin(), dead.end(), h) != dead.end()) return false;
+        map.erase(h);
+        dead.push_back(h);
+    }
+    for (SlotHandle h : dead) {
+        if (map.contains(h)) return false;
+    }
+    return map.size() == 0;
+}
+
+// 对一个规模运行全部测量
+static void runSize(std::size_t n, std::ostream& os) {
+    Library lib;
+    const Genre genres[] = {Genre::fiction, Genre::nonfiction, Genre::periodical,
+                            Genre::biography, Genre::children};
+
+    // 预先生成数据，避免把字符串构造计入操作耗时
+    std::vector<std::string> isbns(n);
+    for (std::size_t i = 0; i < n; ++i) isbns[i] = makeIsbn(i);
+
+    {
+        OpStats stats(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            Book book(isbns[i], "书名" + std::to_string(i), "作者" + std::to_string(i % 5000),
+                      1900 + static_cast<int>(i % 120), genres[i % 5]);
+            stats.measure([&] { lib.addBook(book); });
+        }
+        stats.report(os, n, "addBook");
+    }
+
+    {
+        OpStats stats(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            Patron patron("读者" + std::to_string(i), static_cast<int>(i + 1));
+            // 1%的读者有欠费
+            if (i % 100 == 0) patron.setFees(5.0);
+            stats.measure([&] { lib.addPatron(patron); });
+        }
+        stats.report(os, n, "addPatron");
+    }
+
+    // 一半的书借给无欠费的读者
+    Date today(2024, 6, 1);
+    std::size_t loans = n / 2;
+    {
+        OpStats stats(loans);
+        for (std::size_t i = 0; i < loans; ++i) {
+            int card = static_cast<int>(i % 100 == 0 ? i + 2 : i + 1);
+            stats.measure([&] { lib.checkOutBook(isbns[i], card, today); });
+        }
+        stats.report(os, n, "checkOutBook");
+    }
+
+    {
+        constexpr int kRounds = 5;
+        OpStats stats(kRounds);
+        for (int r = 0; r < kRounds; ++r) {
+            stats.measure([&] {
+                std::size_t debtors = 0;
+                lib.forEachDebtor([&](const Patron&, Cents) { ++debtors; });
+                if (debtors != (n + 99) / 100) std::cerr << "欠费读者数量异常\n";
+            });
+        }
+        stats.report(os, n, "listDebtors");
+    }
+
+    {
+        constexpr int kRounds = 3;
+        OpStats books(kRounds), patrons(kRounds), transactions(kRounds);
+        std::size_t checksum = 0;
+        for (int r = 0; r < kRounds; ++r) {
+            books.measure([&] {
+                lib.forEachBook([&](const Book& b) { checksum += b.getCheckoutStatus(); });
+            });
+            patrons.measure([&] {
+                lib.forEachPatron([&](const Patron& p) { checksum += p.getCardNumber(); });
+            });
+            transactions.measure([&] {
+                lib.forEachTransaction([&](const Transaction& t, const Book&, const Patron&) {
+                    checksum += t.book;
+                });
+            });
+        }
+        books.report(os, n, "listBooks");
+        patrons.report(os, n, "listPatrons");
+        transactions.report(os, n, "listTransactions");
+        if (checksum == 0) std::cerr << "遍历结果异常\n";
+    }
+
+    {
+        // 全部借阅记录导出为CSV(写入临时文件)
+        OpStats stats(1);
+        std::string path = (std::filesystem::temp_directory_path() / "library_benchmark_export.csv").string();
+        ExportSummary summary;
+        stats.measure([&] {
+            std::ofstream file(path, std::ios::binary);
+            OutputBuffer buffer(file);
+            summary = ReportExporter(lib, buffer, ExportFormat::csv).run(ExportKind::transactions);
+        });
+        stats.report(os, n, "exportTransactions");
+        std::filesystem::remove(path);
+        if (summary.rows != loans) std::cerr << "导出结果异常\n";
+    }
+
+    {
+        constexpr std::size_t kQueries = 1000;
+        OpStats stats(kQueries);
+        std::size_t found = 0;
+        for (std::size_t q = 0; q < kQueries; ++q) {
+            std::string keyword = "书名" + std::to_string(q * 7919 % n);
+            stats.measure([&] {
+                lib.searchBooks(keyword, SearchMode::contains, 10, [&](const Book&, int) { ++found; });
+            });
+        }
+        stats.report(os, n, "searchBooks");
+        if (found < kQueries) std::cerr << "检索结果异常\n";
+    }
+
+    {
+        // 借出日期为2024-06-01，两个结算日分别产生首次罚款与增量罚款
+        OpStats stats(2);
+        Cents posted = 0;
+        for (Date asOf : {Date(2024, 8, 1), Date(2024, 9, 1)}) {
+            stats.measure([&] { posted += lib.accrueOverdueFines(asOf).posted; });
+        }
+        stats.report(os, n, "accrueOverdueFines");
+        if (posted == 0) std::cerr << "逾期结算结果异常\n";
+    }
+
+    {
+        constexpr std::size_t kQueries = 1000;
+        OpStats stats(kQueries);
+        std::size_t held = 0;
+        for (std::size_t q = 0; q < kQueries; ++q) {
+            int card = static_cast<int>(q * 7919 % n + 1);
+            stats.measure([&] {
+                lib.forEachLoan(card, [&](const Transaction&, const Book&, const Patron&) { ++held; });
+            });
+        }
+        stats.report(os, n, "patronLoans");
+        if (held == 0) std::cerr << "在借查询结果异常\n";
+    }
+
+    {
+        // 组合条件查询(小说、出版于1950-1969年、已借出)取首页20条并统计总数，与逐本扫描比较
+        constexpr std::size_t kQueries = 100;
+        BookFilterSpec spec;
+        spec.genre = static_cast<std::uint8_t>(Genre::fiction);
+        spec.yearFrom = 1950;
+        spec.yearTo = 1969;
+        spec.available = false;
+        OpStats indexed(kQueries), scanned(kQueries);
+        std::size_t viaIndex = 0, viaScan = 0;
+        for (std::size_t q = 0; q < kQueries; ++q) {
+            indexed.measure([&] {
+                lib.queryBooks(spec, 0, 20, [](const Book&) {}, &viaIndex);
+            });
+            scanned.measure([&] {
+                viaScan = 0;
+                lib.forEachBook(0, SIZE_MAX, [&](const Book& b) {
+                    if (b.getGenre() == Genre::fiction && b.getCopyrightYear() >= spec.yearFrom &&
+                        b.getCopyrightYear() <= spec.yearTo && !b.isAvailable()) {
+                        ++viaScan;
+                    }
+                });
+            });
+        }
+        indexed.report(os, n, "queryBooks");
+        scanned.report(os, n, "queryBooksScan");
+        if (viaIndex != viaScan) std::cerr << "组合查询结果异常\n";
+    }
+
+    {
+        // 当天借出最多的10本书与近期走红书籍(只读统计桶)，与逐条扫描借阅记录按书计数比较
+        constexpr std::size_t kQueries = 100;
+        OpStats top(kQueries), trend(kQueries), scanned(kQueries);
+        std::uint64_t topCount = 0, scanMax = 0;
+        for (std::size_t q = 0; q < kQueries; ++q) {
+            top.measure([&] {
+                topCount = 0;
+                lib.forEachTopTitle(AnalyticsPeriod::day, today, 10, [&](const Book&, std::uint64_t count) {
+                    topCount = std::max(topCount, count);
+                });
+            });
+            trend.measure([&] { lib.forEachTrendingTitle(today, 10, [](const Book&, const TrendingTitle&) {}); });
+            scanned.measure([&] {
+                std::unordered_map<BookId, std::uint64_t> perBook;
+                scanMax = 0;
+                lib.forEachTransaction([&](const Transaction& t, const Book&, const Patron&) {
+                    if (t.type == TransactionType::checkout && t.date == today.pack()) {
+                        scanMax = std::max(scanMax, ++perBook[t.book]);
+                    }
+                });
+            });
+        }
+        top.report(os, n, "topTitles");
+        trend.report(os, n, "trendingTitles");
+        scanned.report(os, n, "topTitlesScan");
+        if (topCount < scanMax) std::cerr << "借阅排行结果异常\n";
+    }
+
+    {
+        // 读视图：打开后另一线程持续借还，遍历视图得到的借出数应保持为打开时刻的值
+        constexpr int kRounds = 3;
+        OpStats opened(kRounds), walked(kRounds);
+        bool consistent = true;
+        for (int r = 0; r < kRounds; ++r) {
+            std::uint64_t expected = 0;
+            for (std::size_t g = 0; g < kGenreCount; ++g) expected += lib.getHoldings(static_cast<Genre>(g)).onLoan;
+            std::optional<Library::ReadView> view;
+            opened.measure([&] { view.emplace(lib.openReadView()); });
+            std::atomic<bool> stop{false};
+            // 最后一位读者从未借书、没有欠费
+            std::thread churn([&, card = static_cast<int>(n)] {
+                for (std::size_t i = loans; !stop.load(std::memory_order_relaxed); i = i + 1 < n ? i + 1 : loans) {
+                    lib.checkOutBook(isbns[i], card, today);
+                    lib.returnBook(isbns[i]);
+                }
+            });
+            std::uint64_t seen = 0;
+            walked.measure([&] {
+                seen = 0;
+                view->forEachBook([&](const Book& b) { seen += b.getOnLoan(); });
+            });
+            stop = true;
+            churn.join();
+            view.reset();
+            if (seen != expected) consistent = false;
+        }
+        opened.report(os, n, "openReadView");
+        walked.report(os, n, "viewBooksUnderLoad");
+        if (!consistent) std::cerr << "读视图结果异常\n";
+    }
+
+    {
+        OpStats stats(loans);
+        for (std::size_t i = 0; i < loans; ++i) {
+            stats.measure([&] { lib.returnBook(isbns[i]); });
+        }
+        stats.report(os, n, "returnBook");
+    }
+
+    {
+        // 批量借还(用未借出的另一半书籍)：每批256条，先整批借出再整批归还，延迟为整批的耗时
+        constexpr std::size_t kBatch = 256;
+        std::vector<LoanRequest> requests;
+        std::vector<LoanStatus> results;
+        OpStats stats((n - loans) / kBatch * 2 + 2);
+        std::size_t failed = 0;
+        for (std::size_t begin = loans; begin < n; begin += kBatch) {
+            std::size_t end = std::min(n, begin + kBatch);
+            for (LoanAction action : {LoanAction::checkout, LoanAction::checkin}) {
+                requests.clear();
+                for (std::size_t i = begin; i < end; ++i) {
+                    int card = static_cast<int>(i % 100 == 0 ? i + 2 : i + 1);
+                    requests.push_back(LoanRequest{action, isbns[i], card, today});
+                }
+                stats.measure([&] { lib.processLoans(requests, results); });
+                failed += static_cast<std::size_t>(
+                    std::count_if(results.begin(), results.end(), [](LoanStatus s) { return s != LoanStatus::ok; }));
+            }
+        }
+        stats.report(os, n, "processLoans256");
+        if (failed) std::cerr << "批量借还结果异常\n";
+    }
+
+    {
+        // 借阅历史：另一半书籍在之后12个月里每月由最后一位读者借还一轮，再封存各月分段
+        // 按月份查询与按读者查询(3号读者只在6月借还过一次，其余分段由布隆过滤器跳过)，与逐条扫描全部记录比较
+        std::size_t perMonth = std::min<std::size_t>(n - loans, 20000);
+        for (int m = 0; m < 12; ++m) {
+            for (std::size_t i = loans; i < loans + perMonth; ++i) {
+                Date day(2024 + (6 + m) / 12, (6 + m) % 12 + 1, 1 + static_cast<int>(i % 28));
+                lib.checkOutBook(isbns[i], static_cast<int>(n), day);
+                lib.returnBook(isbns[i], static_cast<int>(n), day);
+            }
+        }
+        OpStats sealed(1);
+        sealed.measure([&] { lib.sealHistory(); });
+        sealed.report(os, n, "sealHistory");
+
+        constexpr std::size_t kQueries = 10;
+        OpStats byMonth(kQueries), byPatron(kQueries), scanned(kQueries);
+        HistoryQuery month{Date(2024, 9, 1), Date(2024, 9, 30), "", 0};
+        HistoryQuery patron{std::nullopt, std::nullopt, "", 3};
+        std::size_t monthRows = 0, patronRows = 0, scanRows = 0;
+        const auto all = std::numeric_limits<std::size_t>::max();
+        for (std::size_t q = 0; q < kQueries; ++q) {
+            byMonth.measure([&] {
+                monthRows = 0;
+                lib.forEachHistory(month, 0, all, [&](const Transaction&, const Book&, const Patron&) { ++monthRows; });
+            });
+            byPatron.measure([&] {
+                patronRows = 0;
+                lib.forEachHistory(patron, 0, all, [&](const Transaction&, const Book&, const Patron&) { ++patronRows; });
+            });
+            scanned.measure([&] {
+                scanRows = 0;
+                lib.forEachTransaction([&](const Transaction& t, const Book&, const Patron&) {
+                    scanRows += t.date >= month.from->pack() && t.date <= month.to->pack();
+                });
+            });
+        }
+        byMonth.report(os, n, "historyByMonth");
+        byPatron.report(os, n, "historyByPatron");
+        scanned.report(os, n, "historyScan");
+        if (monthRows != scanRows || monthRows != perMonth * 2 || patronRows != 2) {
+            std::cerr << "借阅历史查询结果异常\n";
+        }
+    }
+
+    {
+        // 预约：前一半书籍(均已归还)由最后一位读者借出，每本再由3位无欠费读者预约，第3位优先级为1
+        // 归还时副本应直接借给第3位；其余预约再逐条取消
+        constexpr std::size_t kHolders = 3;
+        std::size_t held = std::min<std::size_t>(loans, 10000);
+        std::vector<int> eligible;
+        for (std::size_t c = loans + 2; c < n; ++c) {
+            if (c % 100 != 1) eligible.push_back(static_cast<int>(c));
+        }
+        auto holder = [&](std::size_t i, std::size_t j) { return eligible[(i * kHolders + j) % eligible.size()]; };
+        for (std::size_t i = 0; i < held; ++i) lib.checkOutBook(isbns[i], static_cast<int>(n), today);
+
+        OpStats placed(held * kHolders), returned(held), cancelled(held * (kHolders - 1));
+        for (std::size_t i = 0; i < held; ++i) {
+            for (std::size_t j = 0; j < kHolders; ++j) {
+                std::uint8_t priority = j + 1 == kHolders ? 1 : 0;
+                placed.measure([&] { lib.placeHold(isbns[i], holder(i, j), today, priority); });
+            }
+        }
+        std::size_t misassigned = 0;
+        for (std::size_t i = 0; i < held; ++i) {
+            returned.measure([&] {
+                lib.returnBook(isbns[i], static_cast<int>(n), today, [&](const Book&, const Patron& p) {
+                    misassigned += p.getCardNumber() != holder(i, kHolders - 1);
+                });
+            });
+        }
+        for (std::size_t i = 0; i < held; ++i) {
+            for (std::size_t j = 0; j + 1 < kHolders; ++j) {
+                cancelled.measure([&] { lib.cancelHold(isbns[i], holder(i, j)); });
+            }
+            lib.returnBook(isbns[i], holder(i, kHolders - 1), today);
+        }
+        placed.report(os, n, "placeHold");
+        returned.report(os, n, "returnBookToHold");
+        cancelled.report(os, n, "cancelHold");
+        if (misassigned || lib.getHoldCount() != 0) std::cerr << "预约分配结果异常\n";
+    }
+
+    {
+        // 删除已归还的一半书籍，再补入同样数量的新书(复用空出的槽位)
+        OpStats removed(loans), readded(loans);
+        for (std::size_t i = 0; i < loans; ++i) {
+            removed.measure([&] { lib.removeBook(isbns[i]); });
+        }
+        for (std::size_t i = 0; i < loans; ++i) {
+            Book book(makeIsbn(n + i), "新书" + std::to_string(i), "作者" + std::to_string(i % 5000),
+                      2000, genres[i % 5]);
+            readded.measure([&] { lib.addBook(book); });
+        }
+        removed.report(os, n, "removeBook");
+        readded.report(os, n, "addBookReuse");
+        if (lib.getBooks().size() != n) std::cerr << "删除/补入后书籍数量异常\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t minSize = 1000;
+    std::size_t maxSize = 1000000;
+    std::string output;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc) {
+            maxSize = std::stoull(argv[++i]);
+        } else if (arg == "--min" && i + 1 < argc) {
+            minSize = std::stoull(argv[++i]);
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            std::cerr << "用法: " << argv[0] << " [--max <最大规模>] [--min <最小规模>] [--output <结果文件>]\n";
+            return 2;
+        }
+    }
+
+    std::ofstream file;
+    if (!output.empty()) {
+        file.open(output);
+        if (!file) {
+            std::cerr << "无法写入结果文件: " << output << "\n";
+            return 2;
+        }
+    }
+    std::ostream& os = output.empty() ? std::cout : file;
+
+    if (!checkImportPolicies()) std::cerr << "批量导入ISBN校验结果异常\n";
+    if (!checkPoolReuse()) std::cerr << "字符串池复用结果异常\n";
+    if (!checkHandleReuse()) std::cerr << "槽位句柄复用结果异常\n";
+
+    for (std::size_t n = minSize; n <= maxSize; n *= 10) {
+        runSize(n, os);
+    }
+    return 0;
+}
@@ -0,0 +1,174 @@
+#ifndef BOOK_FILTER_H
+#define BOOK_FILTER_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <vector>
+
+// 书籍多条件筛选：按类型、可借状态的位图索引与按出版年份的有序索引
+// 位图以书籍槽位号编号，每位对应一个槽位。组合条件逐字(64位)求与，循环体是连续数组上的按位运算，
+// 编译器可自动向量化；结果位图再按位取出槽位，只访问命中的书籍
+// 年份索引为 年份 -> 该年份书籍槽位列表 的有序映射，范围查询只访问范围内的年份
+//
+// 并发(由Library保证)：
+//   - 添加/删除书籍(存活位图、类型位图、年份索引及容量)在独占锁下修改
+//   - 可借位图随借还在书籍分片锁下修改；同一个字中的位属于不同分片的书籍，因此用原子按位或/与更新，
+//     查询时以relaxed原子读取
+
+// 筛选条件，未给出的条件不限制
+struct BookFilterSpec {
+    std::optional<std::uint8_t> genre;                      // 类型(Genre的底层值)
+    std::int32_t yearFrom = std::numeric_limits<std::int32_t>::min();  // 出版年份下限(含)
+    std::int32_t yearTo = std::numeric_limits<std::int32_t>::max();    // 出版年份上限(含)
+    std::optional<bool> available;                          // true为有可借副本，false为副本全部借出
+
+    bool hasYearRange() const {
+        return yearFrom != std::numeric_limits<std::int32_t>::min() ||
+               yearTo != std::numeric_limits<std::int32_t>::max();
+    }
+};
+
+class BookFilterIndex {
+public:
+    using Word = std::uint64_t;
+    static constexpr std::size_t kWordBits = 64;
+
+private:
+    std::vector<Word> live;                     // 存活的书籍
+    std::vector<std::vector<Word>> genres;      // 按类型
+    std::vector<Word> available;                // 有可借副本(原子更新)
+    std::map<std::int32_t, std::vector<std::uint32_t>> years;  // 年份 -> 槽位
+    std::vector<std::int32_t> yearOf;           // 槽位 -> 年份
+    std::vector<std::uint32_t> yearPos;         // 槽位在其年份列表中的位置
+
+    static std::size_t wordsFor(std::size_t slots) { return (slots + kWordBits - 1) / kWordBits; }
+    static Word bit(std::uint32_t slot) { return Word(1) << (slot % kWordBits); }
+
+    static void set(std::vector<Word>& bits, std::uint32_t slot) { bits[slot / kWordBits] |= bit(slot); }
+    static void reset(std::vector<Word>& bits, std::uint32_t slot) { bits[slot / kWordBits] &= ~bit(slot); }
+
+    std::vector<Word>& genreBits(std::uint8_t genre) {
+        if (genre >= genres.size()) genres.resize(genre + 1, std::vector<Word>(live.size()));
+        return genres[genre];
+    }
+
+    Word availableWord(std::size_t i) const {
+        return std::atomic_ref<const Word>(available[i]).load(std::memory_order_relaxed);
+    }
+
+public:
+    // 按槽位总数调整容量
+    void resize(std::size_t slots) {
+        std::size_t words = wordsFor(slots);
+        if (slots > yearOf.size()) {
+            yearOf.resize(slots);
+            yearPos.resize(slots);
+        }
+        if (words <= live.size()) return;
+        live.resize(words);
+        available.resize(words);
+        for (auto& g : genres) g.resize(words);
+    }
+
+    // 登记一本书(调用方已按槽位数调整容量)
+    void add(std::uint32_t slot, std::uint8_t genre, std::int32_t year, bool isAvailable) {
+        set(live, slot);
+        set(genreBits(genre), slot);
+        setAvailable(slot, isAvailable);
+        auto& list = years[year];
+        yearOf[slot] = year;
+        yearPos[slot] = static_cast<std::uint32_t>(list.size());
+        list.push_back(slot);
+    }
+
+    // 移除一本书：从年份列表中以末尾元素填补空位
+    void remove(std::uint32_t slot, std::uint8_t genre) {
+        reset(live, slot);
+        reset(genreBits(genre), slot);
+        setAvailable(slot, false);
+        auto it = years.find(yearOf[slot]);
+        auto& list = it->second;
+        std::uint32_t pos = yearPos[slot];
+        list[pos] = list.back();
+        yearPos[list[pos]] = pos;
+        list.pop_back();
+        if (list.empty()) years.erase(it);
+    }
+
+    // 更新可借状态(可与其他槽位的更新并发)
+    void setAvailable(std::uint32_t slot, bool isAvailable) {
+        std::atomic_ref<Word> word(available[slot / kWordBits]);
+        if (isAvailable) word.fetch_or(bit(slot), std::memory_order_relaxed);
+        else word.fetch_and(~bit(slot), std::memory_order_relaxed);
+    }
+
+    // 求满足条件的槽位位图，返回命中数
+    std::size_t match(const BookFilterSpec& spec, std::vector<Word>& result) const {
+        std::size_t n = live.size();
+        result.assign(live.begin(), live.end());
+        if (spec.genre) {
+            if (*spec.genre >= genres.size()) {
+                result.assign(n, 0);
+                return 0;
+            }
+            const Word* g = genres[*spec.genre].data();
+            Word* r = result.data();
+            for (std::size_t i = 0; i < n; ++i) r[i] &= g[i];
+        }
+        if (spec.hasYearRange()) {
+            // 范围内年份的槽位先置位到临时位图，再整体求与
+            std::vector<Word> inRange(n);
+            for (auto it = years.lower_bound(spec.yearFrom); it != years.end() && it->first <= spec.yearTo; ++it) {
+                for (std::uint32_t slot : it->second) set(inRange, slot);
+            }
+            const Word* y = inRange.data();
+            Word* r = result.data();
+            for (std::size_t i = 0; i < n; ++i) r[i] &= y[i];
+        }
+        if (spec.available) {
+            Word flip = *spec.available ? 0 : ~Word(0);
+            for (std::size_t i = 0; i < n; ++i) result[i] &= availableWord(i) ^ flip;
+        }
+        std::size_t count = 0;
+        for (Word w : result) count += static_cast<std::size_t>(std::popcount(w));
+        return count;
+    }
+
+    // 从槽位from开始依次回调位图中的槽位f(slot)，至多limit个，返回下一个命中的槽位，没有更多时返回空
+    template <typename F>
+    static std::optional<std::size_t> forEachSlot(const std::vector<Word>& bits, std::size_t from,
+                                                  std::size_t limit, F&& f) {
+        std::size_t word = from / kWordBits;
+        if (word >= bits.size()) return std::nullopt;
+        Word w = bits[word] & (~Word(0) << (from % kWordBits));
+        std::size_t n = 0;
+        while (true) {
+            while (w == 0) {
+                if (++word == bits.size()) return std::nullopt;
+                w = bits[word];
+            }
+            std::size_t slot = word * kWordBits + static_cast<std::size_t>(std::countr_zero(w));
+            if (n == limit) return slot;
+            f(static_cast<std::uint32_t>(slot));
+            ++n;
+            w &= w - 1;
+        }
+    }
+
+    // 清空
+    void clear() {
+        live.clear();
+        genres.clear();
+        available.clear();
+        years.clear();
+        yearOf.clear();
+        yearPos.clear();
+    }
+};
+
+#endif // BOOK_FILTER_H
@@ -0,0 +1,310 @@
+#ifndef CATALOG_IMPORT_H
+#define CATALOG_IMPORT_H
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "fee_ledger.h"
+#include "isbn_validator.h"
+
+// 批量导入：从分隔符文本(CSV/TSV)解析书籍与读者
+// 书籍文件每行: isbn,title,author,year,genre
+//   genre可为1-5(与菜单编号一致)或fiction/nonfiction/periodical/biography/children
+// 读者文件每行: name,cardNumber[,fees]
+// 字段中不能包含分隔符或换行；空行与以#开头的行被忽略
+// 解析结果中的字符串视图指向原始文件内容，使用期间必须保持文件映射有效
+
+// 解析出的书籍行
+struct BookRecord {
+    std::string_view isbn;
+    std::string_view title;
+    std::string_view author;
+    int year;
+    std::uint8_t genre;     // Genre枚举的底层值(0-4)
+    std::size_t line;       // 源文件行号
+};
+
+// 解析出的读者行
+struct PatronRecord {
+    std::string_view name;
+    int cardNumber;
+    double fees;
+    std::size_t line;       // 源文件行号
+};
+
+// 被拒绝的行
+struct ImportError {
+    std::size_t line;       // 源文件行号(合并阶段的错误同样使用源行号)
+    std::string reason;     // 拒绝原因
+};
+
+// 一次解析的结果
+template <typename Record>
+struct ImportBatch {
+    std::vector<Record> rows;
+    std::vector<ImportError> errors;
+};
+
+// 导入选项
+struct ImportOptions {
+    char delimiter = ',';                       // 字段分隔符，TSV使用'\t'
+    bool skipHeader = false;                    // 是否跳过首行表头
+    int maxYear = 9999;                         // 允许的最大出版年份
+    IsbnPolicy isbnPolicy = IsbnPolicy::format; // ISBN校验规则
+    unsigned threads = 0;                       // 解析线程数，0表示按硬件并发数
+};
+
+// 根据文件扩展名选择分隔符：.tsv使用制表符，其余使用逗号
+inline char delimiterForPath(const std::string& path) {
+    auto dot = path.find_last_of('.');
+    if (dot != std::string::npos) {
+        std::string ext = path.substr(dot + 1);
+        if (ext == "tsv" || ext == "TSV" || ext == "tab") return '\t';
+    }
+    return ',';
+}
+
+// 判断首行是否为表头(首个字段等于给定列名)
+inline bool hasHeaderRow(std::string_view data, std::string_view firstColumn) {
+    return data.substr(0, firstColumn.size()) == firstColumn &&
+           (data.size() == firstColumn.size() || data[firstColumn.size()] == ',' ||
+            data[firstColumn.size()] == '\t');
+}
+
+namespace import_detail {
+
+// 按分隔符切分一行，返回实际字段数；超过N列时只保存前N列，返回值大于N
+template <std::size_t N>
+std::size_t splitFields(std::string_view line, char delim, std::array<std::string_view, N>& fields) {
+    std::size_t n = 0;
+    while (true) {
+        auto pos = line.find(delim);
+        if (n < N) fields[n] = line.substr(0, pos);
+        ++n;
+        if (pos == std::string_view::npos) return n;
+        line.remove_prefix(pos + 1);
+    }
+}
+
+// 字段数错误的原因，如"字段数不正确，应为5列，实际为6列"
+inline std::string fieldCountError(std::string_view expected, std::size_t actual) {
+    return "字段数不正确，应为" + std::string(expected) + "列，实际为" + std::to_string(actual) + "列";
+}
+
+// 整数解析(整个字段必须为数字)
+inline bool parseInt(std::string_view s, int& out) {
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+// 浮点数解析(整个字段必须为有限的数字，nan与inf不算)
+inline bool parseDouble(std::string_view s, double& out) {
+    auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), out);
+    return ec == std::errc() && ptr == s.data() + s.size() && std::isfinite(out);
+}
+
+// 解析书籍类型
+inline bool parseGenre(std::string_view s, std::uint8_t& out) {
+    static constexpr std::string_view names[] = {
+        "fiction", "nonfiction", "periodical", "biography", "children"
+    };
+    if (s.size() == 1 && s[0] >= '1' && s[0] <= '5') {
+        out = static_cast<std::uint8_t>(s[0] - '1');
+        return true;
+    }
+    for (std::uint8_t i = 0; i < 5; ++i) {
+        if (s == names[i]) {
+            out = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 依次回调每一行(去掉行尾\r)，返回处理的行数
+template <typename F>
+std::size_t forEachLine(std::string_view text, F&& f) {
+    std::size_t lineNo = 0;
+    while (!text.empty()) {
+        auto pos = text.find('\n');
+        std::string_view line = text.substr(0, pos);
+        text.remove_prefix(pos == std::string_view::npos ? text.size() : pos + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        f(line, lineNo++);
+    }
+    return lineNo;
+}
+
+// 将数据按行边界切分为若干块，在多个线程上分别解析后按原顺序合并
+// parseChunk(块文本, 块内结果) 返回块内行数，结果中的行号为块内序号(从0开始)
+template <typename Record, typename ParseChunk>
+ImportBatch<Record> parseInParallel(std::string_view data, const ImportOptions& options,
+                                    std::size_t firstLine, ParseChunk parseChunk) {
+    unsigned threads = options.threads ? options.threads : std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    // 小文件不值得开线程
+    constexpr std::size_t kMinChunkBytes = 1 << 20;
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, data.size() / kMinChunkBytes + 1));
+
+    // 按字节均分后向后对齐到换行符
+    std::vector<std::string_view> chunks;
+    std::size_t begin = 0;
+    for (unsigned i = 0; i < threads && begin < data.size(); ++i) {
+        std::size_t end = data.size() * (i + 1) / threads;
+        if (end < begin) end = begin;
+        if (i + 1 < threads) {
+            auto nl = data.find('\n', end);
+            end = nl == std::string_view::npos ? data.size() : nl + 1;
+        } else {
+            end = data.size();
+        }
+        chunks.push_back(data.substr(begin, end - begin));
+        begin = end;
+    }
+
+    std::vector<ImportBatch<Record>> partial(chunks.size());
+    std::vector<std::size_t> lineCounts(chunks.size());
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < chunks.size(); ++i) {
+        workers.emplace_back([&, i] { lineCounts[i] = parseChunk(chunks[i], partial[i]); });
+    }
+    if (!chunks.empty()) lineCounts[0] = parseChunk(chunks[0], partial[0]);
+    for (auto& w : workers) w.join();
+
+    // 合并：修正行号并按块顺序拼接
+    ImportBatch<Record> result;
+    std::size_t totalRows = 0;
+    for (const auto& p : partial) totalRows += p.rows.size();
+    result.rows.reserve(totalRows);
+    std::size_t lineBase = firstLine;
+    for (std::size_t i = 0; i < partial.size(); ++i) {
+        for (auto& r : partial[i].rows) {
+            r.line += lineBase;
+            result.rows.push_back(r);
+        }
+        for (auto& e : partial[i].errors) {
+            e.line += lineBase;
+            result.errors.push_back(std::move(e));
+        }
+        lineBase += lineCounts[i];
+    }
+    return result;
+}
+
+// 跳过可选的表头，返回剩余数据及其首行行号(从1开始)
+inline std::string_view stripHeader(std::string_view data, const ImportOptions& options,
+                                    std::size_t& firstLine) {
+    firstLine = 1;
+    if (options.skipHeader && !data.empty()) {
+        auto nl = data.find('\n');
+        data.remove_prefix(nl == std::string_view::npos ? data.size() : nl + 1);
+        firstLine = 2;
+    }
+    return data;
+}
+
+inline bool isSkippable(std::string_view line) {
+    return line.empty() || line[0] == '#';
+}
+
+} // namespace import_detail
+
+// 解析书籍文件内容
+inline ImportBatch<BookRecord> parseBookRecords(std::string_view data, const ImportOptions& options) {
+    using namespace import_detail;
+    std::size_t firstLine;
+    data = stripHeader(data, options, firstLine);
+
+    return parseInParallel<BookRecord>(data, options, firstLine,
+        [&options](std::string_view chunk, ImportBatch<BookRecord>& out) {
+            std::size_t lines = forEachLine(chunk, [&](std::string_view line, std::size_t lineNo) {
+                if (isSkippable(line)) return;
+                std::array<std::string_view, 5> f;
+                std::size_t n = splitFields(line, options.delimiter, f);
+                if (n != 5) {
+                    out.errors.push_back({lineNo, fieldCountError("5", n)});
+                    return;
+                }
+                BookRecord r{f[0], f[1], f[2], 0, 0, lineNo};
+                if (!parseInt(f[3], r.year) || r.year <= 0 || r.year > options.maxYear) {
+                    out.errors.push_back({lineNo, "无效的出版年份"});
+                    return;
+                }
+                if (!parseGenre(f[4], r.genre)) {
+                    out.errors.push_back({lineNo, "无效的书籍类型"});
+                    return;
+                }
+                out.rows.push_back(r);
+            });
+
+            // 对本块的ISBN列做批量校验
+            std::vector<std::string_view> isbns(out.rows.size());
+            std::vector<std::uint8_t> valid(out.rows.size());
+            for (std::size_t i = 0; i < out.rows.size(); ++i) isbns[i] = out.rows[i].isbn;
+            if (validateIsbnBatch(isbns, valid, options.isbnPolicy) != out.rows.size()) {
+                std::size_t kept = 0;
+                for (std::size_t i = 0; i < out.rows.size(); ++i) {
+                    if (valid[i]) {
+                        out.rows[kept++] = out.rows[i];
+                    } else {
+                        out.errors.push_back({out.rows[i].line, "无效的ISBN"});
+                    }
+                }
+                out.rows.resize(kept);
+            }
+            return lines;
+        });
+}
+
+// 解析读者文件内容
+inline ImportBatch<PatronRecord> parsePatronRecords(std::string_view data, const ImportOptions& options) {
+    using namespace import_detail;
+    std::size_t firstLine;
+    data = stripHeader(data, options, firstLine);
+
+    return parseInParallel<PatronRecord>(data, options, firstLine,
+        [&options](std::string_view chunk, ImportBatch<PatronRecord>& out) {
+            return forEachLine(chunk, [&](std::string_view line, std::size_t lineNo) {
+                if (isSkippable(line)) return;
+                std::array<std::string_view, 3> f;
+                std::size_t n = splitFields(line, options.delimiter, f);
+                if (n < 2 || n > 3) {
+                    out.errors.push_back({lineNo, fieldCountError("2或3", n)});
+                    return;
+                }
+                PatronRecord r{f[0], 0, 0.0, lineNo};
+                if (r.name.empty()) {
+                    out.errors.push_back({lineNo, "读者姓名为空"});
+                    return;
+                }
+                if (!parseInt(f[1], r.cardNumber) || r.cardNumber <= 0) {
+                    out.errors.push_back({lineNo, "无效的借书证号"});
+                    return;
+                }
+                if (n == 3 && !f[2].empty() && (!parseDouble(f[2], r.fees) || !isValidFeeAmount(r.fees))) {
+                    out.errors.push_back({lineNo, "无效的欠费金额"});
+                    return;
+                }
+                out.rows.push_back(r);
+            });
+        });
+}
+
+// 将被拒绝的行写入错误报告(每行: 来源,行号,原因)
+inline void writeImportErrors(std::ostream& os, const std::string& source,
+                              const std::vector<ImportError>& errors) {
+    for (const auto& e : errors) {
+        os << source << ',' << e.line << ',' << e.reason << '\n';
+    }
+}
+
+#endif // CATALOG_IMPORT_H
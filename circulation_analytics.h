@@ -0,0 +1,372 @@
+#ifndef CIRCULATION_ANALYTICS_H
+#define CIRCULATION_ANALYTICS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include "overdue_fines.h"
+#include "string_pool.h"
+#include "transaction_log.h"
+
+// 借阅流式统计：每次借出/归还时增量更新按天、按周分桶的计数，热门书籍/作者/类型与"近期走红"查询
+// 只读取少数几个桶，代价与借阅历史长度无关
+//
+// 每个桶保存借出/归还总数、按类型的借出/归还数，以及书籍与作者两组热门项统计(HeavyHitters)：
+//   - Count-Min草图：depth行、每行width个原子计数器，估计值为各行对应计数器的最小值，只会高估
+//   - 候选集：估计值最大的若干项，估计值超过候选集门槛时才加锁更新，大部分事件只做几次原子加法
+// 桶组成定长环形数组，按天保留kDayBuckets天、按周(周一开始)保留kWeekBuckets周；
+// 日期早于保留范围的事件不计入分桶统计
+//
+// 并发：记录事件只持环形数组的共享锁，计数器原子更新；换桶(新的一天/一周)时短暂持独占锁清零旧桶
+
+namespace analytics_detail {
+
+// 64位混合函数(splitmix64的终结步骤)
+inline std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// 统计键的整数表示
+inline std::uint64_t keyBits(SlotHandle h) { return h; }
+inline std::uint64_t keyBits(const PooledString& s) { return s.bits(); }
+
+// 向下取整的除法(日期可早于1970-01-01)
+inline std::int32_t floorDiv(std::int32_t a, std::int32_t b) {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+} // namespace analytics_detail
+
+// 统计周期
+enum class AnalyticsPeriod : std::uint8_t {
+    day,    // 自然日
+    week    // 自然周(周一至周日)
+};
+
+// 某一周期的借还计数
+struct CirculationCounts {
+    std::uint64_t checkouts = 0;
+    std::uint64_t returns = 0;
+    std::array<std::uint64_t, kGenreCount> genreCheckouts{};
+    std::array<std::uint64_t, kGenreCount> genreReturns{};
+};
+
+// 近期走红的书籍：近期借出数与之前基准期的借出数(均为估计值)，lift为近期日均与基准日均之比
+struct TrendingTitle {
+    BookId book;
+    std::uint64_t recent;
+    std::uint64_t baseline;
+    double lift;
+};
+
+// 单个周期内的热门项统计：Count-Min草图 + 候选集
+template <typename Key>
+class HeavyHitters {
+public:
+    static constexpr std::size_t kDepth = 4;
+    static constexpr std::size_t kWidth = 1024;         // 须为2的幂
+    static constexpr std::size_t kCandidates = 32;      // 候选集大小，即可查询的热门项上限
+
+private:
+    struct Candidate {
+        Key key;
+        std::uint32_t estimate;     // 最近一次更新时的估计值，只用于决定淘汰哪一项
+    };
+
+    std::array<std::array<std::atomic<std::uint32_t>, kWidth>, kDepth> cells{};
+    mutable std::mutex mutex;
+    std::vector<Candidate> candidates;
+    std::atomic<std::uint32_t> threshold{0};    // 候选集已满时为其中最小的估计值
+
+    static std::size_t cell(std::size_t row, std::uint64_t bits) {
+        return analytics_detail::mix(bits + 0x9e3779b97f4a7c15ULL * (row + 1)) & (kWidth - 1);
+    }
+
+    // 重新计算门槛(持有mutex)
+    void refreshThreshold() {
+        std::uint32_t low = 0;
+        if (candidates.size() == kCandidates) {
+            low = std::min_element(candidates.begin(), candidates.end(),
+                [](const Candidate& a, const Candidate& b) { return a.estimate < b.estimate; })->estimate;
+        }
+        threshold.store(low, std::memory_order_relaxed);
+    }
+
+public:
+    HeavyHitters() { candidates.reserve(kCandidates); }
+
+    // 记录一次出现
+    void add(const Key& key) {
+        std::uint64_t bits = analytics_detail::keyBits(key);
+        std::uint32_t estimate = UINT32_MAX;
+        for (std::size_t row = 0; row < kDepth; ++row) {
+            std::uint32_t c = cells[row][cell(row, bits)].fetch_add(1, std::memory_order_relaxed) + 1;
+            estimate = std::min(estimate, c);
+        }
+        if (estimate <= threshold.load(std::memory_order_relaxed)) return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = std::find_if(candidates.begin(), candidates.end(),
+            [&](const Candidate& c) { return analytics_detail::keyBits(c.key) == bits; });
+        if (it != candidates.end()) {
+            it->estimate = std::max(it->estimate, estimate);
+        } else if (candidates.size() < kCandidates) {
+            candidates.push_back(Candidate{key, estimate});
+        } else {
+            auto low = std::min_element(candidates.begin(), candidates.end(),
+                [](const Candidate& a, const Candidate& b) { return a.estimate < b.estimate; });
+            if (low->estimate >= estimate) return;
+            *low = Candidate{key, estimate};
+        }
+        refreshThreshold();
+    }
+
+    // 估计出现次数(不低于真实值)
+    std::uint32_t estimate(const Key& key) const {
+        std::uint64_t bits = analytics_detail::keyBits(key);
+        std::uint32_t result = UINT32_MAX;
+        for (std::size_t row = 0; row < kDepth; ++row) {
+            result = std::min(result, cells[row][cell(row, bits)].load(std::memory_order_relaxed));
+        }
+        return result;
+    }
+
+    // 按当前估计值从高到低回调f(键, 次数)，最多limit项
+    template <typename F>
+    void top(std::size_t limit, F&& f) const {
+        std::vector<std::pair<std::uint32_t, Key>> ranked;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ranked.reserve(candidates.size());
+            for (const Candidate& c : candidates) ranked.emplace_back(estimate(c.key), c.key);
+        }
+        limit = std::min(limit, ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + limit, ranked.end(),
+            [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (std::size_t i = 0; i < limit; ++i) f(ranked[i].second, static_cast<std::uint64_t>(ranked[i].first));
+    }
+
+    // 回调候选集中的每个键
+    template <typename F>
+    void forEachCandidate(F&& f) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const Candidate& c : candidates) f(c.key);
+    }
+
+    // 清零(调用方保证没有并发的add)
+    void clear() {
+        for (auto& row : cells) {
+            for (auto& c : row) c.store(0, std::memory_order_relaxed);
+        }
+        candidates.clear();
+        threshold.store(0, std::memory_order_relaxed);
+    }
+};
+
+class CirculationAnalytics {
+public:
+    static constexpr std::size_t kDayBuckets = 64;
+    static constexpr std::size_t kWeekBuckets = 26;
+    static constexpr std::int32_t kRecentDays = 3;      // "近期走红"的近期窗口(含当天)
+    static constexpr std::int32_t kBaselineDays = 28;   // 与之比较的基准期，紧接在近期窗口之前
+    static constexpr std::uint64_t kMinTrendingCount = 3;   // 近期借出少于此数的不计入走红
+    static_assert(kRecentDays + kBaselineDays <= static_cast<std::int32_t>(kDayBuckets));
+
+private:
+    struct Bucket {
+        std::int32_t period = 0;    // 天数或周数(在环形数组的锁下修改)
+        std::atomic<std::uint64_t> checkouts{0};
+        std::atomic<std::uint64_t> returns{0};
+        std::array<std::atomic<std::uint64_t>, kGenreCount> genreCheckouts{};
+        std::array<std::atomic<std::uint64_t>, kGenreCount> genreReturns{};
+        HeavyHitters<BookId> titles;
+        HeavyHitters<PooledString> authors;
+
+        void reset(std::int32_t p) {
+            period = p;
+            checkouts.store(0, std::memory_order_relaxed);
+            returns.store(0, std::memory_order_relaxed);
+            for (auto& c : genreCheckouts) c.store(0, std::memory_order_relaxed);
+            for (auto& c : genreReturns) c.store(0, std::memory_order_relaxed);
+            titles.clear();
+            authors.clear();
+        }
+    };
+
+    // 定长的桶环：周期p放在p mod N号位置，桶在第一次用到时分配
+    template <std::size_t N>
+    class Ring {
+    private:
+        std::array<std::unique_ptr<Bucket>, N> slots;
+        std::int32_t newest = INT32_MIN;    // 已记录的最新周期
+        mutable std::shared_mutex mutex;
+
+        static std::size_t indexOf(std::int32_t p) {
+            auto n = static_cast<std::int32_t>(N);
+            return static_cast<std::size_t>(((p % n) + n) % n);
+        }
+
+        bool retained(std::int32_t p) const {
+            return newest == INT32_MIN || static_cast<std::int64_t>(p) > static_cast<std::int64_t>(newest) - static_cast<std::int64_t>(N);
+        }
+
+    public:
+        // 对周期p的桶执行f(桶)；p早于保留范围时返回false
+        template <typename F>
+        bool update(std::int32_t p, F&& f) {
+            {
+                std::shared_lock<std::shared_mutex> lock(mutex);
+                Bucket* b = slots[indexOf(p)].get();
+                if (b && b->period == p) {
+                    f(*b);
+                    return true;
+                }
+                if (!retained(p)) return false;
+            }
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            if (!retained(p)) return false;
+            auto& slot = slots[indexOf(p)];
+            if (!slot) {
+                slot = std::make_unique<Bucket>();
+                slot->period = p;
+            } else if (slot->period != p) {
+                if (slot->period > p) return false;     // 该位置已被更新的周期占用
+                slot->reset(p);
+            }
+            newest = std::max(newest, p);
+            f(*slot);
+            return true;
+        }
+
+        // 读取周期p的桶，存在时回调f(桶)并返回true
+        template <typename F>
+        bool read(std::int32_t p, F&& f) const {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            const Bucket* b = slots[indexOf(p)].get();
+            if (!b || b->period != p) return false;
+            f(*b);
+            return true;
+        }
+
+        void clear() {
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            for (auto& slot : slots) slot.reset();
+            newest = INT32_MIN;
+        }
+    };
+
+    Ring<kDayBuckets> days;
+    Ring<kWeekBuckets> weeks;
+
+    static void count(Bucket& b, BookId book, const PooledString& author, std::uint8_t genre, TransactionType type) {
+        if (type == TransactionType::checkout) {
+            b.checkouts.fetch_add(1, std::memory_order_relaxed);
+            b.genreCheckouts[genre].fetch_add(1, std::memory_order_relaxed);
+            b.titles.add(book);
+            b.authors.add(author);
+        } else {
+            b.returns.fetch_add(1, std::memory_order_relaxed);
+            b.genreReturns[genre].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename F>
+    bool read(AnalyticsPeriod period, std::int32_t day, F&& f) const {
+        return period == AnalyticsPeriod::day ? days.read(day, f) : weeks.read(weekOf(day), f);
+    }
+
+public:
+    // 天数所在的周(周一开始；1970-01-01为周四)
+    static std::int32_t weekOf(std::int32_t day) { return analytics_detail::floorDiv(day + 3, 7); }
+
+    // 记录一次借出或归还(热门统计只计借出)；day为事件日期的天数
+    void record(BookId book, const PooledString& author, std::uint8_t genre, std::int32_t day,
+                TransactionType type) {
+        auto f = [&](Bucket& b) { count(b, book, author, genre, type); };
+        days.update(day, f);
+        weeks.update(weekOf(day), f);
+    }
+
+    // 包含day的那一天/那一周的借还计数，超出保留范围时全为0
+    CirculationCounts counts(AnalyticsPeriod period, std::int32_t day) const {
+        CirculationCounts c;
+        read(period, day, [&](const Bucket& b) {
+            c.checkouts = b.checkouts.load(std::memory_order_relaxed);
+            c.returns = b.returns.load(std::memory_order_relaxed);
+            for (std::size_t g = 0; g < kGenreCount; ++g) {
+                c.genreCheckouts[g] = b.genreCheckouts[g].load(std::memory_order_relaxed);
+                c.genreReturns[g] = b.genreReturns[g].load(std::memory_order_relaxed);
+            }
+        });
+        return c;
+    }
+
+    // 包含day的那一天/那一周借出最多的书籍，从高到低回调f(书籍句柄, 借出次数)，最多limit项
+    template <typename F>
+    void topTitles(AnalyticsPeriod period, std::int32_t day, std::size_t limit, F&& f) const {
+        read(period, day, [&](const Bucket& b) { b.titles.top(limit, f); });
+    }
+
+    // 同上，按作者汇总，回调f(作者, 借出次数)
+    template <typename F>
+    void topAuthors(AnalyticsPeriod period, std::int32_t day, std::size_t limit, F&& f) const {
+        read(period, day, [&](const Bucket& b) { b.authors.top(limit, f); });
+    }
+
+    // 截至day的近期走红书籍：候选为近期各天桶的热门项，比较近期与基准期的日均借出，按lift从高到低
+    // 只访问kRecentDays + kBaselineDays个日桶
+    std::vector<TrendingTitle> trending(std::int32_t day, std::size_t limit) const {
+        std::vector<BookId> keys;
+        for (std::int32_t d = day - kRecentDays + 1; d <= day; ++d) {
+            days.read(d, [&](const Bucket& b) { b.titles.forEachCandidate([&](BookId id) { keys.push_back(id); }); });
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+        std::vector<TrendingTitle> result;
+        result.reserve(keys.size());
+        for (BookId id : keys) result.push_back(TrendingTitle{id, 0, 0, 0});
+        auto sum = [&](std::int32_t from, std::int32_t to, std::uint64_t TrendingTitle::* field) {
+            for (std::int32_t d = from; d <= to; ++d) {
+                days.read(d, [&](const Bucket& b) {
+                    for (TrendingTitle& t : result) t.*field += b.titles.estimate(t.book);
+                });
+            }
+        };
+        sum(day - kRecentDays + 1, day, &TrendingTitle::recent);
+        sum(day - kRecentDays - kBaselineDays + 1, day - kRecentDays, &TrendingTitle::baseline);
+
+        std::erase_if(result, [](const TrendingTitle& t) { return t.recent < kMinTrendingCount; });
+        for (TrendingTitle& t : result) {
+            // 基准期没有借出时按每个基准期一次计，避免除以0
+            double baselineRate = std::max<double>(static_cast<double>(t.baseline), 1.0) / kBaselineDays;
+            t.lift = static_cast<double>(t.recent) / kRecentDays / baselineRate;
+        }
+        limit = std::min(limit, result.size());
+        std::partial_sort(result.begin(), result.begin() + limit, result.end(),
+            [](const TrendingTitle& a, const TrendingTitle& b) {
+                return a.lift != b.lift ? a.lift > b.lift : a.recent > b.recent;
+            });
+        result.resize(limit);
+        return result;
+    }
+
+    void clear() {
+        days.clear();
+        weeks.clear();
+    }
+};
+
+#endif // CIRCULATION_ANALYTICS_H
@@ -0,0 +1,343 @@
+#ifndef CIRCULATION_PROTOCOL_H
+#define CIRCULATION_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "library_commands.h"
+#include "persistence.h"
+
+// 借还服务的二进制协议：各分馆终端通过本机套接字向同一个服务进程发送命令
+// 请求与响应都是帧：[u32 负载长度][负载]，整数为本机字节序(只在同一台机器上通信)
+//
+// 请求负载: [u8 命令类型(CommandType)][u8 参数个数]{[u16 长度][参数文本]}
+//   命令与参数同批处理命令行完全一致，由CommandEngine执行
+// 响应负载: [u8 结果]，0为成功，其后是零到多行结果；1为失败，其后是[u16 长度][错误信息]
+//   每行结果为[u8 行类型(ResponseRow)][字段]，各行类型的字段见ResponseEncoder
+//
+// 列表类查询(books、patrons、transactions、query、history)单页最多kMaxPageRows行，不带条数时返回第一页与下一页游标；
+// 响应负载超过kMaxFramePayload时改为失败响应
+//
+// 同一连接上可以连续发送多个请求而不等待响应(流水线)，服务端严格按请求顺序返回响应
+// 帧超长、命令类型未知或参数个数不符被视为协议错误，服务端在返回此前请求的响应后关闭连接
+
+// 单帧负载上限
+constexpr std::uint32_t kMaxFramePayload = 1u << 20;
+
+// 列表类查询单页行数上限，常规书目与读者数据下一页远小于单帧上限
+constexpr std::size_t kMaxPageRows = 1000;
+
+// 响应中结果行的类型
+enum class ResponseRow : std::uint8_t {
+    book = 1,           // isbn, 书名, 作者, i32 年份, u8 类型, u32 副本数, u32 可借副本数
+    patron = 2,         // 姓名, i32 借书证号, i64 欠费(分)
+    transaction = 3,    // u8 事件类型, u32 日期, isbn, 书名, i32 借书证号, 读者姓名
+    debtor = 4,         // 姓名, i32 借书证号, i64 欠费(分)
+    debtorSummary = 5,  // u64 欠费读者数, i64 欠费合计(分), 下一页游标
+    page = 6,           // 下一页游标(空表示没有下一页)
+    exported = 7,       // u64 记录数, u64 字节数, f64 耗时(秒), 路径
+    metrics = 8,        // 运行统计JSON(u32长度)
+    holdings = 9,       // u8 类型, u64 种数, u64 副本数, u64 借出副本数
+    matched = 10,       // u64 命中数
+    fines = 11,         // u32 结算日, u64 在借, u64 逾期, u64 新增罚款笔数, u64 涉及读者, i64 新增罚款(分), u32 线程数, f64 耗时
+    rankedBook = 12,    // isbn, 书名, 作者, u64 借出次数
+    rankedAuthor = 13,  // 作者, u64 借出次数
+    genreCirculation = 14,  // u8 类型, u64 借出次数, u64 归还次数
+    trending = 15,      // isbn, 书名, 作者, u64 近期借出, u64 基准期借出, f64 日均之比
+    historySegment = 16,    // i32 月份(年*12+月-1), u8 状态, u64 首条序号, u64 结束序号, u64 记录数, u64 借出,
+                            // u64 归还, u64 书籍数, u64 读者数, u32 最早日期, u32 最晚日期(无记录时为0),
+                            // u64 编码字节数, u64 原始字节数, u8 是否落盘, u64 保留记录数
+    hold = 17,          // isbn, 书名, u32 预约日期, u8 优先级, u8 是否暂停, u64 该书预约总数
+    holdFilled = 18     // isbn, 书名, i32 借书证号, 读者姓名：归还的副本已借给该预约读者
+};
+
+namespace protocol_detail {
+
+// 短文本：[u16 长度][字节]
+inline void putText(BinaryWriter& out, std::string_view s) {
+    if (s.size() > 0xFFFF) {
+        throw std::length_error("文本字段过长");
+    }
+    out.put(static_cast<std::uint16_t>(s.size()));
+    out.putBytes(s.data(), s.size());
+}
+
+inline std::string_view getText(BinaryReader& in) {
+    return in.take(in.get<std::uint16_t>());
+}
+
+// 开始一帧，返回长度字段的位置，负载写完后由endFrame回填
+inline std::size_t beginFrame(BinaryWriter& out) {
+    std::size_t at = out.size();
+    out.put(std::uint32_t(0));
+    return at;
+}
+
+inline void endFrame(BinaryWriter& out, std::size_t at) {
+    auto length = static_cast<std::uint32_t>(out.size() - at - sizeof(std::uint32_t));
+    std::memcpy(out.data().data() + at, &length, sizeof(length));
+}
+
+} // namespace protocol_detail
+
+// 把一条命令编码为请求帧追加到out
+inline void encodeRequest(BinaryWriter& out, CommandType type, const std::vector<std::string>& args) {
+    std::size_t frame = protocol_detail::beginFrame(out);
+    out.put(static_cast<std::uint8_t>(type));
+    out.put(static_cast<std::uint8_t>(args.size()));
+    for (const std::string& a : args) protocol_detail::putText(out, a);
+    protocol_detail::endFrame(out, frame);
+}
+
+// 从缓冲开头取出一帧的负载；数据不足一帧时返回false，consumed为整帧占用的字节数
+// 负载超过上限时抛出std::runtime_error
+inline bool takeFrame(std::string_view buffer, std::string_view& payload, std::size_t& consumed) {
+    if (buffer.size() < sizeof(std::uint32_t)) return false;
+    std::uint32_t length;
+    std::memcpy(&length, buffer.data(), sizeof(length));
+    if (length > kMaxFramePayload) {
+        throw std::runtime_error("协议帧过长");
+    }
+    if (buffer.size() - sizeof(length) < length) return false;
+    payload = buffer.substr(sizeof(length), length);
+    consumed = sizeof(length) + length;
+    return true;
+}
+
+// 解码请求负载到cmd(复用cmd中已有的容量)，命令类型或参数个数不合法时抛出std::runtime_error
+inline void decodeRequest(std::string_view payload, Command& cmd) {
+    BinaryReader in(payload);
+    auto type = in.get<std::uint8_t>();
+    auto argc = in.get<std::uint8_t>();
+    if (type >= kCommandTypeCount) {
+        throw std::runtime_error("未知的命令类型");
+    }
+    const CommandSpec& spec = kCommandSpecs[type];
+    if (argc < spec.minArgs || argc > spec.maxArgs) {
+        throw std::runtime_error(std::string(spec.name) + " 命令的参数个数不正确");
+    }
+    cmd.type = static_cast<CommandType>(type);
+    cmd.args.resize(argc);
+    for (std::string& a : cmd.args) a.assign(protocol_detail::getText(in));
+    if (in.remaining() != 0) {
+        throw std::runtime_error("请求帧中有多余的数据");
+    }
+}
+
+// 响应的结果与错误信息；rows为结果行部分的原始字节
+struct ResponseView {
+    bool ok = false;
+    std::string_view error;
+    std::string_view rows;
+};
+
+inline ResponseView decodeResponse(std::string_view payload) {
+    BinaryReader in(payload);
+    ResponseView r;
+    r.ok = in.get<std::uint8_t>() == 0;
+    if (r.ok) r.rows = in.take(in.remaining());
+    else r.error = protocol_detail::getText(in);
+    return r;
+}
+
+// 把命令执行结果编码为响应帧：begin开一帧，end回填长度；失败时丢弃已写出的结果行，只留错误信息
+class ResponseEncoder : public ResultWriter {
+private:
+    BinaryWriter* out = nullptr;
+    std::size_t frame = 0;
+
+    void row(ResponseRow kind) { out->put(static_cast<std::uint8_t>(kind)); }
+    void text(std::string_view s) { protocol_detail::putText(*out, s); }
+
+protected:
+    // 指定后续响应写入的缓冲
+    void target(BinaryWriter& buffer) { out = &buffer; }
+
+public:
+    ResponseEncoder() = default;
+    explicit ResponseEncoder(BinaryWriter& buffer) : out(&buffer) {}
+
+    void begin(const Command&) override {
+        frame = protocol_detail::beginFrame(*out);
+        out->put(std::uint8_t(0));
+    }
+
+    void book(const Book& b) override {
+        row(ResponseRow::book);
+        text(b.getISBN());
+        text(b.getTitle());
+        text(b.getAuthor());
+        out->put(static_cast<std::int32_t>(b.getCopyrightYear()));
+        out->put(static_cast<std::uint8_t>(b.getGenre()));
+        out->put(static_cast<std::uint32_t>(b.getCopies()));
+        out->put(static_cast<std::uint32_t>(b.getAvailableCopies()));
+    }
+
+    void patron(const Patron& p) override {
+        row(ResponseRow::patron);
+        text(p.getName());
+        out->put(static_cast<std::int32_t>(p.getCardNumber()));
+        out->put(p.getFeeCents());
+    }
+
+    void transaction(const Transaction& t, const Book& b, const Patron& p) override {
+        row(ResponseRow::transaction);
+        out->put(static_cast<std::uint8_t>(t.type));
+        out->put(t.date);
+        text(b.getISBN());
+        text(b.getTitle());
+        out->put(static_cast<std::int32_t>(p.getCardNumber()));
+        text(p.getName());
+    }
+
+    void debtor(const Patron& p, Cents amount) override {
+        row(ResponseRow::debtor);
+        text(p.getName());
+        out->put(static_cast<std::int32_t>(p.getCardNumber()));
+        out->put(amount);
+    }
+
+    void debtorSummary(std::size_t count, Cents total, const std::string& next) override {
+        row(ResponseRow::debtorSummary);
+        out->put(static_cast<std::uint64_t>(count));
+        out->put(total);
+        text(next);
+    }
+
+    void pageEnd(const std::string& next) override {
+        row(ResponseRow::page);
+        text(next);
+    }
+
+    std::size_t pageLimit() const override { return kMaxPageRows; }
+
+    void exported(const ExportSummary& r, const std::string& path) override {
+        row(ResponseRow::exported);
+        out->put(static_cast<std::uint64_t>(r.rows));
+        out->put(r.bytes);
+        out->put(r.seconds);
+        text(path);
+    }
+
+    void metrics(const Metrics::Snapshot& snapshot) override {
+        std::string json;
+        appendMetricsJson(json, snapshot);
+        row(ResponseRow::metrics);
+        out->putString(json);
+    }
+
+    void holdings(Genre genre, const GenreHoldings& h) override {
+        row(ResponseRow::holdings);
+        out->put(static_cast<std::uint8_t>(genre));
+        out->put(static_cast<std::uint64_t>(h.titles));
+        out->put(h.copies);
+        out->put(h.onLoan);
+    }
+
+    void matchCount(std::size_t n) override {
+        row(ResponseRow::matched);
+        out->put(static_cast<std::uint64_t>(n));
+    }
+
+    void rankedBook(const Book& b, std::uint64_t count) override {
+        row(ResponseRow::rankedBook);
+        text(b.getISBN());
+        text(b.getTitle());
+        text(b.getAuthor());
+        out->put(count);
+    }
+
+    void rankedAuthor(std::string_view author, std::uint64_t count) override {
+        row(ResponseRow::rankedAuthor);
+        text(author);
+        out->put(count);
+    }
+
+    void genreCirculation(Genre genre, std::uint64_t checkouts, std::uint64_t returns) override {
+        row(ResponseRow::genreCirculation);
+        out->put(static_cast<std::uint8_t>(genre));
+        out->put(checkouts);
+        out->put(returns);
+    }
+
+    void trendingBook(const Book& b, const TrendingTitle& t) override {
+        row(ResponseRow::trending);
+        text(b.getISBN());
+        text(b.getTitle());
+        text(b.getAuthor());
+        out->put(t.recent);
+        out->put(t.baseline);
+        out->put(t.lift);
+    }
+
+    void hold(const HoldInfo& h, const Book& b) override {
+        row(ResponseRow::hold);
+        text(b.getISBN());
+        text(b.getTitle());
+        out->put(h.date);
+        out->put(h.priority);
+        out->put(static_cast<std::uint8_t>(h.suspended));
+        out->put(static_cast<std::uint64_t>(h.queued));
+    }
+
+    void holdFilled(const Book& b, const Patron& p) override {
+        row(ResponseRow::holdFilled);
+        text(b.getISBN());
+        text(b.getTitle());
+        out->put(static_cast<std::int32_t>(p.getCardNumber()));
+        text(p.getName());
+    }
+
+    void historySegment(const HistorySegmentInfo& h) override {
+        row(ResponseRow::historySegment);
+        out->put(h.month);
+        out->put(static_cast<std::uint8_t>(h.state));
+        out->put(static_cast<std::uint64_t>(h.first));
+        out->put(static_cast<std::uint64_t>(h.end));
+        out->put(h.stats.records);
+        out->put(h.stats.checkouts);
+        out->put(h.stats.returns);
+        out->put(h.stats.distinctBooks);
+        out->put(h.stats.distinctPatrons);
+        out->put(static_cast<std::uint32_t>(h.stats.records ? h.stats.minDay : 0));
+        out->put(static_cast<std::uint32_t>(h.stats.records ? h.stats.maxDay : 0));
+        out->put(static_cast<std::uint64_t>(h.encodedBytes));
+        out->put(static_cast<std::uint64_t>(h.rawBytes));
+        out->put(static_cast<std::uint8_t>(h.spilled));
+        out->put(static_cast<std::uint64_t>(h.retained));
+    }
+
+    void fineRun(const FineRunSummary& r) override {
+        row(ResponseRow::fines);
+        out->put(r.asOf.pack());
+        out->put(static_cast<std::uint64_t>(r.openLoans));
+        out->put(static_cast<std::uint64_t>(r.overdueLoans));
+        out->put(static_cast<std::uint64_t>(r.finedLoans));
+        out->put(static_cast<std::uint64_t>(r.patronsCharged));
+        out->put(r.posted);
+        out->put(static_cast<std::uint32_t>(r.threads));
+        out->put(r.seconds);
+    }
+
+    void end(const Command&, bool ok, const std::string& error) override {
+        std::string_view message = error;
+        // 超出单帧上限的响应对方无法接收(长度字段还可能溢出)，改为失败响应
+        if (ok && out->size() - frame - sizeof(std::uint32_t) > kMaxFramePayload) {
+            ok = false;
+            message = "响应超出单帧上限，请减小分页条数";
+        }
+        if (!ok) {
+            out->data().resize(frame + sizeof(std::uint32_t));
+            out->put(std::uint8_t(1));
+            text(message.substr(0, 0xFFFF));
+        }
+        protocol_detail::endFrame(*out, frame);
+    }
+};
+
+#endif // CIRCULATION_PROTOCOL_H
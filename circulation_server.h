@@ -0,0 +1,360 @@
+#ifndef CIRCULATION_SERVER_H
+#define CIRCULATION_SERVER_H
+
+// 借还服务：一个进程持有一个Library，各分馆终端通过Unix域套接字共享同一份馆藏
+// 基于epoll，仅在Linux上提供
+#ifdef __linux__
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "circulation_protocol.h"
+
+// 若干个事件循环线程，各有自己的epoll实例与CommandEngine；监听套接字以EPOLLEXCLUSIVE加入所有循环，
+// 新连接由被唤醒的那个循环接受并从此归它处理，连接上的请求只在一个线程中执行
+//
+// 每轮epoll_wait：
+//   1. 依次读取就绪连接，把已收齐的请求帧全部解码到本轮的命令队列(同一连接的请求保持顺序)
+//   2. 按顺序执行队列：相邻的借还命令(可能来自不同连接)合并为一批交给executeLoans，
+//      只取一次锁、只等一次日志落盘；其他命令逐条执行
+//   3. 每个连接本轮的全部响应一次写出；写不完的部分等EPOLLOUT再写
+// 连接积压的未发送响应超过上限时暂停读取该连接，直到对端读走响应
+class CirculationServer {
+private:
+    // 单次读取的字节数
+    static constexpr std::size_t kReadChunk = 64 * 1024;
+    // 未发送响应超过该字节数时暂停读取
+    static constexpr std::size_t kMaxBacklog = 1 << 20;
+    // 单次epoll_wait取回的事件数
+    static constexpr int kMaxEvents = 256;
+    // 每次被唤醒时最多接受的连接数，其余留给其他循环
+    static constexpr int kAcceptBurst = 16;
+
+    struct Connection {
+        int fd = -1;
+        std::string in;             // 已读入、尚未凑成整帧的字节
+        BinaryWriter out;           // 待发送的响应
+        std::size_t sent = 0;       // out中已发送的字节数
+        std::uint32_t events = 0;   // 当前在epoll中登记的事件
+        bool closing = false;       // 对端已关闭或协议错误：发完已有响应后关闭
+        bool touched = false;       // 本轮有新的响应或可写事件
+    };
+
+    // 按命令的line(本轮队列中的序号)把响应写到所属连接
+    class RoutingEncoder : public ResponseEncoder {
+    private:
+        const std::vector<Connection*>& owners;
+
+    public:
+        explicit RoutingEncoder(const std::vector<Connection*>& o) : owners(o) {}
+
+        void begin(const Command& cmd) override {
+            target(owners[cmd.line]->out);
+            ResponseEncoder::begin(cmd);
+        }
+    };
+
+    class Loop {
+    private:
+        CirculationServer& server;
+        int epfd = -1;
+        CommandEngine engine;
+        std::vector<std::unique_ptr<Connection>> conns;    // 按fd编号
+        std::vector<Command> pending;                       // 本轮命令队列(跨轮复用容量)
+        std::size_t pendingCount = 0;
+        std::vector<Connection*> owners;                    // 队列中每条命令所属的连接
+        std::vector<Connection*> touched;                   // 本轮需要写出的连接
+        RoutingEncoder writer{owners};
+
+        void watch(Connection& c, std::uint32_t events) {
+            if (events == c.events) return;
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = c.fd;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, c.fd, &ev);
+            c.events = events;
+        }
+
+        // 按积压情况登记读/写事件
+        void updateInterest(Connection& c) {
+            std::size_t backlog = c.out.size() - c.sent;
+            std::uint32_t events = 0;
+            if (!c.closing && backlog < kMaxBacklog) events |= EPOLLIN;
+            if (backlog > 0) events |= EPOLLOUT;
+            watch(c, events);
+        }
+
+        void touch(Connection& c) {
+            if (c.touched) return;
+            c.touched = true;
+            touched.push_back(&c);
+        }
+
+        void drop(Connection& c) {
+            int fd = c.fd;
+            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+            ::close(fd);
+            conns[static_cast<std::size_t>(fd)].reset();
+        }
+
+        void acceptSome() {
+            for (int n = 0; n < kAcceptBurst; ++n) {
+                int fd = ::accept4(server.listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) return;     // EAGAIN：已被其他循环取走；EMFILE等：下次唤醒再试
+                auto c = std::make_unique<Connection>();
+                c->fd = fd;
+                c->events = EPOLLIN;
+                epoll_event ev{};
+                ev.events = EPOLLIN;
+                ev.data.fd = fd;
+                if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                    ::close(fd);
+                    continue;
+                }
+                if (conns.size() <= static_cast<std::size_t>(fd)) conns.resize(fd + 1);
+                conns[static_cast<std::size_t>(fd)] = std::move(c);
+                server.accepted.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        Command& nextCommand() {
+            if (pendingCount == pending.size()) pending.emplace_back();
+            return pending[pendingCount++];
+        }
+
+        // 读入数据并把收齐的请求帧加入本轮队列
+        void receive(Connection& c) {
+            std::size_t old = c.in.size();
+            c.in.resize(old + kReadChunk);
+            ssize_t n = ::read(c.fd, c.in.data() + old, kReadChunk);
+            c.in.resize(old + static_cast<std::size_t>(n > 0 ? n : 0));
+            if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+            touch(c);
+            if (n <= 0) {
+                c.closing = true;
+                c.in.clear();
+                return;
+            }
+            if (c.closing) {
+                c.in.clear();
+                return;
+            }
+
+            std::string_view data = c.in;
+            std::size_t used = 0;
+            try {
+                std::string_view payload;
+                std::size_t frame;
+                while (takeFrame(data.substr(used), payload, frame)) {
+                    Command& cmd = nextCommand();
+                    try {
+                        decodeRequest(payload, cmd);
+                    } catch (...) {
+                        --pendingCount;
+                        throw;
+                    }
+                    cmd.line = owners.size();
+                    owners.push_back(&c);
+                    used += frame;
+                }
+            } catch (const std::exception&) {
+                // 协议错误：此前的请求照常响应，之后关闭连接
+                c.closing = true;
+                used = c.in.size();
+            }
+            c.in.erase(0, used);
+        }
+
+        // 按顺序执行本轮队列
+        void execute() {
+            std::span<const Command> cmds(pending.data(), pendingCount);
+            std::size_t i = 0;
+            while (i < cmds.size()) {
+                if (!CommandEngine::isLoanCommand(cmds[i].type)) {
+                    engine.execute(cmds[i], writer);
+                    ++i;
+                    continue;
+                }
+                std::size_t j = i + 1;
+                while (j < cmds.size() && j - i < CommandEngine::kLoanBatchSize &&
+                       CommandEngine::isLoanCommand(cmds[j].type)) {
+                    ++j;
+                }
+                engine.executeLoans(cmds.subspan(i, j - i), writer);
+                i = j;
+            }
+            server.served.fetch_add(cmds.size(), std::memory_order_relaxed);
+        }
+
+        // 尽量写出连接的全部响应
+        void flush(Connection& c) {
+            const std::string& data = c.out.data();
+            while (c.sent < data.size()) {
+                ssize_t n = ::send(c.fd, data.data() + c.sent, data.size() - c.sent, MSG_NOSIGNAL);
+                if (n > 0) {
+                    c.sent += static_cast<std::size_t>(n);
+                } else if (n < 0 && errno == EINTR) {
+                    continue;
+                } else if (n < 0 && errno == EAGAIN) {
+                    break;
+                } else {
+                    drop(c);
+                    return;
+                }
+            }
+            if (c.sent == data.size()) {
+                c.out.clear();
+                c.sent = 0;
+                if (c.closing) {
+                    drop(c);
+                    return;
+                }
+            }
+            updateInterest(c);
+        }
+
+    public:
+        Loop(CirculationServer& s, Library& lib) : server(s), engine(lib) {
+            epfd = epoll_create1(EPOLL_CLOEXEC);
+            if (epfd < 0) {
+                throw std::runtime_error(std::string("无法创建epoll实例: ") + std::strerror(errno));
+            }
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+            ev.data.fd = server.listenFd;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, server.listenFd, &ev);
+            ev.events = EPOLLIN;
+            ev.data.fd = server.stopFd;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, server.stopFd, &ev);
+        }
+
+        ~Loop() {
+            for (auto& c : conns) {
+                if (c) ::close(c->fd);
+            }
+            ::close(epfd);
+        }
+
+        Loop(const Loop&) = delete;
+        Loop& operator=(const Loop&) = delete;
+
+        void run() {
+            epoll_event events[kMaxEvents];
+            while (true) {
+                int n = epoll_wait(epfd, events, kMaxEvents, -1);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    return;
+                }
+                pendingCount = 0;
+                owners.clear();
+                touched.clear();
+                for (int i = 0; i < n; ++i) {
+                    int fd = events[i].data.fd;
+                    if (fd == server.stopFd) return;
+                    if (fd == server.listenFd) {
+                        acceptSome();
+                        continue;
+                    }
+                    Connection& c = *conns[static_cast<std::size_t>(fd)];
+                    if (events[i].events & EPOLLOUT) touch(c);
+                    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) receive(c);
+                }
+                execute();
+                for (Connection* c : touched) {
+                    c->touched = false;
+                    flush(*c);
+                }
+            }
+        }
+    };
+
+    Library& lib;
+    std::string path;
+    int listenFd = -1;
+    int stopFd = -1;
+    std::vector<std::unique_ptr<Loop>> loops;
+    std::vector<std::thread> threads;
+    std::atomic<std::uint64_t> accepted{0};
+    std::atomic<std::uint64_t> served{0};
+
+    [[noreturn]] void fail(const std::string& what) {
+        std::string message = what + ": " + std::strerror(errno);
+        if (listenFd >= 0) ::close(listenFd);
+        if (stopFd >= 0) ::close(stopFd);
+        listenFd = stopFd = -1;
+        throw std::runtime_error(message);
+    }
+
+public:
+    CirculationServer(Library& library, std::string socketPath)
+        : lib(library), path(std::move(socketPath)) {}
+
+    ~CirculationServer() { stop(); }
+
+    CirculationServer(const CirculationServer&) = delete;
+    CirculationServer& operator=(const CirculationServer&) = delete;
+
+    // 在path上监听并启动loopCount个事件循环线程；path上遗留的套接字文件会被替换
+    void start(unsigned loopCount) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            throw std::invalid_argument("套接字路径为空或过长: " + path);
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) fail("无法创建套接字");
+        ::unlink(path.c_str());
+        if (::bind(listenFd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+            fail("无法绑定套接字 " + path);
+        }
+        if (::listen(listenFd, SOMAXCONN) < 0) fail("无法监听套接字 " + path);
+        stopFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (stopFd < 0) fail("无法创建eventfd");
+
+        loopCount = std::max(1u, loopCount);
+        for (unsigned i = 0; i < loopCount; ++i) loops.push_back(std::make_unique<Loop>(*this, lib));
+        for (auto& loop : loops) threads.emplace_back(&Loop::run, loop.get());
+    }
+
+    // 通知所有循环退出并等待结束，关闭全部连接；可重复调用
+    void stop() {
+        if (stopFd < 0) return;
+        std::uint64_t one = 1;
+        ssize_t ignored = ::write(stopFd, &one, sizeof(one));
+        (void)ignored;
+        for (auto& t : threads) t.join();
+        threads.clear();
+        loops.clear();
+        ::close(listenFd);
+        ::close(stopFd);
+        listenFd = stopFd = -1;
+        ::unlink(path.c_str());
+    }
+
+    // 累计接受的连接数与处理的请求数
+    std::uint64_t connectionsAccepted() const { return accepted.load(std::memory_order_relaxed); }
+    std::uint64_t requestsServed() const { return served.load(std::memory_order_relaxed); }
+};
+
+#endif // __linux__
+
+#endif // CIRCULATION_SERVER_H
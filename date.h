@@ -0,0 +1,176 @@
+#ifndef DATE_H
+#define DATE_H
+
+#include <atomic>
+#include <compare>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+
+// 日期：以自1970-01-01起的天数保存，比较与加减天数都是整数运算
+// 年月日只在显示和解析时换算(公历算法，见Howard Hinnant的days_from_civil)
+class Date {
+private:
+    std::int32_t days;  // 自1970-01-01起的天数
+
+    struct Civil {
+        int year;
+        int month;
+        int day;
+    };
+
+    static constexpr std::int32_t daysFromCivil(int y, int m, int d) {
+        y -= m <= 2;
+        const int era = (y >= 0 ? y : y - 399) / 400;
+        const int yoe = y - era * 400;                                   // [0, 399]
+        const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;  // [0, 365]
+        const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;           // [0, 146096]
+        return era * 146097 + doe - 719468;
+    }
+
+    static constexpr Civil civilFromDays(std::int32_t z) {
+        z += 719468;
+        const int era = (z >= 0 ? z : z - 146096) / 146097;
+        const int doe = z - era * 146097;
+        const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const int mp = (5 * doy + 2) / 153;
+        const int d = doy - (153 * mp + 2) / 5 + 1;
+        const int m = mp + (mp < 10 ? 3 : -9);
+        return Civil{yoe + era * 400 + (m <= 2), m, d};
+    }
+
+    struct DayNumber {};
+    constexpr Date(DayNumber, std::int32_t d) : days(d) {}
+
+public:
+    // 默认构造函数，获取当前日期(读取缓存的时钟，不再每次调用localtime)
+    Date();
+
+    // 带参数的构造函数，指定日期
+    constexpr Date(int y, int m, int d) : days(daysFromCivil(y, m, d)) {}
+
+    // 由天数构造
+    static constexpr Date fromDays(std::int32_t d) { return Date(DayNumber{}, d); }
+
+    // 年月日是否为合法的公历日期
+    static constexpr bool isValid(int y, int m, int d) {
+        if (m < 1 || m > 12 || d < 1) return false;
+        constexpr int kDaysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+        return d <= kDaysInMonth[m - 1] + (m == 2 && leap);
+    }
+
+    // 自1970-01-01起的天数
+    constexpr std::int32_t dayNumber() const { return days; }
+
+    int year() const { return civilFromDays(days).year; }
+    int month() const { return civilFromDays(days).month; }
+    int day() const { return civilFromDays(days).day; }
+
+    // N天之后(N可为负)
+    constexpr Date addDays(int n) const { return fromDays(days + n); }
+    constexpr Date operator+(int n) const { return addDays(n); }
+    constexpr Date operator-(int n) const { return addDays(-n); }
+    // 相差天数
+    constexpr int operator-(const Date& other) const { return days - other.days; }
+
+    constexpr bool operator==(const Date&) const = default;
+    constexpr auto operator<=>(const Date&) const = default;
+
+    // 压缩为32位整数，用于紧凑存储借阅记录(即天数)
+    constexpr std::uint32_t pack() const { return static_cast<std::uint32_t>(days); }
+
+    // 从压缩整数还原日期
+    static constexpr Date unpack(std::uint32_t packed) {
+        return fromDays(static_cast<std::int32_t>(packed));
+    }
+
+    // 按年月日编码(年<<9 | 月<<5 | 日)，快照与日志沿用此格式以兼容已有文件
+    std::uint32_t civilPacked() const {
+        Civil c = civilFromDays(days);
+        return (static_cast<std::uint32_t>(c.year) << 9) | (c.month << 5) | c.day;
+    }
+
+    static constexpr Date fromCivilPacked(std::uint32_t packed) {
+        return Date(static_cast<int>(packed >> 9), (packed >> 5) & 0xF, packed & 0x1F);
+    }
+
+    // 格式化为YYYY-MM-DD
+    std::string toString() const {
+        Civil c = civilFromDays(days);
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d", c.year, c.month, c.day);
+        return buf;
+    }
+};
+
+static_assert(Date(1970, 1, 1).dayNumber() == 0);
+static_assert(Date(2000, 3, 1) - Date(2000, 2, 28) == 2);
+static_assert(Date::fromCivilPacked((2024u << 9) | (6u << 5) | 1u) == Date(2024, 6, 1));
+
+// 缓存的时钟：当天的日期与年份只在跨过本地午夜后重新计算一次
+// 其余调用只读取time()并与缓存的截止时刻比较，可在多线程中并发调用
+class LibraryClock {
+private:
+    struct State {
+        std::atomic<std::int64_t> validUntil{0};  // 缓存有效期截止(time_t)
+        std::atomic<std::int32_t> today{0};       // 当天的天数
+        std::atomic<int> year{0};                 // 当前年份
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+
+    // 线程安全的本地时间换算
+    static std::tm localTime(std::time_t t) {
+        std::tm tm{};
+#ifdef _WIN32
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
+#endif
+        return tm;
+    }
+
+    static void refresh(std::time_t now) {
+        std::tm tm = localTime(now);
+        Date today(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+        // 到下一个本地午夜为止缓存有效
+        std::tm midnight = tm;
+        midnight.tm_hour = 0;
+        midnight.tm_min = 0;
+        midnight.tm_sec = 0;
+        midnight.tm_mday += 1;
+        midnight.tm_isdst = -1;
+        State& s = state();
+        s.today.store(today.dayNumber(), std::memory_order_relaxed);
+        s.year.store(tm.tm_year + 1900, std::memory_order_relaxed);
+        s.validUntil.store(static_cast<std::int64_t>(std::mktime(&midnight)), std::memory_order_release);
+    }
+
+    static State& current() {
+        State& s = state();
+        std::time_t now = std::time(nullptr);
+        if (now >= s.validUntil.load(std::memory_order_acquire)) refresh(now);
+        return s;
+    }
+
+public:
+    // 今天
+    static Date today() {
+        return Date::fromDays(current().today.load(std::memory_order_relaxed));
+    }
+
+    // 当前年份
+    static int currentYear() {
+        return current().year.load(std::memory_order_relaxed);
+    }
+};
+
+inline Date::Date() : days(LibraryClock::today().dayNumber()) {}
+
+#endif // DATE_H
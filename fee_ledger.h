@@ -0,0 +1,137 @@
+#ifndef FEE_LEDGER_H
+#define FEE_LEDGER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "transaction_log.h"
+
+// 欠费台账：以整数分记账，增量维护欠费读者集合与欠费总额
+// 欠费读者按(金额, 读者句柄)有序保存，查询只遍历欠费读者本身，
+// 分页使用游标(上一页最后一条的金额与句柄)，翻页代价与页大小成正比
+
+// 金额(分)
+using Cents = std::int64_t;
+
+// 换算成分后能放进Cents的金额上限(不含)：2^63分
+constexpr double kCentsLimit = 9223372036854775808.0;
+
+// 能否换算成分：有限且不超出Cents的范围(nan、inf与过大的值交给llround是未定义行为)
+inline bool isCentsRepresentable(double amount) {
+    return std::isfinite(amount) && std::fabs(amount * 100) < kCentsLimit;
+}
+
+// 合法的欠费金额(元)：非负且能换算成分
+inline bool isValidFeeAmount(double amount) {
+    return amount >= 0 && isCentsRepresentable(amount);
+}
+
+// 元转换为分(四舍五入)，无法换算时抛出异常
+inline Cents toCents(double amount) {
+    if (!isCentsRepresentable(amount)) throw std::invalid_argument("金额超出范围");
+    return static_cast<Cents>(std::llround(amount * 100));
+}
+
+// 分格式化为"元.角分"
+inline std::string formatCents(Cents cents) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%s%lld.%02lld", cents < 0 ? "-" : "",
+                  static_cast<long long>(std::llabs(cents) / 100),
+                  static_cast<long long>(std::llabs(cents) % 100));
+    return buf;
+}
+
+// 欠费排序方式
+enum class FeeOrder : std::uint8_t {
+    descending,     // 金额从高到低
+    ascending       // 金额从低到高
+};
+
+// 分页游标：上一页最后一条记录
+struct DebtorCursor {
+    Cents amount;
+    PatronId patron;
+};
+
+class FeeLedger {
+private:
+    mutable std::mutex mutex;
+    std::set<std::pair<Cents, PatronId>> debtors;  // 欠费读者，按金额升序
+    Cents total = 0;                                // 欠费总额
+
+public:
+    // 读者欠费由oldAmount变为newAmount(调用方保证同一读者的更新有序)
+    void update(PatronId patron, Cents oldAmount, Cents newAmount) {
+        if (oldAmount == newAmount) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (oldAmount > 0) debtors.erase({oldAmount, patron});
+        if (newAmount > 0) debtors.insert({newAmount, patron});
+        total += std::max<Cents>(newAmount, 0) - std::max<Cents>(oldAmount, 0);
+    }
+
+    // 欠费读者人数
+    std::size_t debtorCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return debtors.size();
+    }
+
+    // 欠费总额
+    Cents totalOutstanding() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total;
+    }
+
+    // 按金额从高到低遍历全部欠费读者，回调f(读者句柄, 金额)
+    template <typename F>
+    void forEach(F&& f) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = debtors.rbegin(); it != debtors.rend(); ++it) f(it->second, it->first);
+    }
+
+    // 取一页欠费读者，after为空表示从头开始；回调f(读者句柄, 金额)
+    // 返回本页最后一条作为下一页游标，已无更多记录时返回空
+    template <typename F>
+    std::optional<DebtorCursor> page(FeeOrder order, const std::optional<DebtorCursor>& after,
+                                     std::size_t limit, F&& f) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::optional<DebtorCursor> last;
+        std::size_t n = 0;
+        if (order == FeeOrder::ascending) {
+            auto it = after ? debtors.upper_bound({after->amount, after->patron}) : debtors.begin();
+            for (; it != debtors.end() && n < limit; ++it, ++n) {
+                f(it->second, it->first);
+                last = DebtorCursor{it->first, it->second};
+            }
+            if (it == debtors.end()) return std::nullopt;
+        } else {
+            auto it = after ? std::make_reverse_iterator(debtors.lower_bound({after->amount, after->patron}))
+                            : debtors.rbegin();
+            for (; it != debtors.rend() && n < limit; ++it, ++n) {
+                f(it->second, it->first);
+                last = DebtorCursor{it->first, it->second};
+            }
+            if (it == debtors.rend()) return std::nullopt;
+        }
+        return last;
+    }
+
+    // 清空台账
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        debtors.clear();
+        total = 0;
+    }
+};
+
+#endif // FEE_LEDGER_H
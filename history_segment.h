@@ -0,0 +1,246 @@
+#ifndef HISTORY_SEGMENT_H
+#define HISTORY_SEGMENT_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.h"
+#include "slot_map.h"
+
+// 已封存的借阅历史分段：一个月份的借阅记录压缩后只读保存，可选写入文件并以内存映射方式访问
+//
+// 编码：每kBlockRecords条记录为一块，块内各记录依次为
+//   varint(zigzag(日期 - 上一条日期) << 1 | 事件类型)  varint(书籍句柄)  varint(读者句柄)
+// 每块的第一条以0为上一条日期。句柄在未删除过元素时等于插入下标，varint通常只占1~3字节，
+// 日期在月内基本不减，差值多为0，一条记录平均约5~7字节(列式原始存储为13字节)
+// 块的起始偏移另存一张表，按序号访问只需解码一块
+//
+// 每个分段带书籍与读者两个布隆过滤器，按书籍/读者查询历史时据此跳过不含该书/该读者的分段
+
+namespace segment_detail {
+
+inline void putVarint(std::string& out, std::uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+inline std::uint64_t getVarint(const unsigned char*& p) {
+    std::uint64_t v = 0;
+    for (unsigned shift = 0;; shift += 7) {
+        unsigned char b = *p++;
+        v |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return v;
+    }
+}
+
+inline std::uint64_t zigzag(std::int64_t v) {
+    return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+inline std::int64_t unzigzag(std::uint64_t v) {
+    return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+inline std::uint64_t mixKey(std::uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+} // namespace segment_detail
+
+// 布隆过滤器：每个键约10位、3个哈希(双重哈希)，误判率约2%，不会漏判
+class SegmentBloom {
+private:
+    static constexpr unsigned kHashes = 3;
+    static constexpr std::size_t kBitsPerKey = 10;
+
+    std::vector<std::uint64_t> words;
+
+public:
+    // keys须已去重
+    void build(const std::vector<SlotHandle>& keys) {
+        std::size_t bits = std::max<std::size_t>(64, keys.size() * kBitsPerKey);
+        words.assign((bits + 63) / 64, 0);
+        for (SlotHandle k : keys) {
+            std::uint64_t h = segment_detail::mixKey(k);
+            for (unsigned i = 0; i < kHashes; ++i) {
+                std::uint64_t bit = (h + i * (h >> 32 | 1)) % (words.size() * 64);
+                words[bit / 64] |= std::uint64_t(1) << (bit % 64);
+            }
+        }
+    }
+
+    bool mayContain(SlotHandle k) const {
+        if (words.empty()) return false;
+        std::uint64_t h = segment_detail::mixKey(k);
+        for (unsigned i = 0; i < kHashes; ++i) {
+            std::uint64_t bit = (h + i * (h >> 32 | 1)) % (words.size() * 64);
+            if (!(words[bit / 64] & (std::uint64_t(1) << (bit % 64)))) return false;
+        }
+        return true;
+    }
+
+    std::size_t bytes() const { return words.size() * sizeof(std::uint64_t); }
+};
+
+// 分段的统计信息，分段被压缩为摘要后只保留这些
+struct SegmentStats {
+    std::uint64_t records = 0;
+    std::uint64_t checkouts = 0;
+    std::uint64_t returns = 0;
+    std::uint64_t distinctBooks = 0;
+    std::uint64_t distinctPatrons = 0;
+    std::int32_t minDay = std::numeric_limits<std::int32_t>::max();   // 最早的记录日期(天数)
+    std::int32_t maxDay = std::numeric_limits<std::int32_t>::min();   // 最晚的记录日期(天数)
+};
+
+// 解码出的一块记录，各字段分列存放
+struct SegmentBlock {
+    static constexpr std::size_t kCapacity = 128;
+
+    std::array<SlotHandle, kCapacity> books;
+    std::array<SlotHandle, kCapacity> patrons;
+    std::array<std::uint32_t, kCapacity> dates;
+    std::array<std::uint8_t, kCapacity> types;
+    std::size_t count = 0;
+};
+
+class SealedSegment {
+public:
+    static constexpr std::size_t kBlockRecords = SegmentBlock::kCapacity;
+
+private:
+    std::string owned;                      // 未写入文件时的编码内容
+    std::unique_ptr<MappedFile> mapped;     // 写入文件后的映射
+    std::string_view bytes;                 // 指向owned或mapped
+    std::vector<std::uint32_t> blockOffsets;
+    SegmentBloom bookFilter;
+    SegmentBloom patronFilter;
+    SegmentStats segmentStats;
+    std::string spillPath;
+
+public:
+    // 由n条记录编码，get(i, 书籍, 读者, 日期, 类型)按顺序取第i条；checkout为借出事件的类型值
+    template <typename Get>
+    SealedSegment(std::size_t n, std::uint8_t checkout, Get&& get) {
+        std::vector<SlotHandle> bookKeys, patronKeys;
+        bookKeys.reserve(n);
+        patronKeys.reserve(n);
+        owned.reserve(n * 6);
+        blockOffsets.reserve(n / kBlockRecords + 1);
+        std::int64_t previous = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            if (i % kBlockRecords == 0) {
+                blockOffsets.push_back(static_cast<std::uint32_t>(owned.size()));
+                previous = 0;
+            }
+            SlotHandle book, patron;
+            std::uint32_t date;
+            std::uint8_t type;
+            get(i, book, patron, date, type);
+            auto day = static_cast<std::int32_t>(date);
+            segment_detail::putVarint(owned, segment_detail::zigzag(day - previous) << 1 | (type & 1));
+            segment_detail::putVarint(owned, book);
+            segment_detail::putVarint(owned, patron);
+            previous = day;
+            bookKeys.push_back(book);
+            patronKeys.push_back(patron);
+            ++segmentStats.records;
+            if (type == checkout) ++segmentStats.checkouts;
+            else ++segmentStats.returns;
+            segmentStats.minDay = std::min(segmentStats.minDay, day);
+            segmentStats.maxDay = std::max(segmentStats.maxDay, day);
+        }
+        if (owned.size() > std::numeric_limits<std::uint32_t>::max()) {
+            throw std::length_error("借阅历史分段过大");
+        }
+        owned.shrink_to_fit();
+        bytes = owned;
+        for (auto* keys : {&bookKeys, &patronKeys}) {
+            std::sort(keys->begin(), keys->end());
+            keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+        }
+        segmentStats.distinctBooks = bookKeys.size();
+        segmentStats.distinctPatrons = patronKeys.size();
+        bookFilter.build(bookKeys);
+        patronFilter.build(patronKeys);
+    }
+
+    ~SealedSegment() {
+        if (!spillPath.empty()) {
+            mapped.reset();
+            std::remove(spillPath.c_str());
+        }
+    }
+
+    SealedSegment(const SealedSegment&) = delete;
+    SealedSegment& operator=(const SealedSegment&) = delete;
+
+    const SegmentStats& stats() const { return segmentStats; }
+    std::size_t size() const { return segmentStats.records; }
+    std::size_t blockCount() const { return blockOffsets.size(); }
+
+    // 编码内容的字节数(不含块偏移表与过滤器)
+    std::size_t encodedBytes() const { return bytes.size(); }
+    // 常驻内存的字节数(已写入文件时不含编码内容)
+    std::size_t residentBytes() const {
+        return owned.capacity() + blockOffsets.capacity() * sizeof(std::uint32_t) +
+               bookFilter.bytes() + patronFilter.bytes();
+    }
+    bool isSpilled() const { return mapped != nullptr; }
+
+    bool mayContainBook(SlotHandle book) const { return bookFilter.mayContain(book); }
+    bool mayContainPatron(SlotHandle patron) const { return patronFilter.mayContain(patron); }
+
+    // 解码第b块
+    void decodeBlock(std::size_t b, SegmentBlock& out) const {
+        const auto* p = reinterpret_cast<const unsigned char*>(bytes.data()) + blockOffsets[b];
+        out.count = std::min(kBlockRecords, size() - b * kBlockRecords);
+        std::int64_t previous = 0;
+        for (std::size_t i = 0; i < out.count; ++i) {
+            std::uint64_t head = segment_detail::getVarint(p);
+            previous += segment_detail::unzigzag(head >> 1);
+            out.dates[i] = static_cast<std::uint32_t>(previous);
+            out.types[i] = static_cast<std::uint8_t>(head & 1);
+            out.books[i] = static_cast<SlotHandle>(segment_detail::getVarint(p));
+            out.patrons[i] = static_cast<SlotHandle>(segment_detail::getVarint(p));
+        }
+    }
+
+    // 把编码内容写入文件并改为内存映射访问，释放内存中的副本；对象析构时删除该文件
+    void spill(const std::string& path) {
+        if (isSpilled()) return;
+        std::FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) {
+            throw std::runtime_error("无法写入历史分段: " + path);
+        }
+        bool ok = std::fwrite(owned.data(), 1, owned.size(), f) == owned.size();
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok) {
+            std::remove(path.c_str());
+            throw std::runtime_error("写入历史分段失败: " + path);
+        }
+        mapped = std::make_unique<MappedFile>(path);
+        spillPath = path;
+        bytes = mapped->view();
+        std::string().swap(owned);
+    }
+};
+
+#endif // HISTORY_SEGMENT_H
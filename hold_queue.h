@@ -0,0 +1,293 @@
+#ifndef HOLD_QUEUE_H
+#define HOLD_QUEUE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "slot_map.h"
+#include "transaction_log.h"
+
+// 预约槽编号
+using HoldId = std::uint32_t;
+
+// 一条预约的概况
+struct HoldInfo {
+    BookId book = kInvalidHandle;
+    PatronId patron = kInvalidHandle;
+    std::uint32_t date = 0;         // 预约日期(天数)
+    std::uint8_t priority = 0;      // 优先级，越大越先分配
+    bool suspended = false;         // 读者欠费期间暂停，不参与分配
+    std::size_t queued = 0;         // 该书的预约总数(含暂停的)
+};
+
+// 预约队列：每种书一个按(优先级从高到低, 预约先后)排序的二叉堆，每位读者的预约串成一条双向链表
+// 堆中只放可分配的预约，堆顶即下一位；读者欠费时其预约移出各书的堆(暂停)，还清后按原先的次序放回，
+// 因此归还时取下一位读者无需跳过欠费读者：预约、取消、分配、暂停与恢复都是O(log n)，n为该书的预约数
+// 每条预约记下自己在堆中的位置，从堆中间取消也是O(log n)
+// 书籍/读者表项按句柄的槽位号存放，预约中保存完整句柄
+//
+// 并发(由Library保证)：
+//   - 容量调整在独占锁下进行
+//   - 预约、取消与分配持有该书与该读者的分片锁；暂停与恢复只持有该读者的分片锁
+//   - 其余状态由内部互斥锁保护，总在分片锁之内获取；某书的预约总数只在持有该书分片锁时修改，
+//     持有书籍分片锁即可不经内部锁读取
+class HoldIndex {
+public:
+    static constexpr HoldId kNoHold = 0xFFFFFFFFu;
+    static constexpr std::uint8_t kMaxPriority = 3;
+
+private:
+    static constexpr std::uint32_t kNotQueued = 0xFFFFFFFFu;
+
+    struct Hold {
+        BookId book = kInvalidHandle;
+        PatronId patron = kInvalidHandle;
+        std::uint64_t seq = 0;              // 预约先后
+        std::uint32_t date = 0;
+        std::uint32_t heapPos = kNotQueued; // 在该书堆中的位置，暂停时为kNotQueued
+        HoldId prev = kNoHold;              // 同一读者链表中的前一条
+        HoldId next = kNoHold;              // 同一读者链表中的后一条
+        std::uint8_t priority = 0;
+        bool used = false;
+    };
+
+    struct BookQueue {
+        std::vector<HoldId> heap;
+        std::uint32_t count = 0;            // 预约总数(含暂停的)
+    };
+
+    struct PatronHolds {
+        HoldId head = kNoHold;
+        std::uint32_t count = 0;
+    };
+
+    std::vector<Hold> holds;
+    std::vector<HoldId> freeHolds;
+    std::vector<BookQueue> books;
+    std::vector<PatronHolds> patrons;
+    std::uint64_t nextSeq = 0;
+    std::size_t total = 0;
+    mutable std::mutex mutex;
+
+    // a是否排在b之前
+    bool before(HoldId a, HoldId b) const {
+        const Hold& x = holds[a];
+        const Hold& y = holds[b];
+        return x.priority != y.priority ? x.priority > y.priority : x.seq < y.seq;
+    }
+
+    void place(std::vector<HoldId>& heap, std::size_t i, HoldId id) {
+        heap[i] = id;
+        holds[id].heapPos = static_cast<std::uint32_t>(i);
+    }
+
+    void siftUp(std::vector<HoldId>& heap, std::size_t i) {
+        HoldId id = heap[i];
+        while (i > 0) {
+            std::size_t parent = (i - 1) / 2;
+            if (!before(id, heap[parent])) break;
+            place(heap, i, heap[parent]);
+            i = parent;
+        }
+        place(heap, i, id);
+    }
+
+    void siftDown(std::vector<HoldId>& heap, std::size_t i) {
+        HoldId id = heap[i];
+        for (;;) {
+            std::size_t child = 2 * i + 1;
+            if (child >= heap.size()) break;
+            if (child + 1 < heap.size() && before(heap[child + 1], heap[child])) ++child;
+            if (!before(heap[child], id)) break;
+            place(heap, i, heap[child]);
+            i = child;
+        }
+        place(heap, i, id);
+    }
+
+    void enqueue(HoldId id) {
+        std::vector<HoldId>& heap = books[slotIndex(holds[id].book)].heap;
+        heap.push_back(id);
+        siftUp(heap, heap.size() - 1);
+    }
+
+    void dequeue(HoldId id) {
+        Hold& hold = holds[id];
+        if (hold.heapPos == kNotQueued) return;
+        std::vector<HoldId>& heap = books[slotIndex(hold.book)].heap;
+        std::size_t i = hold.heapPos;
+        hold.heapPos = kNotQueued;
+        HoldId last = heap.back();
+        heap.pop_back();
+        if (last == id) return;
+        place(heap, i, last);
+        siftUp(heap, i);
+        siftDown(heap, holds[last].heapPos);
+    }
+
+    HoldId findLocked(BookId book, PatronId patron) const {
+        for (HoldId id = patrons[slotIndex(patron)].head; id != kNoHold; id = holds[id].next) {
+            if (holds[id].book == book) return id;
+        }
+        return kNoHold;
+    }
+
+    void release(HoldId id) {
+        Hold& hold = holds[id];
+        dequeue(id);
+        PatronHolds& list = patrons[slotIndex(hold.patron)];
+        if (hold.prev != kNoHold) holds[hold.prev].next = hold.next;
+        else list.head = hold.next;
+        if (hold.next != kNoHold) holds[hold.next].prev = hold.prev;
+        --list.count;
+        --books[slotIndex(hold.book)].count;
+        hold = Hold();
+        freeHolds.push_back(id);
+        --total;
+    }
+
+    HoldInfo describe(HoldId id) const {
+        const Hold& hold = holds[id];
+        return HoldInfo{hold.book, hold.patron, hold.date, hold.priority, hold.heapPos == kNotQueued,
+                        books[slotIndex(hold.book)].count};
+    }
+
+public:
+    // 随馆藏/读者增长调整容量
+    void resizeBooks(std::size_t n) { books.resize(n); }
+    void resizePatrons(std::size_t n) { patrons.resize(n); }
+
+    // 该书的预约总数(含暂停的)；调用方持有该书的分片锁或独占锁
+    std::size_t bookHoldCount(BookId book) const { return books[slotIndex(book)].count; }
+
+    // 读者的预约数
+    std::size_t patronHoldCount(PatronId patron) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return patrons[slotIndex(patron)].count;
+    }
+
+    // 全部预约数
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return total;
+    }
+
+    // 读者是否预约了该书
+    bool contains(BookId book, PatronId patron) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return findLocked(book, patron) != kNoHold;
+    }
+
+    // 登记预约，排在同优先级已有预约之后；suspended为true时先暂停(读者欠费)
+    // 调用方保证该读者没有预约该书
+    void add(BookId book, PatronId patron, std::uint32_t date, std::uint8_t priority, bool suspended) {
+        std::lock_guard<std::mutex> lock(mutex);
+        HoldId id;
+        if (freeHolds.empty()) {
+            id = static_cast<HoldId>(holds.size());
+            holds.emplace_back();
+        } else {
+            id = freeHolds.back();
+            freeHolds.pop_back();
+        }
+        Hold& hold = holds[id];
+        PatronHolds& list = patrons[slotIndex(patron)];
+        hold.book = book;
+        hold.patron = patron;
+        hold.seq = nextSeq++;
+        hold.date = date;
+        hold.priority = std::min(priority, kMaxPriority);
+        hold.prev = kNoHold;
+        hold.next = list.head;
+        hold.used = true;
+        if (list.head != kNoHold) holds[list.head].prev = id;
+        list.head = id;
+        ++list.count;
+        ++books[slotIndex(book)].count;
+        ++total;
+        if (!suspended) enqueue(id);
+    }
+
+    // 取消读者对该书的预约(取消或已借到)，没有该预约时返回false
+    bool remove(BookId book, PatronId patron) {
+        std::lock_guard<std::mutex> lock(mutex);
+        HoldId id = findLocked(book, patron);
+        if (id == kNoHold) return false;
+        release(id);
+        return true;
+    }
+
+    // 该书下一位可分配的读者，没有时返回kInvalidHandle
+    PatronId next(BookId book) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        const std::vector<HoldId>& heap = books[slotIndex(book)].heap;
+        return heap.empty() ? kInvalidHandle : holds[heap.front()].patron;
+    }
+
+    // 排在该读者之前的可分配预约数，数到limit即停止；该读者没有可分配的预约时为该书全部可分配预约数
+    // 需要遍历该书的堆，O(n)
+    std::size_t countAhead(BookId book, PatronId patron, std::size_t limit) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        const std::vector<HoldId>& heap = books[slotIndex(book)].heap;
+        HoldId mine = findLocked(book, patron);
+        if (mine == kNoHold || holds[mine].heapPos == kNotQueued) return std::min(heap.size(), limit);
+        std::size_t ahead = 0;
+        for (HoldId id : heap) {
+            if (ahead >= limit) break;
+            if (before(id, mine)) ++ahead;
+        }
+        return ahead;
+    }
+
+    // 暂停/恢复读者的全部预约(欠费状态变化时)；恢复后按原先的优先级与预约先后排队
+    void suspend(PatronId patron) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (HoldId id = patrons[slotIndex(patron)].head; id != kNoHold; id = holds[id].next) dequeue(id);
+    }
+
+    void resume(PatronId patron) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (HoldId id = patrons[slotIndex(patron)].head; id != kNoHold; id = holds[id].next) {
+            if (holds[id].heapPos == kNotQueued) enqueue(id);
+        }
+    }
+
+    // 遍历读者的预约，回调f(HoldInfo)，最近预约的在前
+    template <typename F>
+    void forEachHold(PatronId patron, F&& f) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (HoldId id = patrons[slotIndex(patron)].head; id != kNoHold; id = holds[id].next) {
+            f(static_cast<const HoldInfo&>(describe(id)));
+        }
+    }
+
+    // 按预约先后遍历全部预约(写入快照用)，回调f(HoldInfo)
+    template <typename F>
+    void forEachInOrder(F&& f) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::pair<std::uint64_t, HoldId>> order;
+        order.reserve(total);
+        for (HoldId id = 0; id < holds.size(); ++id) {
+            if (holds[id].used) order.emplace_back(holds[id].seq, id);
+        }
+        std::sort(order.begin(), order.end());
+        for (const auto& [seq, id] : order) f(static_cast<const HoldInfo&>(describe(id)));
+    }
+
+    // 清空
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        holds.clear();
+        freeHolds.clear();
+        books.clear();
+        patrons.clear();
+        nextSeq = 0;
+        total = 0;
+    }
+};
+
+#endif // HOLD_QUEUE_H
@@ -1,13 +1,24 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <regex>
 #include <stdexcept>
 #include <algorithm>
-#include <ctime>
-#include <windows.h>
-#include <vector>
 #include <limits>    // 用于清除输入缓冲区
+#include <fstream>
+
+#include "library.h"
+#include "library_commands.h"
+#include "circulation_server.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __linux__
+#include <csignal>
+#include <ctime>
+#include <sys/resource.h>
+#endif
 
 #ifndef LIBRARY_SYSTEM_H
 #define LIBRARY_SYSTEM_H
@@ -16,8 +27,7 @@
 class Book;
 class Patron;
 class Library;
-struct Date;
-struct Transaction;
+class Date;
 
 // 菜单函数前向声明
 void initializeSampleData(Library& lib);
@@ -25,255 +35,263 @@ void addBookMenu(Library& lib);
 void addPatronMenu(Library& lib);
 void checkoutBookMenu(Library& lib);
 void returnBookMenu(Library& lib);
-void displayAllBooks(const Library& lib);
-void displayAllPatrons(const Library& lib);
-void displayTransactions(const Library& lib);
-void displayDebtors(const Library& lib);
+void displayAllBooks(Library& lib);
+void displayAllPatrons(Library& lib);
+void displayTransactions(Library& lib);
+void displayDebtors(Library& lib);
+void importCatalogMenu(Library& lib);
+void searchBooksMenu(Library& lib);
+void displayPatronLoans(Library& lib);
+void accrueFinesMenu(Library& lib);
+void removeBookMenu(Library& lib);
+void removePatronMenu(Library& lib);
+void exportReportMenu(Library& lib);
+void metricsMenu(Library& lib);
+void addCopiesMenu(Library& lib);
+void displayHoldings(Library& lib);
+void queryBooksMenu(Library& lib);
+void circulationRankingMenu(Library& lib);
+void historyMenu(Library& lib);
+void holdsMenu(Library& lib);
+int runBatchMode(int argc, char* argv[]);
+int runServeMode(int argc, char* argv[]);
 
 #endif // LIBRARY_SYSTEM_H
 
-// 获取当前年份的独立工具函数
-int getCurrentYear() {
-    std::time_t t = std::time(nullptr);  // 获取当前时间
-    std::tm* now = std::localtime(&t);   // 转换为本地时间结构
-    return (now->tm_year + 1900);        // tm_year是从1900开始的年数
-}
-
-// 书籍枚举类型
-enum class Genre {
-    fiction,      // 小说
-    nonfiction,   // 非小说类文学作品
-    periodical,   // 期刊
-    biography,    // 传记
-    children      // 儿童读物
-};
-
-// 日期结构体，用于记录借阅日期
-struct Date {
-    int year;    // 年
-    int month;   // 月
-    int day;     // 日
-
-    // 默认构造函数，获取当前日期
-    Date() {
-        time_t now = time(0);       // 获取当前时间
-        tm *ltm = localtime(&now);  // 转换为本地时间结构
-        year = 1900 + ltm->tm_year; // 年份(从1900开始)
-        month = 1 + ltm->tm_mon;    // 月份(0-11)
-        day = ltm->tm_mday;         // 日
-    }
-
-    // 带参数的构造函数，指定日期
-    Date(int y, int m, int d) : year(y), month(m), day(d) {}
-};
-
-// 图书类
-class Book {
+// 交互式前端的结果输出：按菜单原有格式打印到控制台
+// 每条命令的输出先写入缓冲，命令结束时一次写出
+class ConsoleWriter : public ResultWriter {
 private:
-    std::string isbn;       // ISBN号
-    std::string title;      // 书名
-    std::string author;     // 作者
-    int copyrightYear;      // 版权年份
-    Genre genre;            // 书籍类型
-    bool isCheckedOut;      // 是否借出
+    CommandType current = CommandType::listBooks;
+    std::size_t rows = 0;
+    std::string lastError;
+    std::string nextPage;
+    OutputBuffer out{std::cout};
 
-    // ISBN验证函数(n-n-n-x格式)
-    bool isValidISBN(const std::string& isbn) {
-        std::regex pattern("^\\d+-\\d+-\\d+-[a-zA-Z0-9]$");
-        return std::regex_match(isbn, pattern);
+public:
+    void begin(const Command& cmd) override {
+        current = cmd.type;
+        rows = 0;
+        nextPage.clear();
     }
 
-public:
-    // 构造函数
-    Book(const std::string& i, const std::string& t, const std::string& a, int year, Genre g)
-        : title(t), author(a), copyrightYear(year), genre(g), isCheckedOut(false) {
-        if (!isValidISBN(i)) {
-            throw std::invalid_argument("无效的ISBN格式，应为n-n-n-x");
-        }
-        isbn = i;
-    }
-
-    // 获取ISBN号
-    std::string getISBN() const { return isbn; }
-    // 获取书名
-    std::string getTitle() const { return title; }
-    // 获取作者
-    std::string getAuthor() const { return author; }
-    // 获取版权年份
-    int getCopyrightYear() const { return copyrightYear; }
-    // 获取书籍类型
-    Genre getGenre() const { return genre; }
-    // 获取借阅状态
-    bool getCheckoutStatus() const { return isCheckedOut; }
-
-    // 借出书籍
-    void checkOut() { 
-        if (isCheckedOut) {
-            throw std::runtime_error("书籍已被借出");
+    void book(const Book& book) override {
+        ++rows;
+        if (current == CommandType::checkin) {
+            out.put("\n【成功】《").put(book.getTitle()).put("》已成功归还！\n");
+            return;
         }
-        isCheckedOut = true; 
-        std::cout << "【成功】书籍借出成功！\n";  // 添加成功提示
-    }
-    
-    // 归还书籍
-    void returnBook() { 
-        if (!isCheckedOut) {
-            throw std::runtime_error("书籍未被借出");
+        out.put("书名: ").put(book.getTitle())
+           .put("\n作者: ").put(book.getAuthor())
+           .put("\nISBN: ").put(book.getISBN())
+           .put("\n类型: ").put(genreName(book.getGenre()))
+           .put("\n状态: ").put(book.getCheckoutStatus() ? "已借出" : "可借");
+        if (book.getCopies() > 1) {
+            out.put("(共").putInt(book.getCopies()).put("本，可借").putInt(book.getAvailableCopies()).put("本)");
         }
-        isCheckedOut = false;
-        std::cout << "【成功】书籍归还成功！\n";  // 添加成功提示
+        out.put("\n-----------------\n");
+        out.endRow();
     }
 
-    // 重载==运算符，比较ISBN号
-    bool operator==(const Book& other) const { return isbn == other.isbn; }
-    // 重载!=运算符
-    bool operator!=(const Book& other) const { return !(*this == other); }
+    void patron(const Patron& patron) override {
+        ++rows;
+        out.put("姓名: ").put(patron.getName())
+           .put("\n借书证号: ").putInt(patron.getCardNumber())
+           .put("\n欠费: ").putCents(patron.getFeeCents())
+           .put("元\n-----------------\n");
+        out.endRow();
+    }
 
-    // 友元函数，重载输出运算符
-    friend std::ostream& operator<<(std::ostream& os, const Book& book);
-};
+    void transaction(const Transaction& trans, const Book& book, const Patron& patron) override {
+        ++rows;
+        // 通过句柄解析读者与书籍名称
+        out.put("读者: ").put(patron.getName())
+           .put("\n书籍: ").put(book.getTitle())
+           .put(trans.type == TransactionType::checkin ? "\n归还日期: " : "\n借出日期: ")
+           .putDate(Date::unpack(trans.date))
+           .put("\n-----------------\n");
+        out.endRow();
+    }
 
-// 重载<<运算符，输出书籍信息
-std::ostream& operator<<(std::ostream& os, const Book& book) {
-    os << "书名: " << book.title << "\n"
-       << "作者: " << book.author << "\n"
-       << "ISBN: " << book.isbn << "\n"
-       << "类型: ";
-    // 根据枚举值输出类型名称
-    switch(book.genre) {
-        case Genre::fiction: os << "小说"; break;
-        case Genre::nonfiction: os << "非小说类文学作品"; break;
-        case Genre::periodical: os << "期刊"; break;
-        case Genre::biography: os << "传记"; break;
-        case Genre::children: os << "儿童读物"; break;
-    }
-    return os;
-}
+    void debtor(const Patron& patron, Cents amount) override {
+        ++rows;
+        out.put(patron.getName()).put("(借书证号 ").putInt(patron.getCardNumber())
+           .put(")  欠费: ").putCents(amount).put("元\n");
+        out.endRow();
+    }
 
-// 读者类
-class Patron {
-private:
-    std::string name;       // 读者姓名
-    int cardNumber;         // 借书证号
-    double fees;            // 欠费金额
+    void debtorSummary(std::size_t count, Cents total, const std::string& next) override {
+        nextPage = next;
+        if (count > 0) {
+            out.put("共").putInt(static_cast<long long>(count)).put("名欠费读者，欠费合计")
+               .putCents(total).put("元\n");
+        }
+    }
 
-public:
-    // 构造函数
-    Patron(const std::string& n, int cn) : name(n), cardNumber(cn), fees(0) {}
+    void pageEnd(const std::string& next) override { nextPage = next; }
 
-    // 获取读者姓名
-    std::string getName() const { return name; }
-    // 获取借书证号
-    int getCardNumber() const { return cardNumber; }
-    // 获取欠费金额
-    double getFees() const { return fees; }
+    void exported(const ExportSummary& r, const std::string& path) override {
+        out.put("已导出 ").putInt(static_cast<long long>(r.rows)).put(" 条记录到 ").put(path)
+           .put("，共 ").putInt(static_cast<long long>(r.bytes)).put(" 字节，用时 ")
+           .put(std::to_string(r.seconds)).put(" 秒\n");
+    }
 
-    // 检查是否有欠费
-    bool owesFees() const { return fees > 0; }
+    void metrics(const Metrics::Snapshot& snapshot) override {
+        char line[160];
+        for (std::size_t op = 0; op < kCommandTypeCount; ++op) {
+            const OperationStats& o = snapshot[op];
+            if (o.count == 0) continue;
+            // 表头中的汉字占两列，手工对齐
+            if (rows++ == 0) out.put("操作              次数    失败    平均(us)     p50(us)     p90(us)     p99(us)    最大(us)\n");
+            std::snprintf(line, sizeof(line), "%-12s%10llu%8llu%12.1f%12.1f%12.1f%12.1f%12.1f\n",
+                          std::string(commandName(static_cast<CommandType>(op))).c_str(),
+                          static_cast<unsigned long long>(o.count), static_cast<unsigned long long>(o.failures),
+                          o.averageNs() / 1000, o.percentileNs(0.5) / 1000.0, o.percentileNs(0.9) / 1000.0,
+                          o.percentileNs(0.99) / 1000.0, o.maxNs() / 1000.0);
+            out.put(line);
+            for (const auto& [reason, count] : o.reasons) {
+                out.put("    失败: ").put(reason).put(" × ").putInt(static_cast<long long>(count)).put("\n");
+            }
+        }
+        if (!Metrics::global().enabled()) out.put("(统计已关闭)\n");
+    }
 
-    // 设置欠费金额
-    void setFees(double f) {
-        if (f < 0) throw std::invalid_argument("欠费金额不能为负数");
-        fees = f;
+    void holdings(Genre genre, const GenreHoldings& h) override {
+        ++rows;
+        out.put(genreName(genre)).put(": ").putInt(static_cast<long long>(h.titles)).put("种，")
+           .putInt(static_cast<long long>(h.copies)).put("本，借出")
+           .putInt(static_cast<long long>(h.onLoan)).put("本，可借")
+           .putInt(static_cast<long long>(h.available())).put("本\n");
     }
-};
 
-// 借阅记录结构体
-struct Transaction {
-    Book book;      // 借阅的书籍
-    Patron patron;  // 借阅的读者
-    Date date;      // 借阅日期
-};
+    void matchCount(std::size_t n) override {
+        out.put("共").putInt(static_cast<long long>(n)).put("本书符合条件\n");
+    }
 
-// 图书馆类
-class Library {
-private:
-    std::vector<Book> books;                // 馆藏书籍集合
-    std::vector<Patron> patrons;            // 注册读者集合
-    std::vector<Transaction> transactions;  // 借阅记录集合
+    void rankedBook(const Book& book, std::uint64_t count) override {
+        ++rows;
+        out.putInt(static_cast<long long>(rows)).put(". 《").put(book.getTitle()).put("》 ")
+           .put(book.getAuthor()).put("  借出").putInt(static_cast<long long>(count)).put("次\n");
+        out.endRow();
+    }
 
-public:
+    void rankedAuthor(std::string_view author, std::uint64_t count) override {
+        ++rows;
+        out.putInt(static_cast<long long>(rows)).put(". ").put(author)
+           .put("  借出").putInt(static_cast<long long>(count)).put("次\n");
+        out.endRow();
+    }
 
-    // const std::vector<Book>& getBooks() const { return books; }
-    // const std::vector<Patron>& getPatrons() const { return patrons; }
-    // const std::vector<Transaction>& getTransactions() const { return transactions; }
-    // 添加书籍到图书馆
-    void addBook(const Book& book) {
-        books.push_back(book);
+    void genreCirculation(Genre genre, std::uint64_t checkouts, std::uint64_t returns) override {
+        ++rows;
+        out.put(genreName(genre)).put(": 借出").putInt(static_cast<long long>(checkouts))
+           .put("次，归还").putInt(static_cast<long long>(returns)).put("次\n");
+        out.endRow();
     }
 
-    // 添加读者到图书馆
-    void addPatron(const Patron& patron) {
-        patrons.push_back(patron);
+    void trendingBook(const Book& book, const TrendingTitle& t) override {
+        char lift[32];
+        std::snprintf(lift, sizeof(lift), "%.1f", t.lift);
+        ++rows;
+        out.putInt(static_cast<long long>(rows)).put(". 《").put(book.getTitle()).put("》 ")
+           .put(book.getAuthor()).put("  近期借出").putInt(static_cast<long long>(t.recent))
+           .put("次，为平时的").put(lift).put("倍\n");
+        out.endRow();
     }
 
-    // 借出书籍
-    void checkOutBook(const Book& book, const Patron& patron, const Date& date) {
-        // 检查书籍是否在馆藏中
-        auto bookIt = std::find(books.begin(), books.end(), book);
-        if (bookIt == books.end()) {
-            throw std::runtime_error("图书馆中没有这本书");
-        }
+    void hold(const HoldInfo& h, const Book& book) override {
+        ++rows;
+        if (current == CommandType::placeHold) out.put("\n【成功】已预约");
+        out.put("《").put(book.getTitle()).put("》 ISBN: ").put(book.getISBN())
+           .put("\n预约日期: ").putDate(Date::unpack(h.date))
+           .put("  优先级: ").putInt(h.priority)
+           .put("  该书共").putInt(static_cast<long long>(h.queued)).put("人预约");
+        if (h.suspended) out.put("\n(欠费期间暂停，还清后恢复排队)");
+        out.put("\n-----------------\n");
+        out.endRow();
+    }
 
-        // 检查读者是否注册
-        auto patronIt = std::find_if(patrons.begin(), patrons.end(),
-            [&patron](const Patron& p) { return p.getCardNumber() == patron.getCardNumber(); });
-        if (patronIt == patrons.end()) {
-            throw std::runtime_error("读者未注册");
-        }
+    void holdFilled(const Book& book, const Patron& patron) override {
+        out.put("《").put(book.getTitle()).put("》已借给预约读者 ").put(patron.getName())
+           .put("(借书证号 ").putInt(patron.getCardNumber()).put(")\n");
+    }
 
-        // 检查读者是否有欠费
-        if (patronIt->owesFees()) {
-            throw std::runtime_error("读者有欠费，不能借书");
+    void historySegment(const HistorySegmentInfo& h) override {
+        static constexpr std::string_view kStateNames[] = {"当前", "已关闭", "已封存", "已压缩"};
+        char month[16];
+        std::snprintf(month, sizeof(month), "%04d-%02d", h.year(), h.monthOfYear());
+        ++rows;
+        out.put(month).put("  ").put(kStateNames[static_cast<std::size_t>(h.state)])
+           .put("  记录").putInt(static_cast<long long>(h.stats.records))
+           .put("条(借出").putInt(static_cast<long long>(h.stats.checkouts))
+           .put("，归还").putInt(static_cast<long long>(h.stats.returns)).put(")");
+        if (h.stats.records > 0) {
+            out.put("  ").putDate(Date::fromDays(h.stats.minDay)).put("~").putDate(Date::fromDays(h.stats.maxDay));
         }
-
-        // 检查书籍是否可借
-        if (bookIt->getCheckoutStatus()) {
-            throw std::runtime_error("书籍已被借出");
+        if (h.state == SegmentState::sealed) {
+            out.put("  编码").putInt(static_cast<long long>(h.encodedBytes)).put("字节/原始")
+               .putInt(static_cast<long long>(h.rawBytes)).put("字节");
+            if (h.spilled) out.put("(已落盘)");
+        } else if (h.state == SegmentState::compacted) {
+            out.put("  保留在借记录").putInt(static_cast<long long>(h.retained)).put("条");
         }
-
-        // 创建借阅记录
-        transactions.push_back(Transaction{*bookIt, *patronIt, date});
-
-        // 更新书籍状态为已借出
-        const_cast<Book&>(*bookIt).checkOut();
+        out.put("\n");
+        out.endRow();
     }
 
-    // 获取所有欠费读者名单
-    std::vector<std::string> getPatronsWithFees() const {
-        std::vector<std::string> result;
-        for (const auto& patron : patrons) {
-            if (patron.owesFees()) {
-                result.push_back(patron.getName());
-            }
-        }
-        return result;
-    }
-    const std::vector<Book>& getBooks() const {
-        return books;
-    }
-    
-    const std::vector<Patron>& getPatrons() const {
-        return patrons;
+    void fineRun(const FineRunSummary& r) override {
+        out.put("结算日: ").putDate(r.asOf)
+           .put("\n在借 ").putInt(static_cast<long long>(r.openLoans))
+           .put(" 笔，逾期 ").putInt(static_cast<long long>(r.overdueLoans))
+           .put(" 笔，本次新增罚款 ").putInt(static_cast<long long>(r.finedLoans))
+           .put(" 笔\n涉及读者 ").putInt(static_cast<long long>(r.patronsCharged))
+           .put(" 人，新增罚款合计 ").putCents(r.posted).put("元\n");
     }
-    
-    // 获取所有借阅记录
-    const std::vector<Transaction>& getTransactions() const {
-        return transactions;
+
+    void end(const Command&, bool ok, const std::string& error) override {
+        if (!ok) lastError = error;
+        out.flush();
+        std::cout.flush();
     }
-};
 
+    std::size_t rowCount() const { return rows; }
+    const std::string& error() const { return lastError; }
+    // 分页查询的下一页游标，没有下一页时为空
+    const std::string& nextCursor() const { return nextPage; }
+};
 
+// 通过命令层执行一条命令并输出到控制台；失败时抛出异常，由主循环统一提示
+std::size_t runCommand(Library& lib, CommandType type, std::vector<std::string> args = {},
+                       ConsoleWriter* writer = nullptr) {
+    ConsoleWriter local;
+    ConsoleWriter& console = writer ? *writer : local;
+    CommandEngine engine(lib);
+    if (!engine.execute(Command{type, std::move(args)}, console)) {
+        throw std::runtime_error(console.error());
+    }
+    return console.rowCount();
+}
 
-int main() {
+int main(int argc, char* argv[]) {
+#ifdef _WIN32
     // 设置控制台编码为UTF-8以支持中文
     SetConsoleOutputCP(65001);
+#endif
+    
+    // 带参数启动时进入批处理或服务模式
+    if (argc > 1) {
+        if (std::string(argv[1]) == "--serve") return runServeMode(argc, argv);
+        return runBatchMode(argc, argv);
+    }
     
     Library library;
     bool running = true;
     
-    // 初始化一些测试数据
-    initializeSampleData(library);
+    // 从快照和日志恢复；首次运行时初始化一些测试数据
+    LibraryStore store(library, "library");
+    if (!store.open()) {
+        initializeSampleData(library);
+    }
     
     while (running) {
         std::cout << "\n====== 图书馆管理系统 ======\n";
@@ -285,6 +303,20 @@ int main() {
         std::cout << "6. 查看所有读者\n";
         std::cout << "7. 查看借阅记录\n";
         std::cout << "8. 查看欠费读者\n";
+        std::cout << "9. 批量导入书籍/读者\n";
+        std::cout << "10. 按书名/作者搜索\n";
+        std::cout << "11. 查看读者在借书籍\n";
+        std::cout << "12. 逾期罚款结算\n";
+        std::cout << "13. 删除书籍\n";
+        std::cout << "14. 注销读者\n";
+        std::cout << "15. 导出报表(CSV/JSON)\n";
+        std::cout << "16. 运行统计\n";
+        std::cout << "17. 增加副本\n";
+        std::cout << "18. 按类型查看馆藏\n";
+        std::cout << "19. 组合条件查询书籍\n";
+        std::cout << "20. 借阅排行与走红书籍\n";
+        std::cout << "21. 借阅历史查询与归档\n";
+        std::cout << "22. 图书预约\n";
         std::cout << "0. 退出系统\n";
         std::cout << "请选择操作: ";
         
@@ -304,6 +336,20 @@ int main() {
                 case 6: displayAllPatrons(library); break;
                 case 7: displayTransactions(library); break;
                 case 8: displayDebtors(library); break;
+                case 9: importCatalogMenu(library); break;
+                case 10: searchBooksMenu(library); break;
+                case 11: displayPatronLoans(library); break;
+                case 12: accrueFinesMenu(library); break;
+                case 13: removeBookMenu(library); break;
+                case 14: removePatronMenu(library); break;
+                case 15: exportReportMenu(library); break;
+                case 16: metricsMenu(library); break;
+                case 17: addCopiesMenu(library); break;
+                case 18: displayHoldings(library); break;
+                case 19: queryBooksMenu(library); break;
+                case 20: circulationRankingMenu(library); break;
+                case 21: historyMenu(library); break;
+                case 22: holdsMenu(library); break;
                 case 0: 
                     running = false;
                     std::cout << "感谢使用图书馆管理系统！\n";
@@ -314,8 +360,11 @@ int main() {
         } catch (const std::exception& e) {
             std::cerr << "操作失败: " << e.what() << "\n";
         }
+        store.checkpointIfNeeded();
     }
     
+    // 退出前生成快照，下次启动无需重放日志
+    store.checkpoint();
     return 0;
 }
 
@@ -353,14 +402,12 @@ void addBookMenu(Library& lib) {
             return;
         }
         
-        // 创建临时Book对象验证ISBN
-        try {
-            Book tempBook(isbn, "", "", 0, Genre::fiction); // 会触发ISBN验证
-            break; // 如果没抛出异常，说明ISBN有效
-        } catch (const std::invalid_argument& e) {
-            std::cerr << "错误: " << e.what() << "\n";
-            std::cerr << "请重新输入或输入q退出\n";
+        // 直接调用ISBN校验器，无需构造临时Book对象
+        if (isValidIsbnFormat(isbn)) {
+            break;
         }
+        std::cerr << "错误: 无效的ISBN格式，应为n-n-n-x\n";
+        std::cerr << "请重新输入或输入q退出\n";
     }
     
     // 2. ISBN验证通过后，继续输入其他信息
@@ -436,9 +483,15 @@ void addBookMenu(Library& lib) {
         }
     }
     
-    // 5. 创建并添加书籍
-    Genre genre = static_cast<Genre>(genreChoice - 1);
-    lib.addBook(Book(isbn, title, author, year, genre));
+    // 5. 输入副本数(可选)
+    std::string copies;
+    std::cout << "副本数(直接回车为1本): ";
+    std::getline(std::cin, copies);
+    if (copies.empty()) copies = "1";
+
+    // 6. 创建并添加书籍
+    runCommand(lib, CommandType::addBook,
+               {isbn, title, author, std::to_string(year), std::to_string(genreChoice), copies});
     std::cout << "\n【成功】《" << title << "》已添加到图书馆！\n";
 }
 
@@ -527,12 +580,7 @@ void addPatronMenu(Library& lib) {
     }
 
     // 4. 创建并添加读者
-    Patron patron(name, cardNumber);
-    if (fees > 0) {
-        patron.setFees(fees);
-    }
-    
-    lib.addPatron(patron);
+    runCommand(lib, CommandType::addPatron, {name, std::to_string(cardNumber), std::to_string(fees)});
     std::cout << "\n【成功】读者 " << name << " (证号:" << cardNumber << ") 已注册！";
     if (fees > 0) {
         std::cout << " 欠费:" << fees << "元";
@@ -553,11 +601,19 @@ void checkoutBookMenu(Library& lib) {
     std::cin >> cardNumber;
     std::cin.ignore();
     
-    // 创建临时对象用于查找
-    Book tempBook(isbn, "", "", 0, Genre::fiction);
-    Patron tempPatron("", cardNumber);
-    
-    lib.checkOutBook(tempBook, tempPatron, Date());
+    try {
+        runCommand(lib, CommandType::checkout, {isbn, std::to_string(cardNumber)});
+    } catch (const std::exception& e) {
+        // 没有可借副本时可以预约排队，还书后自动借给排在最前的读者
+        if (std::string(e.what()) != loanStatusMessage(LoanStatus::alreadyCheckedOut) &&
+            std::string(e.what()) != loanStatusMessage(LoanStatus::reservedForHolds)) throw;
+        std::cout << "该书暂无可借副本，是否预约？(y/n): ";
+        std::string answer;
+        std::getline(std::cin, answer);
+        if (answer != "y" && answer != "Y") return;
+        runCommand(lib, CommandType::placeHold, {isbn, std::to_string(cardNumber)});
+        return;
+    }
     std::cout << "\n【成功】书籍借出成功！\n";
 }
 
@@ -568,69 +624,515 @@ void returnBookMenu(Library& lib) {
     std::cout << "\n=== 归还书籍 ===\n";
     std::cout << "输入要归还的书籍ISBN: ";
     std::getline(std::cin, isbn);
+    std::string card;
+    std::cout << "借书证号(该书只有一本在借时可直接回车): ";
+    std::getline(std::cin, card);
     
-    // 在图书馆中查找这本书
-    bool found = false;
-    for (Book& book : const_cast<std::vector<Book>&>(lib.getBooks())) {
-        if (book.getISBN() == isbn) {
-            if (!book.getCheckoutStatus()) {
-                throw std::runtime_error("这本书没有被借出");
-            }
-            book.returnBook();
-            std::cout << "\n【成功】《" << book.getTitle() << "》已成功归还！\n";
-            found = true;
-            break;
-        }
+    // 通过ISBN索引直接定位书籍并归还
+    std::vector<std::string> args{isbn};
+    if (!card.empty()) args.push_back(card);
+    runCommand(lib, CommandType::checkin, args);
+}
+
+// 分页显示查询结果：每页20条，按回车翻页；args为条数之前的参数
+// 没有任何结果时返回false
+bool displayPaged(Library& lib, CommandType type, std::vector<std::string> args) {
+    const std::string pageRows = "20";
+    args.push_back(pageRows);
+    ConsoleWriter console;
+    if (runCommand(lib, type, args, &console) == 0 && console.nextCursor().empty()) {
+        return false;
     }
-    
-    if (!found) {
-        throw std::runtime_error("未找到该ISBN的书籍");
+    while (!console.nextCursor().empty()) {
+        std::cout << "按回车显示下一页，输入q返回: ";
+        std::string input;
+        std::getline(std::cin, input);
+        if (!std::cin || input == "q" || input == "Q") break;
+        std::vector<std::string> page = args;
+        page.push_back(console.nextCursor());
+        runCommand(lib, type, page, &console);
     }
+    return true;
 }
 
 // 显示所有书籍
-void displayAllBooks(const Library& lib) {
+void displayAllBooks(Library& lib) {
     std::cout << "\n=== 馆藏书籍 ===\n";
-    for (const Book& book : lib.getBooks()) {
-        std::cout << book << "\n";
-        std::cout << "状态: " << (book.getCheckoutStatus() ? "已借出" : "可借") << "\n";
-        std::cout << "-----------------\n";
+    if (!displayPaged(lib, CommandType::listBooks, {})) {
+        std::cout << "馆藏中还没有书籍\n";
     }
 }
 
 // 显示所有读者
-void displayAllPatrons(const Library& lib) {
+void displayAllPatrons(Library& lib) {
     std::cout << "\n=== 注册读者 ===\n";
-    for (const Patron& patron : lib.getPatrons()) {
-        std::cout << "姓名: " << patron.getName() << "\n";
-        std::cout << "借书证号: " << patron.getCardNumber() << "\n";
-        std::cout << "欠费: " << patron.getFees() << "元\n";
-        std::cout << "-----------------\n";
+    if (!displayPaged(lib, CommandType::listPatrons, {})) {
+        std::cout << "还没有注册读者\n";
     }
 }
 
 // 显示借阅记录
-void displayTransactions(const Library& lib) {
-    const auto& transactions = lib.getTransactions();
+void displayTransactions(Library& lib) {
     std::cout << "\n=== 借阅记录 ===\n";
-    for (const auto& trans : transactions) {
-        std::cout << "读者: " << trans.patron.getName() << "\n";
-        std::cout << "书籍: " << trans.book.getTitle() << "\n";
-        std::cout << "借出日期: " << trans.date.year << "-" 
-                  << trans.date.month << "-" << trans.date.day << "\n";
-        std::cout << "-----------------\n";
+    if (!displayPaged(lib, CommandType::listTransactions, {})) {
+        std::cout << "还没有借阅记录\n";
+    }
+}
+
+// 导出报表菜单
+void exportReportMenu(Library& lib) {
+    std::string kind, format, path;
+
+    std::cout << "\n=== 导出报表 ===\n";
+    std::cout << "导出内容(books/patrons/transactions): ";
+    std::getline(std::cin, kind);
+    std::cout << "导出格式(csv/json): ";
+    std::getline(std::cin, format);
+    std::cout << "输出文件路径(默认" << kind << "." << format << "): ";
+    std::getline(std::cin, path);
+    if (path.empty()) {
+        path = kind + "." + format;
+    }
+
+    runCommand(lib, CommandType::exportReport, {kind, format, path});
+}
+
+// 显示某位读者当前在借的书籍
+void displayPatronLoans(Library& lib) {
+    int cardNumber;
+
+    std::cout << "\n=== 读者在借书籍 ===\n";
+    std::cout << "输入读者借书证号: ";
+    std::cin >> cardNumber;
+    std::cin.ignore();
+
+    if (runCommand(lib, CommandType::listLoans, {std::to_string(cardNumber)}) == 0) {
+        std::cout << "该读者当前没有在借书籍\n";
+    }
+}
+
+// 逾期罚款结算菜单
+void accrueFinesMenu(Library& lib) {
+    std::string date;
+
+    std::cout << "\n=== 逾期罚款结算 ===\n";
+    std::cout << "结算日(YYYY-MM-DD，直接回车为今天): ";
+    std::getline(std::cin, date);
+
+    std::vector<std::string> args;
+    if (!date.empty()) args.push_back(date);
+    runCommand(lib, CommandType::accrueFines, args);
+}
+
+// 删除书籍菜单
+void removeBookMenu(Library& lib) {
+    std::string isbn;
+
+    std::cout << "\n=== 删除书籍 ===\n";
+    std::cout << "输入要删除的书籍ISBN: ";
+    std::getline(std::cin, isbn);
+
+    runCommand(lib, CommandType::removeBook, {isbn});
+    std::cout << "\n【成功】书籍已从馆藏中删除！\n";
+}
+
+// 注销读者菜单
+void removePatronMenu(Library& lib) {
+    int cardNumber;
+
+    std::cout << "\n=== 注销读者 ===\n";
+    std::cout << "输入要注销的读者借书证号: ";
+    std::cin >> cardNumber;
+    std::cin.ignore();
+
+    runCommand(lib, CommandType::removePatron, {std::to_string(cardNumber)});
+    std::cout << "\n【成功】读者已注销！\n";
+}
+
+// 运行统计菜单：显示各操作的次数、失败与耗时分布，可清零、开关或写入文件
+void metricsMenu(Library& lib) {
+    std::cout << "\n=== 运行统计 ===\n";
+    if (runCommand(lib, CommandType::showMetrics) == 0) {
+        std::cout << "还没有统计数据\n";
+    }
+    std::cout << "输入reset清零，on/off开启或关闭统计，或输入文件路径导出(直接回车返回): ";
+    std::string input;
+    std::getline(std::cin, input);
+    if (input.empty()) return;
+    if (input == "reset" || input == "on" || input == "off") {
+        runCommand(lib, CommandType::showMetrics, {input});
+        std::cout << "\n【成功】已" << (input == "reset" ? "清零" : input == "on" ? "开启统计" : "关闭统计") << "\n";
+    } else {
+        runCommand(lib, CommandType::showMetrics, {"dump", input});
+        std::cout << "\n【成功】统计已写入 " << input << "\n";
+    }
+}
+
+// 增加副本菜单
+void addCopiesMenu(Library& lib) {
+    std::string isbn, count;
+
+    std::cout << "\n=== 增加副本 ===\n";
+    std::cout << "输入书籍ISBN: ";
+    std::getline(std::cin, isbn);
+    std::cout << "增加的副本数: ";
+    std::getline(std::cin, count);
+
+    runCommand(lib, CommandType::addCopies, {isbn, count});
+    std::cout << "\n【成功】已增加" << count << "本副本！\n";
+}
+
+// 按类型查看馆藏
+void displayHoldings(Library& lib) {
+    std::cout << "\n=== 按类型查看馆藏 ===\n";
+    runCommand(lib, CommandType::showHoldings);
+}
+
+// 组合条件查询菜单：各条件均可直接回车跳过
+void queryBooksMenu(Library& lib) {
+    std::string genre, years, status;
+
+    std::cout << "\n=== 组合条件查询书籍 ===\n";
+    std::cout << "书籍类型(1.小说 2.非小说 3.期刊 4.传记 5.儿童): ";
+    std::getline(std::cin, genre);
+    std::cout << "出版年份范围(如1990-2000，可省略一端): ";
+    std::getline(std::cin, years);
+    std::cout << "状态(1.可借 2.已借出): ";
+    std::getline(std::cin, status);
+
+    std::vector<std::string> args;
+    if (!genre.empty()) args.push_back("genre=" + genre);
+    if (!years.empty()) args.push_back("year=" + years);
+    if (status == "1") args.push_back("status=available");
+    else if (status == "2") args.push_back("status=lent");
+    else if (!status.empty()) throw std::invalid_argument("无效的状态");
+
+    if (!displayPaged(lib, CommandType::queryBooks, args)) {
+        std::cout << "没有符合条件的书籍\n";
+    }
+}
+
+// 借阅排行菜单：日期直接回车表示当天
+void circulationRankingMenu(Library& lib) {
+    std::string choice, period, date;
+
+    std::cout << "\n=== 借阅排行与走红书籍 ===\n";
+    std::cout << "1. 热门书籍 2. 热门作者 3. 类型借阅 4. 近期走红: ";
+    std::getline(std::cin, choice);
+    if (choice != "4") {
+        std::cout << "统计周期(1.当日 2.本周): ";
+        std::getline(std::cin, period);
+    }
+    std::cout << "日期(YYYY-MM-DD，直接回车为今天): ";
+    std::getline(std::cin, date);
+
+    std::vector<std::string> args;
+    CommandType type = CommandType::topCirculation;
+    if (choice == "1") args.push_back("titles");
+    else if (choice == "2") args.push_back("authors");
+    else if (choice == "3") args.push_back("genres");
+    else if (choice == "4") type = CommandType::trending;
+    else throw std::invalid_argument("无效的选项");
+    if (period == "2") args.push_back("week");
+    if (!date.empty()) args.push_back(date);
+
+    if (runCommand(lib, type, args) == 0) {
+        std::cout << "该时段没有借阅记录\n";
+    }
+}
+
+// 借阅历史菜单：查询时各条件均可直接回车跳过
+void historyMenu(Library& lib) {
+    std::string choice;
+
+    std::cout << "\n=== 借阅历史查询与归档 ===\n";
+    std::cout << "1. 查询历史 2. 查看分段 3. 压缩早期历史: ";
+    std::getline(std::cin, choice);
+
+    if (choice == "1") {
+        std::string from, to, isbn, card;
+        std::cout << "起始日期(YYYY-MM-DD): ";
+        std::getline(std::cin, from);
+        std::cout << "截止日期(YYYY-MM-DD): ";
+        std::getline(std::cin, to);
+        std::cout << "书籍ISBN: ";
+        std::getline(std::cin, isbn);
+        std::cout << "借书证号: ";
+        std::getline(std::cin, card);
+
+        std::vector<std::string> args;
+        if (!from.empty()) args.push_back("from=" + from);
+        if (!to.empty()) args.push_back("to=" + to);
+        if (!isbn.empty()) args.push_back("book=" + isbn);
+        if (!card.empty()) args.push_back("patron=" + card);
+        if (!displayPaged(lib, CommandType::queryHistory, args)) {
+            std::cout << "没有符合条件的借阅记录\n";
+        }
+    } else if (choice == "2") {
+        if (runCommand(lib, CommandType::listSegments, {"seal"}) == 0) {
+            std::cout << "还没有借阅记录\n";
+        }
+    } else if (choice == "3") {
+        std::string date;
+        std::cout << "压缩此日期之前的历史(YYYY-MM-DD): ";
+        std::getline(std::cin, date);
+        std::size_t n = runCommand(lib, CommandType::compactHistory, {date});
+        std::cout << "\n【成功】已压缩" << n << "个月份的历史，仍在借的记录已保留\n";
+    } else {
+        throw std::invalid_argument("无效的选项");
+    }
+}
+
+// 图书预约菜单
+void holdsMenu(Library& lib) {
+    std::string choice, card;
+
+    std::cout << "\n=== 图书预约 ===\n";
+    std::cout << "1. 预约书籍 2. 取消预约 3. 查看读者预约: ";
+    std::getline(std::cin, choice);
+
+    if (choice == "1" || choice == "2") {
+        std::string isbn;
+        std::cout << "输入书籍ISBN: ";
+        std::getline(std::cin, isbn);
+        std::cout << "输入读者借书证号: ";
+        std::getline(std::cin, card);
+        if (choice == "1") {
+            std::string priority;
+            std::cout << "优先级(0-3，直接回车为0): ";
+            std::getline(std::cin, priority);
+            std::vector<std::string> args{isbn, card};
+            if (!priority.empty()) args.push_back(priority);
+            runCommand(lib, CommandType::placeHold, args);
+        } else {
+            runCommand(lib, CommandType::cancelHold, {isbn, card});
+            std::cout << "\n【成功】已取消预约\n";
+        }
+    } else if (choice == "3") {
+        std::cout << "输入读者借书证号: ";
+        std::getline(std::cin, card);
+        if (runCommand(lib, CommandType::listHolds, {card}) == 0) {
+            std::cout << "该读者当前没有预约\n";
+        }
+    } else {
+        throw std::invalid_argument("无效的选项");
     }
 }
 
-// 显示欠费读者
-void displayDebtors(const Library& lib) {
-    auto debtors = lib.getPatronsWithFees();
+// 搜索书籍菜单
+void searchBooksMenu(Library& lib) {
+    std::string keyword;
+
+    std::cout << "\n=== 搜索书籍 ===\n";
+    std::cout << "输入书名或作者关键词(以*结尾表示前缀查询): ";
+    std::getline(std::cin, keyword);
+
+    std::vector<std::string> args{keyword};
+    if (!keyword.empty() && keyword.back() == '*') {
+        args[0].pop_back();
+        args.push_back("prefix");
+    }
+    if (runCommand(lib, CommandType::search, args) == 0) {
+        std::cout << "没有找到匹配的书籍\n";
+    }
+}
+
+// 显示欠费读者(按欠费从高到低，每页20条)
+void displayDebtors(Library& lib) {
     std::cout << "\n=== 欠费读者 ===\n";
-    if (debtors.empty()) {
+    if (!displayPaged(lib, CommandType::listDebtors, {"desc"})) {
         std::cout << "当前没有欠费读者\n";
-    } else {
-        for (const auto& name : debtors) {
-            std::cout << name << "\n";
+    }
+}
+
+// 批量导入菜单
+void importCatalogMenu(Library& lib) {
+    std::string booksPath, patronsPath, reportPath;
+
+    std::cout << "\n=== 批量导入 ===\n";
+    std::cout << "书籍文件路径(.csv/.tsv，直接回车跳过): ";
+    std::getline(std::cin, booksPath);
+    std::cout << "读者文件路径(.csv/.tsv，直接回车跳过): ";
+    std::getline(std::cin, patronsPath);
+    std::cout << "错误报告输出路径(默认import_errors.csv): ";
+    std::getline(std::cin, reportPath);
+    if (reportPath.empty()) {
+        reportPath = "import_errors.csv";
+    }
+
+    ImportOptions options;
+    options.maxYear = getCurrentYear();
+
+    std::ofstream report;
+    std::size_t rejected = 0;
+    auto reportErrors = [&](const std::string& source, std::vector<ImportError>& errors) {
+        if (errors.empty()) return;
+        if (!report.is_open()) {
+            report.open(reportPath);
+            if (!report) throw std::runtime_error("无法写入错误报告: " + reportPath);
         }
+        std::sort(errors.begin(), errors.end(),
+                  [](const ImportError& a, const ImportError& b) { return a.line < b.line; });
+        writeImportErrors(report, source, errors);
+        rejected += errors.size();
+    };
+
+    if (!booksPath.empty()) {
+        MappedFile file(booksPath);
+        options.delimiter = delimiterForPath(booksPath);
+        options.skipHeader = hasHeaderRow(file.view(), "isbn");
+        auto batch = parseBookRecords(file.view(), options);
+        std::size_t added = lib.addBooks(batch.rows, batch.errors);
+        reportErrors(booksPath, batch.errors);
+        std::cout << "【成功】导入书籍 " << added << " 本\n";
     }
-}
\ No newline at end of file
+
+    if (!patronsPath.empty()) {
+        MappedFile file(patronsPath);
+        options.delimiter = delimiterForPath(patronsPath);
+        options.skipHeader = hasHeaderRow(file.view(), "name");
+        auto batch = parsePatronRecords(file.view(), options);
+        std::size_t added = lib.addPatrons(batch.rows, batch.errors);
+        reportErrors(patronsPath, batch.errors);
+        std::cout << "【成功】导入读者 " << added << " 名\n";
+    }
+
+    if (rejected > 0) {
+        std::cout << "被拒绝的行共 " << rejected << " 条，详见 " << reportPath << "\n";
+    }
+}
+
+// 批处理模式：homework1 --batch <命令文件|-> [--output <结果文件>] [--store <数据路径前缀>]
+// 不指定--store时在空的内存图书馆上执行，不读写持久化数据
+int runBatchMode(int argc, char* argv[]) {
+    std::string input, output, storePath, metricsPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc) {
+            input = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--store" && i + 1 < argc) {
+            storePath = argv[++i];
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else {
+            std::cerr << "用法: " << argv[0]
+                      << " --batch <命令文件|-> [--output <结果文件>] [--store <数据路径前缀>]"
+                      << " [--metrics <统计文件>]\n";
+            return 2;
+        }
+    }
+    if (input.empty()) {
+        std::cerr << "缺少--batch参数\n";
+        return 2;
+    }
+
+    try {
+        Library library;
+        std::unique_ptr<LibraryStore> store;
+        if (!storePath.empty()) {
+            store = std::make_unique<LibraryStore>(library, storePath);
+            store->open();
+        }
+
+        std::ifstream file;
+        if (input != "-") {
+            file.open(input);
+            if (!file) throw std::runtime_error("无法打开命令文件: " + input);
+        }
+        std::ofstream result;
+        if (!output.empty()) {
+            result.open(output);
+            if (!result) throw std::runtime_error("无法写入结果文件: " + output);
+        }
+
+        std::istream& in = input == "-" ? std::cin : file;
+        std::ostream& out = output.empty() ? std::cout : result;
+        BatchSummary summary = runCommandBatch(library, in, out);
+
+        if (store) store->checkpoint();
+        if (!metricsPath.empty()) writeMetricsFile(metricsPath);
+        std::cerr << "已执行 " << summary.commands << " 条命令，失败 " << summary.failed
+                  << " 条，用时 " << summary.seconds << " 秒，"
+                  << static_cast<long long>(summary.opsPerSecond()) << " 条/秒\n";
+        return summary.failed == 0 && summary.malformed == 0 ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "批处理失败: " << e.what() << "\n";
+        return 2;
+    }
+}
+
+// 服务模式：homework1 --serve <套接字路径> [--store <数据路径前缀>] [--threads <事件循环线程数>]
+// 各分馆终端连接同一个套接字共享一份馆藏；收到SIGINT/SIGTERM时停止服务并生成快照
+int runServeMode(int argc, char* argv[]) {
+#ifdef __linux__
+    std::string socketPath, storePath;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--serve" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "--store" && i + 1 < argc) {
+            storePath = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            int n;
+            if (!import_detail::parseInt(argv[++i], n) || n <= 0) {
+                std::cerr << "无效的线程数\n";
+                return 2;
+            }
+            threads = static_cast<unsigned>(n);
+        } else {
+            std::cerr << "用法: " << argv[0]
+                      << " --serve <套接字路径> [--store <数据路径前缀>] [--threads <事件循环线程数>]\n";
+            return 2;
+        }
+    }
+
+    try {
+        // 每个终端占一个连接，把打开文件数的软上限提到硬上限
+        rlimit files;
+        if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+            files.rlim_cur = files.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &files);
+        }
+
+        Library library;
+        std::unique_ptr<LibraryStore> store;
+        if (!storePath.empty()) {
+            store = std::make_unique<LibraryStore>(library, storePath);
+            store->open();
+        }
+
+        // 在启动事件循环线程之前屏蔽退出信号，由主线程统一等待
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        CirculationServer server(library, socketPath);
+        server.start(threads);
+        std::cerr << "借还服务已启动: " << socketPath << "，" << threads << " 个事件循环线程\n";
+
+        // 等待退出信号，期间每秒检查一次是否需要生成快照
+        timespec tick{1, 0};
+        while (sigtimedwait(&signals, nullptr, &tick) < 0) {
+            if (store) store->checkpointIfNeeded();
+        }
+        server.stop();
+        if (store) store->checkpoint();
+        std::cerr << "服务已停止：共接受 " << server.connectionsAccepted() << " 个连接，处理 "
+                  << server.requestsServed() << " 条请求\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "服务启动失败: " << e.what() << "\n";
+        return 2;
+    }
+#else
+    (void)argc;
+    (void)argv;
+    std::cerr << "服务模式仅支持Linux\n";
+    return 2;
+#endif
+}
@@ -0,0 +1,146 @@
+#ifndef ISBN_VALIDATOR_H
+#define ISBN_VALIDATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// ISBN校验规则
+// 书籍只接受n-n-n-x格式的ISBN，各规则都先检查格式，校验和规则在此之上再加校验
+enum class IsbnPolicy : std::uint8_t {
+    format,     // 仅检查n-n-n-x格式(系统默认规则)
+    isbn10,     // 格式 + ISBN-10校验和(忽略连字符，末位可为X)
+    isbn13,     // 格式 + ISBN-13校验和(忽略连字符)
+    checksum    // 格式 + ISBN-10或ISBN-13任一校验和
+};
+
+namespace isbn_detail {
+
+constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+constexpr bool isAlnum(char c) {
+    return isDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+} // namespace isbn_detail
+
+// 检查n-n-n-x格式：三组非空数字以'-'分隔，最后一位为单个字母或数字
+// 手写状态机实现，不分配内存，可在编译期求值
+constexpr bool isValidIsbnFormat(std::string_view s) {
+    int group = 0;          // 当前读取的数字组(0-2)，3表示读取末位
+    bool hasDigit = false;  // 当前数字组是否已读到数字
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (group < 3) {
+            if (isbn_detail::isDigit(c)) {
+                hasDigit = true;
+            } else if (c == '-' && hasDigit) {
+                ++group;
+                hasDigit = false;
+            } else {
+                return false;
+            }
+        } else {
+            // 末位必须恰好一个字符
+            return i + 1 == s.size() && isbn_detail::isAlnum(c);
+        }
+    }
+    return false;
+}
+
+// ISBN-10校验：10位(末位可为X)，加权和(权重10..1)能被11整除
+constexpr bool isValidIsbn10(std::string_view s) {
+    int count = 0;
+    int sum = 0;
+    for (char c : s) {
+        if (c == '-') continue;
+        int value;
+        if (isbn_detail::isDigit(c)) {
+            value = c - '0';
+        } else if ((c == 'X' || c == 'x') && count == 9) {
+            value = 10;
+        } else {
+            return false;
+        }
+        if (count == 10) return false;
+        sum += value * (10 - count);
+        ++count;
+    }
+    return count == 10 && sum % 11 == 0;
+}
+
+// ISBN-13校验：13位数字，按1,3交替加权和能被10整除
+constexpr bool isValidIsbn13(std::string_view s) {
+    int count = 0;
+    int sum = 0;
+    for (char c : s) {
+        if (c == '-') continue;
+        if (!isbn_detail::isDigit(c) || count == 13) return false;
+        sum += (c - '0') * (count % 2 == 0 ? 1 : 3);
+        ++count;
+    }
+    return count == 13 && sum % 10 == 0;
+}
+
+// 按指定规则校验单个ISBN；通过任一规则的ISBN都能用于构造Book
+constexpr bool validateIsbn(std::string_view s, IsbnPolicy policy = IsbnPolicy::format) {
+    if (!isValidIsbnFormat(s)) return false;
+    switch (policy) {
+        case IsbnPolicy::format: return true;
+        case IsbnPolicy::isbn10: return isValidIsbn10(s);
+        case IsbnPolicy::isbn13: return isValidIsbn13(s);
+        case IsbnPolicy::checksum: return isValidIsbn10(s) || isValidIsbn13(s);
+    }
+    return false;
+}
+
+// 批量校验一列ISBN，结果写入调用方提供的results(1有效/0无效)，返回有效个数
+// results长度必须不小于isbns；整个过程不分配内存
+inline std::size_t validateIsbnBatch(std::span<const std::string_view> isbns,
+                                     std::span<std::uint8_t> results,
+                                     IsbnPolicy policy = IsbnPolicy::format) {
+    std::size_t valid = 0;
+    for (std::size_t i = 0; i < isbns.size(); ++i) {
+        bool ok = validateIsbn(isbns[i], policy);
+        results[i] = ok ? 1 : 0;
+        valid += ok;
+    }
+    return valid;
+}
+
+// 把n-n-n-x格式的ISBN压缩为64位整数键，用于哈希索引
+// 最高位为1表示压缩键；低6位为末位字符，其上每4位依次编码前缀中的一个字符(数字为1-10，'-'为11)
+// 前缀超过14个字符或格式不合法时无法压缩，返回0
+constexpr std::uint64_t packIsbn(std::string_view s) {
+    if (!isValidIsbnFormat(s) || s.size() - 1 > 14) return 0;
+    char last = s.back();
+    std::uint64_t code;
+    if (isbn_detail::isDigit(last)) code = static_cast<std::uint64_t>(last - '0');
+    else if (last >= 'a' && last <= 'z') code = static_cast<std::uint64_t>(last - 'a' + 10);
+    else code = static_cast<std::uint64_t>(last - 'A' + 36);
+    std::uint64_t key = 0;
+    for (std::size_t i = 0; i + 1 < s.size(); ++i) {
+        std::uint64_t nibble = s[i] == '-' ? 11 : static_cast<std::uint64_t>(s[i] - '0' + 1);
+        key |= nibble << (6 + 4 * i);
+    }
+    return key | code | (std::uint64_t{1} << 63);
+}
+
+static_assert(isValidIsbnFormat("111-222-333-A"));
+static_assert(!isValidIsbnFormat("111--333-A"));
+static_assert(!isValidIsbnFormat("111-222-333-AB"));
+static_assert(isValidIsbn10("0-306-40615-2"));
+static_assert(isValidIsbn13("978-0-306-40615-7"));
+// 校验和正确但不是n-n-n-x格式的ISBN在任何规则下都被拒绝
+static_assert(!validateIsbn("0306406152", IsbnPolicy::isbn10));
+static_assert(!validateIsbn("978-0-306-40615-7", IsbnPolicy::isbn13));
+static_assert(!validateIsbn("0-306-406152", IsbnPolicy::checksum));
+static_assert(validateIsbn("0-306-40615-2", IsbnPolicy::isbn10));
+static_assert(validateIsbn("978-0-30640615-7", IsbnPolicy::checksum));
+static_assert(packIsbn("111-222-333-A") != 0);
+static_assert(packIsbn("111-222-333-A") != packIsbn("111-222-333-a"));
+static_assert(packIsbn("1-1-11-X") != packIsbn("1-11-1-X"));
+static_assert(packIsbn("12345678-1234-12-X") == 0);
+
+#endif // ISBN_VALIDATOR_H
@@ -0,0 +1,1970 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "catalog_import.h"
+#include "circulation_analytics.h"
+#include "date.h"
+#include "fee_ledger.h"
+#include "hold_queue.h"
+#include "isbn_validator.h"
+#include "loan_index.h"
+#include "loan_requests.h"
+#include "mapped_file.h"
+#include "overdue_fines.h"
+#include "persistence.h"
+#include "read_view.h"
+#include "slot_map.h"
+#include "string_pool.h"
+#include "book_filter.h"
+#include "title_search.h"
+#include "transaction_log.h"
+
+// 获取当前年份的独立工具函数(读取缓存的时钟)
+inline int getCurrentYear() {
+    return LibraryClock::currentYear();
+}
+
+// 书籍枚举类型
+enum class Genre : std::uint8_t {
+    fiction,      // 小说
+    nonfiction,   // 非小说类文学作品
+    periodical,   // 期刊
+    biography,    // 传记
+    children      // 儿童读物
+};
+
+// 图书类：一条记录对应一种书(一个ISBN)，同一种书可有多个副本
+// 副本之间没有区别，只记录副本总数与借出数，"是否有可借副本"与"借出一个副本"都是O(1)
+class Book {
+private:
+    // 文本字段存放在全局字符串池中，对象本身只保存句柄(见string_pool.h)
+    PooledString isbn;      // ISBN号
+    PooledString title;     // 书名
+    PooledString author;    // 作者(去重存放)
+    std::int32_t copyrightYear;  // 版权年份
+    Genre genre;            // 书籍类型
+    std::uint32_t copies;   // 副本数(只在Library独占锁下修改)
+    std::atomic<std::uint32_t> onLoan;  // 借出的副本数(原子变量，读者无需加锁即可查看)
+
+    // ISBN验证函数(n-n-n-x格式)
+    static bool isValidISBN(std::string_view isbn) {
+        return isValidIsbnFormat(isbn);
+    }
+
+public:
+    static constexpr std::uint32_t kMaxCopies = 1 << 16;   // 单种书的副本数上限
+
+    // 构造函数
+    Book(std::string_view i, std::string_view t, std::string_view a, int year, Genre g,
+         std::uint32_t copyCount = 1)
+        : copyrightYear(year), genre(g), copies(copyCount), onLoan(0) {
+        if (!isValidISBN(i)) {
+            throw std::invalid_argument("无效的ISBN格式，应为n-n-n-x");
+        }
+        if (copyCount == 0 || copyCount > kMaxCopies) {
+            throw std::invalid_argument("副本数必须为1到65536之间的整数");
+        }
+        // 校验通过后才存入字符串池；文本都去重存放，重复构造同一本书不会增加池的占用
+        // 不可压缩的ISBN以池内地址作为索引键(见isbnKey)
+        StringPool& pool = StringPool::global();
+        isbn = pool.intern(i);
+        title = pool.intern(t);
+        author = pool.intern(a);
+    }
+
+    // 拷贝构造与赋值(原子成员需显式拷贝)
+    Book(const Book& other)
+        : isbn(other.isbn), title(other.title), author(other.author),
+          copyrightYear(other.copyrightYear), genre(other.genre),
+          copies(other.copies), onLoan(other.onLoan.load()) {}
+
+    Book& operator=(const Book& other) {
+        isbn = other.isbn;
+        title = other.title;
+        author = other.author;
+        copyrightYear = other.copyrightYear;
+        genre = other.genre;
+        copies = other.copies;
+        onLoan.store(other.onLoan.load());
+        return *this;
+    }
+
+    // 获取ISBN号
+    std::string_view getISBN() const { return isbn; }
+    // 获取书名
+    std::string_view getTitle() const { return title; }
+    // 获取作者
+    std::string_view getAuthor() const { return author; }
+    // 作者在字符串池中的句柄(相同作者句柄相同，可作为统计键)
+    const PooledString& getAuthorHandle() const { return author; }
+
+    // ISBN的索引键：可压缩的为压缩键，否则为池内地址；未存入过的ISBN返回0
+    static std::uint64_t isbnKey(std::string_view isbn) {
+        std::uint64_t packed = packIsbn(isbn);
+        return packed ? packed : StringPool::global().find(isbn).bits();
+    }
+    // 获取版权年份
+    int getCopyrightYear() const { return copyrightYear; }
+    // 获取书籍类型
+    Genre getGenre() const { return genre; }
+    // 获取副本数
+    std::uint32_t getCopies() const { return copies; }
+    // 获取借出的副本数
+    std::uint32_t getOnLoan() const { return onLoan.load(std::memory_order_relaxed); }
+    // 获取可借的副本数
+    std::uint32_t getAvailableCopies() const { return copies - getOnLoan(); }
+    // 是否有可借副本
+    bool isAvailable() const { return getOnLoan() < copies; }
+    // 获取借阅状态(全部副本均已借出)
+    bool getCheckoutStatus() const { return !isAvailable(); }
+
+    // 尝试借出一个副本(原子地增加借出数，不会超过副本数)，没有可借副本时返回false
+    bool tryCheckOut() noexcept {
+        std::uint32_t n = onLoan.load();
+        while (n < copies) {
+            if (onLoan.compare_exchange_weak(n, n + 1)) return true;
+        }
+        return false;
+    }
+
+    // 尝试归还一个副本，没有借出的副本时返回false
+    bool tryReturn() noexcept {
+        std::uint32_t n = onLoan.load();
+        while (n > 0) {
+            if (onLoan.compare_exchange_weak(n, n - 1)) return true;
+        }
+        return false;
+    }
+
+    // 借出书籍
+    void checkOut() { 
+        if (!tryCheckOut()) {
+            throw std::runtime_error("书籍已被借出");
+        }
+    }
+    
+    // 归还书籍
+    void returnBook() { 
+        if (!tryReturn()) {
+            throw std::runtime_error("书籍未被借出");
+        }
+    }
+
+    // 设置副本数(由Library在独占锁下调用)
+    void setCopies(std::uint32_t n) { copies = n; }
+    // 设置借出的副本数(由Library在恢复时调用)
+    void setOnLoan(std::uint32_t n) { onLoan.store(n); }
+
+    // 重载==运算符，比较ISBN号
+    bool operator==(const Book& other) const { return isbn.view() == other.isbn.view(); }
+    // 重载!=运算符
+    bool operator!=(const Book& other) const { return !(*this == other); }
+
+    // 友元函数，重载输出运算符
+    friend std::ostream& operator<<(std::ostream& os, const Book& book);
+};
+
+// 类型名称
+inline std::string_view genreName(Genre genre) {
+    switch(genre) {
+        case Genre::fiction: return "小说";
+        case Genre::nonfiction: return "非小说类文学作品";
+        case Genre::periodical: return "期刊";
+        case Genre::biography: return "传记";
+        case Genre::children: return "儿童读物";
+    }
+    return "";
+}
+
+// 重载<<运算符，输出书籍信息
+inline std::ostream& operator<<(std::ostream& os, const Book& book) {
+    os << "书名: " << book.title << "\n"
+       << "作者: " << book.author << "\n"
+       << "ISBN: " << book.isbn << "\n"
+       << "类型: " << genreName(book.genre);
+    return os;
+}
+
+// 读者类
+class Patron {
+private:
+    PooledString name;      // 读者姓名(去重存放于全局字符串池)
+    int cardNumber;         // 借书证号
+    std::atomic<Cents> feeCents;  // 欠费金额(分，原子变量，读者无需加锁即可查看)
+
+public:
+    // 构造函数
+    Patron(std::string_view n, int cn)
+        : name(StringPool::global().intern(n)), cardNumber(cn), feeCents(0) {}
+
+    // 拷贝构造与赋值(原子成员需显式拷贝)
+    Patron(const Patron& other)
+        : name(other.name), cardNumber(other.cardNumber), feeCents(other.feeCents.load()) {}
+
+    Patron& operator=(const Patron& other) {
+        name = other.name;
+        cardNumber = other.cardNumber;
+        feeCents.store(other.feeCents.load());
+        return *this;
+    }
+
+    // 获取读者姓名
+    std::string_view getName() const { return name; }
+    // 获取借书证号
+    int getCardNumber() const { return cardNumber; }
+    // 获取欠费金额(元)
+    double getFees() const { return feeCents / 100.0; }
+    // 获取欠费金额(分)
+    Cents getFeeCents() const { return feeCents; }
+
+    // 检查是否有欠费
+    bool owesFees() const { return feeCents > 0; }
+
+    // 设置欠费金额(元，按分四舍五入)
+    void setFees(double f) {
+        if (f < 0) throw std::invalid_argument("欠费金额不能为负数");
+        feeCents = toCents(f);
+    }
+
+    // 设置欠费金额(分)
+    void setFeeCents(Cents cents) {
+        if (cents < 0) throw std::invalid_argument("欠费金额不能为负数");
+        feeCents = cents;
+    }
+};
+
+// 借阅历史查询条件：日期范围两端均含，未给出的条件不限制
+struct HistoryQuery {
+    std::optional<Date> from;
+    std::optional<Date> to;
+    std::string isbn;       // 为空表示不限书籍
+    int cardNumber = 0;     // 为0表示不限读者
+};
+
+// 某一类型的馆藏汇总
+struct GenreHoldings {
+    std::size_t titles = 0;         // 种数
+    std::uint64_t copies = 0;       // 副本数
+    std::uint64_t onLoan = 0;       // 借出的副本数
+
+    std::uint64_t available() const { return copies - onLoan; }
+};
+
+// 图书馆类
+// 线程安全：
+//   - catalogMutex保护books/patrons容器及索引的结构，添加/删除书籍或读者时独占，其余操作共享
+//   - 借还书与欠费修改按书籍/读者句柄分片加锁，不同书籍/读者的操作可在多核上并行
+//   - 书籍借阅状态与读者欠费为原子变量，列表类只读操作只持共享锁，不会阻塞借还书
+//   - 在借索引的修改同时持有书籍与读者分片锁(先书后读者)，查询读者在借书籍只需持读者分片锁
+//   - 欠费台账有独立的互斥锁，总在读者分片锁之内获取，修改欠费时与读者状态同步更新
+//   - 借阅统计有独立的锁，计数器原子更新，在书籍/读者分片锁之内记录
+//   - 预约队列有独立的互斥锁，总在分片锁之内获取；预约、取消与分配持有书籍与读者分片锁，欠费变化时只持读者分片锁
+//   - 读视图(见ReadView)打开期间，写者在修改书籍/读者之前保留旧版本，报表与导出读到的是打开时刻的一致快照
+class Library {
+private:
+    static constexpr std::size_t kLockStripes = 64;
+    SlotMap<Book> books;                    // 馆藏书籍集合
+    SlotMap<Patron> patrons;                // 注册读者集合
+    TransactionLog transactions;            // 借阅记录集合(只保存句柄)
+
+    // 哈希索引：ISBN索引键(见Book::isbnKey) -> 书籍句柄，借书证号 -> 读者句柄
+    // 在添加/删除时同步维护，使查找为O(1)，且按整数键查找无需构造字符串
+    std::unordered_map<std::uint64_t, BookId> bookIndex;
+    std::unordered_map<int, PatronId> patronIndex;
+
+    // 书名/作者全文检索索引，随addBook同步维护
+    TitleSearchIndex searchIndex;
+
+    // 按类型/可借状态的位图与按出版年份的有序索引，随添加/删除书籍与借还同步维护
+    BookFilterIndex filterIndex;
+
+    // 欠费台账，随读者添加与欠费修改同步维护
+    FeeLedger feeLedger;
+
+    // 在借索引：每笔在借借阅及每本书、每位读者的在借链表，随借还书同步维护
+    LoanIndex loans;
+
+    // 借阅流式统计：按天/周分桶的借还计数与热门书籍/作者，随借还书同步更新
+    CirculationAnalytics analytics;
+
+    // 预约队列：每种书按优先级与先后排队，归还时把副本分配给下一位不欠费的预约读者
+    HoldIndex holds;
+
+    // 重放日志期间为true：归还与增加副本时不再自动分配给预约读者，当时的分配已作为随后的借出记录写入日志
+    bool replayingLog = false;
+
+    // 按类型汇总的馆藏：种数与副本数只在独占锁下修改，借出数随借还原子更新，
+    // 按类型查询可借数量无需逐本扫描
+    std::array<std::size_t, kGenreCount> genreTitles{};
+    std::array<std::uint64_t, kGenreCount> genreCopies{};
+    std::array<std::atomic<std::uint64_t>, kGenreCount> genreOnLoan{};
+    std::uint64_t totalCopies = 0;
+
+    // 读视图的纪元时钟与书籍/读者的旧版本，按槽位号编号；关闭视图时回收不再需要的版本
+    mutable EpochClock viewClock;
+    mutable VersionStore<Book> bookVersions;
+    mutable VersionStore<Patron> patronVersions;
+
+    mutable std::shared_mutex catalogMutex;
+    mutable std::array<std::mutex, kLockStripes> bookLocks;
+    mutable std::array<std::mutex, kLockStripes> patronLocks;
+
+    // 预写日志，为nullptr时不记录(例如恢复重放期间)
+    WriteAheadLog* wal = nullptr;
+    // 同一时刻只进行一次检查点
+    std::mutex checkpointMutex;
+
+    // 句柄所在的锁分片
+    static std::size_t stripeOf(SlotHandle id) { return slotIndex(id) % kLockStripes; }
+
+    // 有读视图打开时，在修改书籍/读者之前保留其当前版本(调用方持有该行的分片锁或独占锁)
+    // created为true表示该行刚在空槽位上创建(持有独占锁)，版本存储随之扩容，保留的是"空槽位"
+    void versionBook(BookId id, bool created = false) {
+        if (created) bookVersions.resize(books.slotCount());
+        if (!viewClock.active()) return;
+        bookVersions.preserve(slotIndex(id), created ? nullptr : &books[id], id, viewClock.epoch());
+    }
+
+    void versionPatron(PatronId id, bool created = false) {
+        if (created) patronVersions.resize(patrons.slotCount());
+        if (!viewClock.active()) return;
+        patronVersions.preserve(slotIndex(id), created ? nullptr : &patrons[id], id, viewClock.epoch());
+    }
+
+    // 读取槽位在纪元epoch时的书籍/读者，存在时回调f(行, 句柄)并返回true(调用方持有共享锁)
+    template <typename F>
+    bool readBookAt(std::uint32_t slot, std::uint64_t epoch, F&& f) const {
+        BookId id = books.handleAtSlot(slot);
+        return bookVersions.read(slot, epoch, id == kInvalidHandle ? nullptr : &books[id], id, f);
+    }
+
+    template <typename F>
+    bool readPatronAt(std::uint32_t slot, std::uint64_t epoch, F&& f) const {
+        PatronId id = patrons.handleAtSlot(slot);
+        return patronVersions.read(slot, epoch, id == kInvalidHandle ? nullptr : &patrons[id], id, f);
+    }
+
+    // 关闭纪元为epoch的视图，并回收已不被任何视图需要的旧版本
+    void closeView(std::uint64_t epoch) const {
+        std::uint64_t minOpen = viewClock.end(epoch);
+        std::shared_lock<std::shared_mutex> catalog(catalogMutex);
+        for (std::uint32_t slot : bookVersions.takeRetired(minOpen)) {
+            std::lock_guard<std::mutex> row(bookLocks[slot % kLockStripes]);
+            bookVersions.truncate(slot, minOpen);
+        }
+        for (std::uint32_t slot : patronVersions.takeRetired(minOpen)) {
+            std::lock_guard<std::mutex> row(patronLocks[slot % kLockStripes]);
+            patronVersions.truncate(slot, minOpen);
+        }
+    }
+
+    // 从槽位from开始回调至多limit个元素，返回下一个存活元素的槽位，没有更多时返回空
+    template <typename T, typename F>
+    static std::optional<std::size_t> pageSlots(const SlotMap<T>& map, std::size_t from, std::size_t limit, F& f) {
+        std::size_t slot = from;
+        for (std::size_t n = 0; slot < map.slotCount() && n < limit; ++slot) {
+            SlotHandle h = map.handleAtSlot(static_cast<std::uint32_t>(slot));
+            if (h == kInvalidHandle) continue;
+            f(map[h]);
+            ++n;
+        }
+        while (slot < map.slotCount() && map.handleAtSlot(static_cast<std::uint32_t>(slot)) == kInvalidHandle) ++slot;
+        return slot < map.slotCount() ? std::optional<std::size_t>(slot) : std::nullopt;
+    }
+
+    // 从序号from开始回调至多limit条满足条件、书籍与读者都存在的借阅记录f(记录, 书籍, 读者)
+    // 返回下一页游标(下一条待检查记录的序号)，没有更多记录时返回空(调用方持有共享锁)
+    template <typename F>
+    std::optional<std::size_t> pageTransactions(const HistoryFilter& filter, std::size_t from, std::size_t limit,
+                                                F& f) const {
+        std::size_t end = transactions.size();
+        std::size_t n = 0;
+        std::size_t next = transactions.scan(filter, from, end, [&](std::size_t, const Transaction& t) {
+            const Book* book = books.get(t.book);
+            const Patron* patron = patrons.get(t.patron);
+            if (!book || !patron) return true;
+            if (n == limit) return false;
+            f(t, *book, *patron);
+            ++n;
+            return true;
+        });
+        return next < end ? std::optional<std::size_t>(next) : std::nullopt;
+    }
+
+    // 写入日志缓冲并返回序号(未挂接日志时返回0)
+    std::uint64_t logRecord(WalRecordType type, const BinaryWriter& record) {
+        return wal ? wal->append(type, record.data()) : 0;
+    }
+
+    // 等待日志落盘；在释放锁之后调用，使并发操作共享同一次落盘
+    void waitLogged(std::uint64_t seq) {
+        if (wal && seq) wal->waitDurable(seq);
+    }
+
+    static void encodeBook(BinaryWriter& out, const Book& book) {
+        out.putString(book.getISBN());
+        out.putString(book.getTitle());
+        out.putString(book.getAuthor());
+        out.put(static_cast<std::int32_t>(book.getCopyrightYear()));
+        out.put(static_cast<std::uint8_t>(book.getGenre()));
+    }
+
+    // 添加书籍的日志记录：书籍内容后附副本数(早期记录没有，按1本处理)
+    static void encodeBookRecord(BinaryWriter& out, const Book& book) {
+        encodeBook(out, book);
+        out.put(book.getCopies());
+    }
+
+    static Book decodeBookRecord(BinaryReader& in) {
+        Book book = decodeBook(in);
+        if (in.remaining() >= sizeof(std::uint32_t)) {
+            std::uint32_t copies = in.get<std::uint32_t>();
+            if (copies > 0) book.setCopies(copies);
+        }
+        return book;
+    }
+
+    // 新书计入馆藏汇总与筛选索引(持有独占锁)
+    void countBook(BookId id) {
+        const Book& book = books[id];
+        auto g = static_cast<std::size_t>(book.getGenre());
+        ++genreTitles[g];
+        genreCopies[g] += book.getCopies();
+        totalCopies += book.getCopies();
+        loans.resizeLoans(totalCopies);
+        filterIndex.resize(books.slotCount());
+        filterIndex.add(slotIndex(id), static_cast<std::uint8_t>(g), book.getCopyrightYear(), book.isAvailable());
+    }
+
+    static Book decodeBook(BinaryReader& in) {
+        std::string_view isbn = in.getString();
+        std::string_view title = in.getString();
+        std::string_view author = in.getString();
+        int year = in.get<std::int32_t>();
+        Genre genre = static_cast<Genre>(in.get<std::uint8_t>());
+        return Book(isbn, title, author, year, genre);
+    }
+
+    static void encodePatron(BinaryWriter& out, const Patron& patron) {
+        out.putString(patron.getName());
+        out.put(static_cast<std::int32_t>(patron.getCardNumber()));
+        out.put(patron.getFees());
+    }
+
+    static void encodeFinePolicy(BinaryWriter& out, const FinePolicy& policy) {
+        for (const OverduePolicy& p : policy) {
+            out.put(p.loanDays);
+            out.put(p.graceDays);
+            out.put(p.dailyFine);
+            out.put(p.maxFine);
+        }
+    }
+
+    static FinePolicy decodeFinePolicy(BinaryReader& in) {
+        FinePolicy policy;
+        for (OverduePolicy& p : policy) {
+            p.loanDays = in.get<std::int32_t>();
+            p.graceDays = in.get<std::int32_t>();
+            p.dailyFine = in.get<Cents>();
+            p.maxFine = in.get<Cents>();
+        }
+        return policy;
+    }
+
+    static Patron decodePatron(BinaryReader& in) {
+        std::string_view name = in.getString();
+        int cardNumber = in.get<std::int32_t>();
+        Patron patron(name, cardNumber);
+        double fees = in.get<double>();
+        if (fees > 0) patron.setFees(fees);
+        return patron;
+    }
+
+    // 借还事件计入流式统计(调用方持有该书的分片锁或独占锁)
+    void recordEvent(const Transaction& t) {
+        const Book& book = books[t.book];
+        analytics.record(t.book, book.getAuthorHandle(), static_cast<std::uint8_t>(book.getGenre()),
+                         Date::unpack(t.date).dayNumber(), t.type);
+    }
+
+    // 按借阅历史重建在借索引、馆藏汇总与借阅统计(加载快照后调用)
+    // 以各书籍保存的借出数为准：早期快照没有归还事件，副本全部在借时以最后一次借出为准，
+    // 重放后在借数仍多于保存的借出数时，从最早借出的开始结束
+    // 已删除的书籍/读者的记录句柄已失效，直接跳过
+    void rebuildLoans() {
+        genreTitles.fill(0);
+        genreCopies.fill(0);
+        totalCopies = 0;
+        loans.clear();
+        loans.resizeBooks(books.slotCount());
+        loans.resizePatrons(patrons.slotCount());
+        holds.clear();
+        holds.resizeBooks(books.slotCount());
+        holds.resizePatrons(patrons.slotCount());
+        bookVersions.clear();
+        patronVersions.clear();
+        bookVersions.resize(books.slotCount());
+        patronVersions.resize(patrons.slotCount());
+        filterIndex.clear();
+        analytics.clear();
+        for (std::size_t i = 0; i < books.size(); ++i) countBook(books.handleAt(i));
+
+        transactions.scan(HistoryFilter{}, 0, transactions.size(), [&](std::size_t i, const Transaction& t) {
+            if (!books.contains(t.book) || !patrons.contains(t.patron)) return true;
+            recordEvent(t);
+            if (t.type == TransactionType::checkout) {
+                const Book& book = books[t.book];
+                if (loans.bookLoanCount(t.book) >= book.getCopies()) loans.close(loans.oldestLoan(t.book));
+                loans.open(t.book, t.patron, i, t.date, static_cast<std::uint8_t>(book.getGenre()));
+            } else {
+                LoanId loan = loans.findLoan(t.book, t.patron);
+                if (loan != LoanIndex::kNoLoan) loans.close(loan);
+            }
+            return true;
+        });
+        for (auto& counter : genreOnLoan) counter.store(0, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < books.size(); ++i) {
+            BookId b = books.handleAt(i);
+            Book& book = books[b];
+            while (loans.bookLoanCount(b) > book.getOnLoan()) loans.close(loans.oldestLoan(b));
+            book.setOnLoan(static_cast<std::uint32_t>(loans.bookLoanCount(b)));
+            genreOnLoan[static_cast<std::size_t>(book.getGenre())] += book.getOnLoan();
+            filterIndex.setAvailable(slotIndex(b), book.isAvailable());
+        }
+    }
+
+    // 借出一个副本：写借出日志、追加借出事件并登记借阅，读者预约了该书时结束该预约，返回日志序号
+    // 调用方持有该书与该读者的分片锁(或独占锁)，并已确认有可借副本、读者没有欠费
+    std::uint64_t lendCopy(BookId bookId, PatronId patronId, const Date& date) {
+        Book& book = books[bookId];
+        BinaryWriter record;
+        record.putString(book.getISBN());
+        record.put(static_cast<std::int32_t>(patrons[patronId].getCardNumber()));
+        record.put(date.civilPacked());
+        std::uint64_t seq = logRecord(WalRecordType::checkout, record);
+
+        // 创建借阅记录
+        Transaction event{bookId, patronId, date.pack(), TransactionType::checkout};
+        std::size_t index = transactions.append(event);
+        recordEvent(event);
+        loans.open(bookId, patronId, index, date.pack(), static_cast<std::uint8_t>(book.getGenre()));
+        if (holds.bookHoldCount(bookId) > 0) holds.remove(bookId, patronId);
+
+        // 借出数加一
+        versionBook(bookId);
+        book.tryCheckOut();
+        if (!book.isAvailable()) filterIndex.setAvailable(slotIndex(bookId), false);
+        genreOnLoan[static_cast<std::size_t>(book.getGenre())].fetch_add(1, std::memory_order_relaxed);
+        return seq;
+    }
+
+    // 该书是否有副本可借给该读者：可借副本须多于排在该读者之前的有效预约(暂停的预约不占副本)
+    // 调用方持有该书的分片锁(或独占锁)；重放日志时按记录照做，不再检查
+    bool copyFreeFor(BookId bookId, PatronId patronId) const {
+        const Book& book = books[bookId];
+        if (!book.isAvailable()) return false;
+        if (replayingLog || holds.bookHoldCount(bookId) == 0) return true;
+        std::size_t free = book.getCopies() - book.getOnLoan();
+        return holds.countAhead(bookId, patronId, free) < free;
+    }
+
+    // 把该书的可借副本依次分配给排队的预约读者(按借出处理)，每分配一本回调filled(书籍, 读者)
+    // 调用方持有该书的分片锁(或独占锁)且不持有读者分片锁；seq更新为最后一条日志的序号，返回分配的副本数
+    template <typename G>
+    std::size_t fillHolds(BookId bookId, const Date& date, std::uint64_t& seq, G&& filled) {
+        const Book& book = books[bookId];
+        std::size_t n = 0;
+        while (book.isAvailable()) {
+            PatronId patronId = holds.next(bookId);
+            if (patronId == kInvalidHandle) break;
+            std::lock_guard<std::mutex> patronLock(patronLocks[stripeOf(patronId)]);
+            // 取得读者锁之前，该读者的预约可能因欠费暂停，或有更靠前的预约恢复排队，须重新确认
+            if (holds.next(bookId) != patronId) continue;
+            seq = lendCopy(bookId, patronId, date);
+            filled(book, static_cast<const Patron&>(patrons[patronId]));
+            ++n;
+        }
+        return n;
+    }
+
+    // 处理一条借还请求(调用方持有catalogMutex共享锁)；成功时回调f(book)，seq更新为该条日志的序号
+    // 归还的副本分配给预约读者时另回调filled(书籍, 读者)，seq随之更新
+    template <typename F, typename G>
+    LoanStatus applyLoan(const LoanRequest& request, std::uint64_t& seq, F&& f, G&& filled) {
+        // 检查书籍是否在馆藏中
+        auto bookIt = bookIndex.find(Book::isbnKey(request.isbn));
+        if (bookIt == bookIndex.end()) return LoanStatus::unknownBook;
+        BookId bookId = bookIt->second;
+        Book& book = books[bookId];
+
+        if (request.action == LoanAction::checkin) {
+            std::lock_guard<std::mutex> bookLock(bookLocks[stripeOf(bookId)]);
+            // 找出要归还的那笔借阅：指定读者时为该读者借的副本，否则该书须只有一个副本在借
+            LoanId loan;
+            if (request.cardNumber != 0) {
+                auto patronIt = patronIndex.find(request.cardNumber);
+                if (patronIt == patronIndex.end()) return LoanStatus::unknownPatron;
+                loan = loans.findLoan(bookId, patronIt->second);
+                if (loan == LoanIndex::kNoLoan) return LoanStatus::notCheckedOut;
+            } else {
+                std::size_t lent = loans.bookLoanCount(bookId);
+                if (lent == 0) return LoanStatus::notCheckedOut;
+                if (lent > 1) return LoanStatus::ambiguousReturn;
+                loan = loans.newestLoan(bookId);
+            }
+            // 借阅人在持有书籍锁期间不会变化，按"先书后读者"的顺序加锁
+            PatronId patronId = loans.borrower(loan);
+            std::unique_lock<std::mutex> patronLock(patronLocks[stripeOf(patronId)]);
+
+            BinaryWriter record;
+            record.putString(request.isbn);
+            record.put(request.date.civilPacked());
+            record.put(static_cast<std::int32_t>(patrons[patronId].getCardNumber()));
+            seq = logRecord(WalRecordType::checkin, record);
+            Transaction event{bookId, patronId, request.date.pack(), TransactionType::checkin};
+            transactions.append(event);
+            recordEvent(event);
+            loans.close(loan);
+            versionBook(bookId);
+            book.tryReturn();
+            filterIndex.setAvailable(slotIndex(bookId), true);
+            genreOnLoan[static_cast<std::size_t>(book.getGenre())].fetch_sub(1, std::memory_order_relaxed);
+            f(static_cast<const Book&>(book));
+            // 还回的副本交给下一位预约读者(仍持有书籍锁，其他人借不走这一本)
+            patronLock.unlock();
+            if (!replayingLog && holds.bookHoldCount(bookId) > 0) fillHolds(bookId, request.date, seq, filled);
+            return LoanStatus::ok;
+        }
+
+        // 检查读者是否注册
+        auto patronIt = patronIndex.find(request.cardNumber);
+        if (patronIt == patronIndex.end()) return LoanStatus::unknownPatron;
+        PatronId patronId = patronIt->second;
+        const Patron& patron = patrons[patronId];
+
+        // 锁定该书与该读者所在的分片，保证状态检查、记日志与修改之间不被插入
+        std::lock_guard<std::mutex> bookLock(bookLocks[stripeOf(bookId)]);
+        std::lock_guard<std::mutex> patronLock(patronLocks[stripeOf(patronId)]);
+
+        // 检查读者是否有欠费
+        if (patron.owesFees()) return LoanStatus::feesOwed;
+        // 检查是否有可借副本，且没有留给排在前面的预约读者
+        if (!book.isAvailable()) return LoanStatus::alreadyCheckedOut;
+        if (!copyFreeFor(bookId, patronId)) return LoanStatus::reservedForHolds;
+
+        seq = lendCopy(bookId, patronId, request.date);
+        f(static_cast<const Book&>(book));
+        return LoanStatus::ok;
+    }
+
+    // 处理单条借还请求：释放锁之后再等待日志落盘，使并发操作共享同一次落盘
+    template <typename F, typename G>
+    LoanStatus applyOne(const LoanRequest& request, F&& f, G&& filled) {
+        std::uint64_t seq = 0;
+        LoanStatus status;
+        {
+            std::shared_lock<std::shared_mutex> catalog(catalogMutex);
+            status = applyLoan(request, seq, f, filled);
+        }
+        if (status == LoanStatus::ok) waitLogged(seq);
+        return status;
+    }
+
+public:
+    // 挂接预写日志，之后的每次修改都会先写日志再生效
+    void attachLog(WriteAheadLog* log) { wal = log; }
+
+    // const std::vector<Transaction>& getTransactions() const { return transactions; }
+    // 添加书籍到图书馆
+    void addBook(const Book& book) {
+        std::uint64_t seq = 0;
+        {
+            std::unique_lock<std::shared_mutex> lock(catalogMutex);
+            if (bookIndex.count(Book::isbnKey(book.getISBN()))) {
+                throw std::runtime_error("该ISBN的书籍已存在");
+            }
+            BinaryWriter record;
+            encodeBookRecord(record, book);
+            seq = logRecord(WalRecordType::addBook, record);
+            BookId id = books.insert(book);
+            versionBook(id, true);
+            books[id].setOnLoan(0);
+            searchIndex.add(id, book.getTitle(), book.getAuthor());
+            bookIndex.emplace(Book::isbnKey(book.getISBN()), id);
+            loans.resizeBooks(books.slotCount());
+            holds.resizeBooks(books.slotCount());
+            countBook(id);
+        }
+        waitLogged(seq);
+    }
+
+    // 为已有书籍增加count个副本
+    void addCopies(std::string_view isbn, std::uint32_t count) {
+        if (count == 0) {
+            throw std::invalid_argument("副本数必须为正数");
+        }
+        std::uint64_t seq = 0;
+        {
+            std::unique_lock<std::shared_mutex> lock(catalogMutex);
+            auto it = bookIndex.find(Book::isbnKey(isbn));
+            if (it == bookIndex.end()) {
+                throw std::runtime_error("未找到该ISBN的书籍");
+            }
+            Book& book = books[it->second];
+            if (count > Book::kMaxCopies - book.getCopies()) {
+                throw std::runtime_error("副本数超出上限");
+            }
+            BinaryWriter record;
+            record.putString(isbn);
+            record.put(count);
+            seq = logRecord(WalRecordType::addCopies, record);
+            versionBook(it->second);
+            book.setCopies(book.getCopies() + count);
+            genreCopies[static_cast<std::size_t>(book.getGenre())] += count;
+            totalCopies += count;
+            loans.resizeLoans(totalCopies);
+            filterIndex.setAvailable(slotIndex(it->second), true);
+            // 新副本先分配给排队的预约读者
+            if (!replayingLog && holds.bookHoldCount(it->second) > 0) {
+                fillHolds(it->second, Date(), seq, [](const Book&, const Patron&) {});
+            }
+        }
+        waitLogged(seq);
+    }
+
+    // 添加读者到图书馆
+    void addPatron(const Patron& patron) {
+        std::uint64_t seq = 0;
+        {
+            std::unique_lock<std::shared_mutex> lock(catalogMutex);
+            if (patronIndex.count(patron.getCardNumber())) {
+                throw std::runtime_error("该借书证号已被注册");
+            }
+            BinaryWriter record;
+            encodePatron(record, patron);
+            seq = logRecord(WalRecordType::addPatron, record);
+            PatronId id = patrons.insert(patron);
+            versionPatron(id, true);
+            feeLedger.update(id, 0, patron.getFeeCents());
+            patronIndex.emplace(patron.getCardNumber(), id);
+            loans.resizePatrons(patrons.slotCount());
+            holds.resizePatrons(patrons.slotCount());
+        }
+        waitLogged(seq);
+    }
+
+    // 批量合并导入的书籍：一次性预留容量，格式不合法或重复的ISBN记入errors，返回成功添加数
+    std::size_t addBooks(const std::vector<BookRecord>& rows, std::vector<ImportError>& errors) {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        books.reserve(books.size() + rows.size());
+        bookIndex.reserve(bookIndex.size() + rows.size());
+        std::size_t added = 0;
+        BinaryWriter record;
+        std::uint64_t lastSeq = 0;
+        for (const BookRecord& r : rows) {
+            // 与Book构造函数相同的格式检查放在写日志之前，保证合并中途不会抛出异常
+            if (!isValidIsbnFormat(r.isbn)) {
+                errors.push_back({r.line, "无效的ISBN"});
+                continue;
+            }
+            if (bookIndex.count(Book::isbnKey(r.isbn))) {
+                errors.push_back({r.line, "该ISBN的书籍已存在"});
+                continue;
+            }
+            BookId id = books.emplace(r.isbn, r.title, r.author, r.year, static_cast<Genre>(r.genre));
+            versionBook(id, true);
+            searchIndex.add(id, r.title, r.author);
+            bookIndex.emplace(Book::isbnKey(r.isbn), id);
+            record.clear();
+            encodeBookRecord(record, books[id]);
+            lastSeq = logRecord(WalRecordType::addBook, record);
+            countBook(id);
+            ++added;
+        }
+        loans.resizeBooks(books.slotCount());
+        holds.resizeBooks(books.slotCount());
+        lock.unlock();
+        // 整批记录共享一次落盘等待
+        waitLogged(lastSeq);
+        return added;
+    }
+
+    // 批量合并导入的读者：重复的借书证号记入errors，返回成功添加数
+    std::size_t addPatrons(const std::vector<PatronRecord>& rows, std::vector<ImportError>& errors) {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        patrons.reserve(patrons.size() + rows.size());
+        patronIndex.reserve(patronIndex.size() + rows.size());
+        std::size_t added = 0;
+        BinaryWriter record;
+        std::uint64_t lastSeq = 0;
+        for (const PatronRecord& r : rows) {
+            if (patronIndex.count(r.cardNumber)) {
+                errors.push_back({r.line, "该借书证号已被注册"});
+                continue;
+            }
+            PatronId id = patrons.emplace(std::string(r.name), r.cardNumber);
+            versionPatron(id, true);
+            patronIndex.emplace(r.cardNumber, id);
+            if (r.fees > 0) patrons[id].setFees(r.fees);
+            feeLedger.update(id, 0, patrons[id].getFeeCents());
+            record.clear();
+            encodePatron(record, patrons[id]);
+            lastSeq = logRecord(WalRecordType::addPatron, record);
+            ++added;
+        }
+        loans.resizePatrons(patrons.slotCount());
+        holds.resizePatrons(patrons.slotCount());
+        lock.unlock();
+        waitLogged(lastSeq);
+        return added;
+    }
+
+    // 从馆藏中删除书籍，书籍在借时不能删除
+    // 删除后旧句柄失效，借阅历史中指向该书的记录在遍历时被跳过
+    void removeBook(std::string_view isbn) {
+        std::uint64_t seq = 0;
+        {
+            std::unique_lock<std::shared_mutex> lock(catalogMutex);
+            auto it = bookIndex.find(Book::isbnKey(isbn));
+            if (it == bookIndex.end()) {
+                throw std::runtime_error("未找到该ISBN的书籍");
+            }
+            BookId id = it->second;
+            if (loans.bookLoanCount(id) > 0) {
+                throw std::runtime_error("书籍已被借出，不能删除");
+            }
+            if (holds.bookHoldCount(id) > 0) {
+                throw std::runtime_error("书籍有读者预约，不能删除");
+            }
+            BinaryWriter record;
+            record.putString(isbn);
+            seq = logRecord(WalRecordType::removeBook, record);
+            searchIndex.remove(id);
+            filterIndex.remove(slotIndex(id), static_cast<std::uint8_t>(books[id].getGenre()));
+            bookIndex.erase(it);
+            loans.resetBook(id);
+            auto g = static_cast<std::size_t>(books[id].getGenre());
+            --genreTitles[g];
+            genreCopies[g] -= books[id].getCopies();
+            totalCopies -= books[id].getCopies();
+            versionBook(id);
+            books.erase(id);
+        }
+        waitLogged(seq);
+    }
+
+    // 注销读者，读者有在借书籍或欠费时不能注销
+    void removePatron(int cardNumber) {
+        std::uint64_t seq = 0;
+        {
+            std::unique_lock<std::shared_mutex> lock(catalogMutex);
+            auto it = patronIndex.find(cardNumber);
+            if (it == patronIndex.end()) {
+                throw std::runtime_error("读者未注册");
+            }
+            PatronId id = it->second;
+            if (loans.loanCount(id) > 0) {
+                throw std::runtime_error("读者有在借书籍，不能注销");
+            }
+            if (patrons[id].owesFees()) {
+                throw std::runtime_error("读者有欠费，不能注销");
+            }
+            if (holds.patronHoldCount(id) > 0) {
+                throw std::runtime_error("读者有预约，不能注销");
+            }
+            BinaryWriter record;
+            record.put(static_cast<std::int32_t>(cardNumber));
+            seq = logRecord(WalRecordType::removePatron, record);
+            patronIndex.erase(it);
+            loans.resetPatron(id);
+            versionPatron(id);
+            patrons.erase(id);
+        }
+        waitLogged(seq);
+    }
+
+    // 按ISBN查找书籍，未找到返回nullptr
+    // 注意：返回的指针在下一次添加/删除书籍后可能失效，并发场景请使用withBook
+    const Book* findBook(std::string_view isbn) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        auto it = bookIndex.find(Book::isbnKey(isbn));
+        return it == bookIndex.end() ? nullptr : &books[it->second];
+    }
+
+    // 按借书证号查找读者，未找到返回nullptr
+    // 注意：返回的指针在下一次添加/删除读者后可能失效，并发场景请使用withPatron
+    const Patron* findPatron(int cardNumber) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        auto it = patronIndex.find(cardNumber);
+        return it == patronIndex.end() ? nullptr : &patrons[it->second];
+    }
+
+    // 在持有共享锁期间访问书籍，找到时调用f(book)并返回true
+    template <typename F>
+    bool withBook(std::string_view isbn, F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        auto it = bookIndex.find(Book::isbnKey(isbn));
+        if (it == bookIndex.end()) return false;
+        f(books[it->second]);
+        return true;
+    }
+
+    // 在持有共享锁期间访问读者，找到时调用f(patron)并返回true
+    template <typename F>
+    bool withPatron(int cardNumber, F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        auto it = patronIndex.find(cardNumber);
+        if (it == patronIndex.end()) return false;
+        f(patrons[it->second]);
+        return true;
+    }
+
+    // 按书名/作者检索，按相关度从高到低回调f(book, score)，最多limit条
+    template <typename F>
+    void searchBooks(std::string_view query, SearchMode mode, std::size_t limit, F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        auto hits = searchIndex.search(query, mode, limit,
+            [this](BookId id, std::string_view& title, std::string_view& author) {
+                title = books[id].getTitle();
+                author = books[id].getAuthor();
+            });
+        for (const SearchHit& hit : hits) f(books[hit.book], hit.score);
+    }
+
+    // 批量借还：整批只取一次共享锁，逐条按索引校验并生效，整批只等待一次日志落盘
+    // results[i]为第i条请求的结果；请求按顺序处理，后面的请求能看到前面请求的效果
+    // 每条成功的请求回调f(i, book)，book为处理后的状态；第i条归还的副本分配给预约读者时回调filled(i, book, patron)
+    // 第i条请求处理完(无论成败)回调applied(i)，供调用方逐条计时
+    // 回调期间持有锁，不能再调用Library
+    template <typename F, typename G, typename H>
+    void processLoans(std::span<const LoanRequest> requests, std::vector<LoanStatus>& results, F&& f, G&& filled,
+                      H&& applied) {
+        results.resize(requests.size());
+        std::uint64_t seq = 0;
+        {
+            std::shared_lock<std::shared_mutex> catalog(catalogMutex);
+            for (std::size_t i = 0; i < requests.size(); ++i) {
+                results[i] = applyLoan(requests[i], seq, [&](const Book& book) { f(i, book); },
+                                       [&](const Book& book, const Patron& patron) { filled(i, book, patron); });
+                applied(i);
+            }
+        }
+        waitLogged(seq);
+    }
+
+    template <typename F, typename G>
+    void processLoans(std::span<const LoanRequest> requests, std::vector<LoanStatus>& results, F&& f, G&& filled) {
+        processLoans(requests, results, f, filled, [](std::size_t) {});
+    }
+
+    template <typename F>
+    void processLoans(std::span<const LoanRequest> requests, std::vector<LoanStatus>& results, F&& f) {
+        processLoans(requests, results, f, [](std::size_t, const Book&, const Patron&) {});
+    }
+
+    void processLoans(std::span<const LoanRequest> requests, std::vector<LoanStatus>& results) {
+        processLoans(requests, results, [](std::size_t, const Book&) {});
+    }
+
+    // 借出书籍，失败时抛出异常；读者预约了该书时同时结束该预约
+    void checkOutBook(std::string_view isbn, int cardNumber, const Date& date) {
+        LoanStatus status = applyOne(LoanRequest{LoanAction::checkout, isbn, cardNumber, date},
+                                     [](const Book&) {}, [](const Book&, const Patron&) {});
+        if (status != LoanStatus::ok) throw std::runtime_error(loanStatusMessage(status));
+    }
+
+    // 借出书籍（兼容旧接口，仅使用book的ISBN与patron的借书证号）
+    void checkOutBook(const Book& book, const Patron& patron, const Date& date) {
+        checkOutBook(book.getISBN(), patron.getCardNumber(), date);
+    }
+
+    // 归还书籍：结束在借记录并追加归还事件，返回被归还书籍(归还后、分配给预约读者前)的副本，失败时抛出异常
+    // cardNumber为0时不指定读者，该书有多个副本在借时须指定借阅的读者
+    // 该书有人预约时，还回的副本当即借给下一位不欠费的预约读者，并回调filled(书籍, 读者)
+    template <typename G>
+    Book returnBook(std::string_view isbn, int cardNumber, const Date& date, G&& filled) {
+        std::optional<Book> returned;
+        LoanStatus status = applyOne(LoanRequest{LoanAction::checkin, isbn, cardNumber, date},
+                                     [&](const Book& book) { returned.emplace(book); }, filled);
+        if (status != LoanStatus::ok) throw std::runtime_error(loanStatusMessage(status));
+        return *returned;
+    }
+
+    Book returnBook(std::string_view isbn, int cardNumber, const Date& date) {
+        return returnBook(isbn, cardNumber, date, [](const Book&, const Patron&) {});
+    }
+
+    Book returnBook(std::string_view isbn, const Date& date = Date()) {
+        return returnBook(isbn, 0, date);
+    }
+
+    // 修改读者欠费金额
+    void setPatronFees(int cardNumber, double fees) {
+        std::shared_lock<std::shared_mutex> catalog(catalogMutex);
+        auto it = patronIndex.find(cardNumber);
+        if (it == patronIndex.end()) {
+            throw std::runtime_error("读者未注册");
+        }
+        if (fees < 0) {
+            throw std::invalid_argument("欠费金额不能为负数");
+        }
+        Cents cents = toCents(fees);
+        std::unique_lock<std::mutex> patronLock(patronLocks[stripeOf(it->second)]);
+        BinaryWriter record;
+        record.put(static_cast<std::int32_t>(cardNumber));
+        record.put(fees);
+        std::uint64_t seq = logRecord(WalRecordType::setFees, record);
+        Patron& patron = patrons[it->second];
+        Cents old = patron.getFeeCents();
+        feeLedger.update(it->second, old, cents);
+        versionPatron(it->second);
+        patron.setFeeCents(cents);
+        // 欠费期间暂停该读者的预约，还清后恢复排队
+        std::vector<BookId> resumed;
+        if (old <= 0 && cents > 0) {
+            holds.suspend(it->second);
+        } else if (old > 0 && cents <= 0) {
+            holds.resume(it->second);
+            holds.forEachHold(it->second, [&](const HoldInfo& h) { resumed.push_back(h.book); });
+        }
+        patronLock.unlock();
+
+        // 暂停期间还回的副本可能一直留在馆内，恢复后按"先书后读者"的顺序逐本重新分配
+        if (!replayingLog) {
+            for (BookId bookId : resumed) {
+                std::lock_guard<std::mutex> bookLock(bookLocks[stripeOf(bookId)]);
+                if (holds.bookHoldCount(bookId) > 0) {
+                    fillHolds(bookId, Date(), seq, [](const Book&, const Patron&) {});
+                }
+            }
+        }
+        catalog.unlock();
+        waitLogged(seq);
+    }
+
+    // 逾期罚款结算(夜间批处理)：扫描全部在借借阅，计算截至asOf的罚款，把比已计入部分多出的差额记到读者欠费上
+    // 结算期间独占图书馆(维护窗口内暂停借还)，扫描按借阅槽区间切分给多个线程并行进行；
+    // 同一天重复结算不会重复计费。结算作为一条日志记录保存，重放时按同一规则重新结算即可得到相同结果
+    FineRunSummary accrueOverdueFines(const Date& asOf, const FinePolicy& policy = kDefaultFinePolicy,
+                                      unsigned threads = 0) {
+        auto start = std::chrono::steady_clock::now();
+        FineRunSummary summary;
+        summary.asOf = asOf;
+        std::uint64_t seq = 0;
+        {
+            std::unique_lock<std::shared_mutex> lock(catalogMutex);
+            BinaryWriter record;
+            record.put(asOf.civilPacked());
+            encodeFinePolicy(record, policy);
+            seq = logRecord(WalRecordType::accrueFines, record);
+
+            if (threads == 0) threads = std::thread::hardware_concurrency();
+            if (threads == 0) threads = 1;
+            // 借阅槽太少时不值得开线程
+            constexpr std::size_t kMinLoansPerThread = 1 << 16;
+            std::size_t n = loans.loanCapacity();
+            threads = static_cast<unsigned>(std::min<std::size_t>(threads, n / kMinLoansPerThread + 1));
+            summary.threads = threads;
+
+            // 各线程只写自己区间内的借阅，读者的新增罚款用原子加法汇总
+            std::unique_ptr<std::atomic<Cents>[]> owed(new std::atomic<Cents>[patrons.slotCount()]());
+            struct Partial {
+                std::size_t openLoans = 0;
+                std::size_t overdueLoans = 0;
+                std::size_t finedLoans = 0;
+                Cents posted = 0;
+            };
+            std::vector<Partial> partial(threads);
+            auto scan = [&](unsigned t) {
+                Partial& p = partial[t];
+                LoanId end = static_cast<LoanId>(n * (t + 1) / threads);
+                for (LoanId id = static_cast<LoanId>(n * t / threads); id < end; ++id) {
+                    if (!loans.isOpen(id)) continue;
+                    ++p.openLoans;
+                    Cents fine = policy[loans.genre(id)].fineAsOf(Date::unpack(loans.checkoutDate(id)), asOf);
+                    if (fine == 0) continue;
+                    ++p.overdueLoans;
+                    Cents delta = fine - loans.finedAmount(id);
+                    if (delta <= 0) continue;
+                    loans.setFinedAmount(id, fine);
+                    owed[slotIndex(loans.borrower(id))].fetch_add(delta, std::memory_order_relaxed);
+                    ++p.finedLoans;
+                    p.posted += delta;
+                }
+            };
+            std::vector<std::thread> workers;
+            for (unsigned t = 1; t < threads; ++t) workers.emplace_back(scan, t);
+            scan(0);
+            for (auto& w : workers) w.join();
+
+            for (const Partial& p : partial) {
+                summary.openLoans += p.openLoans;
+                summary.overdueLoans += p.overdueLoans;
+                summary.finedLoans += p.finedLoans;
+                summary.posted += p.posted;
+            }
+            // 入账并同步欠费台账
+            for (std::uint32_t slot = 0; slot < patrons.slotCount(); ++slot) {
+                Cents delta = owed[slot].load(std::memory_order_relaxed);
+                if (delta == 0) continue;
+                PatronId id = patrons.handleAtSlot(slot);
+                Cents old = patrons[id].getFeeCents();
+                versionPatron(id);
+                patrons[id].setFeeCents(old + delta);
+                feeLedger.update(id, old, old + delta);
+                if (old <= 0) holds.suspend(id);
+                ++summary.patronsCharged;
+            }
+        }
+        waitLogged(seq);
+        summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return summary;
+    }
+
+    // 重放一条日志记录(恢复期间调用，此时不应挂接日志)
+    void applyLogRecord(WalRecordType type, BinaryReader& in) {
+        replayingLog = true;
+        struct ReplayScope {
+            bool& flag;
+            ~ReplayScope() { flag = false; }
+        } scope{replayingLog};
+        switch (type) {
+            case WalRecordType::addBook:
+                addBook(decodeBookRecord(in));
+                break;
+            case WalRecordType::addPatron:
+                addPatron(decodePatron(in));
+                break;
+            case WalRecordType::checkout: {
+                std::string isbn(in.getString());
+                int cardNumber = in.get<std::int32_t>();
+                checkOutBook(isbn, cardNumber, Date::fromCivilPacked(in.get<std::uint32_t>()));
+                break;
+            }
+            case WalRecordType::checkin: {
+                std::string isbn(in.getString());
+                // 早期的归还记录不含日期(按重放当天处理)与借书证号(单副本时期，不需指定读者)
+                Date date = in.remaining() >= sizeof(std::uint32_t)
+                    ? Date::fromCivilPacked(in.get<std::uint32_t>()) : Date();
+                int cardNumber = in.remaining() >= sizeof(std::int32_t) ? in.get<std::int32_t>() : 0;
+                returnBook(isbn, cardNumber, date);
+                break;
+            }
+            case WalRecordType::setFees: {
+                int cardNumber = in.get<std::int32_t>();
+                setPatronFees(cardNumber, in.get<double>());
+                break;
+            }
+            case WalRecordType::accrueFines: {
+                Date asOf = Date::fromCivilPacked(in.get<std::uint32_t>());
+                accrueOverdueFines(asOf, decodeFinePolicy(in));
+                break;
+            }
+            case WalRecordType::removeBook:
+                removeBook(std::string(in.getString()));
+                break;
+            case WalRecordType::removePatron:
+                removePatron(in.get<std::int32_t>());
+                break;
+            case WalRecordType::addCopies: {
+                std::string isbn(in.getString());
+                addCopies(isbn, in.get<std::uint32_t>());
+                break;
+            }
+            case WalRecordType::placeHold: {
+                std::string isbn(in.getString());
+                int cardNumber = in.get<std::int32_t>();
+                Date date = Date::fromCivilPacked(in.get<std::uint32_t>());
+                placeHold(isbn, cardNumber, date, in.get<std::uint8_t>());
+                break;
+            }
+            case WalRecordType::cancelHold: {
+                std::string isbn(in.getString());
+                cancelHold(isbn, in.get<std::int32_t>());
+                break;
+            }
+            default:
+                throw std::runtime_error("未知的日志记录类型");
+        }
+    }
+
+    // 检查点的截面：独占锁下与打开读视图、取日志序号同时取得
+    // 书籍、读者与借阅记录由读视图提供(纪元与各自的范围)，其余不带版本的小块状态在此复制一份
+    struct SnapshotCut {
+        std::uint64_t epoch;
+        std::size_t bookSlots;
+        std::size_t patronSlots;
+        std::size_t transactionEnd;
+        std::vector<std::pair<std::size_t, Cents>> finedLoans;  // (借出事件序号, 已计罚款)，按序号排序
+        std::vector<TransactionLog::Summary> summaries;         // 已压缩历史的摘要
+        std::vector<HoldInfo> holds;                            // 按预约先后
+    };
+
+    // 复制截面中不带版本的部分(视图的纪元与范围由checkpoint填入)；调用方持有独占锁
+    SnapshotCut captureSnapshotCut() const {
+        SnapshotCut cut{0, 0, 0, 0, {}, {}, {}};
+        for (LoanId id = 0; id < loans.loanCapacity(); ++id) {
+            if (loans.isOpen(id) && loans.finedAmount(id) > 0) {
+                cut.finedLoans.emplace_back(loans.checkoutTransaction(id), loans.finedAmount(id));
+            }
+        }
+        std::sort(cut.finedLoans.begin(), cut.finedLoans.end());
+        cut.summaries = transactions.summaries();
+        cut.holds.reserve(holds.size());
+        holds.forEachInOrder([&](const HoldInfo& h) { cut.holds.push_back(h); });
+        return cut;
+    }
+
+    // 按截面序列化全部书籍、读者与借阅记录，作为快照内容
+    // 逐页持有共享锁读取视图中的版本，期间借还与修改照常进行；读视图打开期间不会压缩历史
+    // 书籍/读者按视图中的槽位顺序写出，加载时依次插入，句柄即为写出的位置，因此记录中的句柄按位置改写；
+    // 指向视图中已不存在的书籍/读者的句柄写为kInvalidHandle
+    std::string encodeSnapshot(SnapshotCut& cut) const {
+        constexpr std::size_t kPage = 4096;
+        std::vector<SlotHandle> bookAt(cut.bookSlots, kInvalidHandle), patronAt(cut.patronSlots, kInvalidHandle);
+        std::vector<std::uint32_t> bookPos(cut.bookSlots), patronPos(cut.patronSlots);
+        auto bookRef = [&](BookId id) {
+            std::size_t slot = slotIndex(id);
+            return slot < bookAt.size() && bookAt[slot] == id ? bookPos[slot] : kInvalidHandle;
+        };
+        auto patronRef = [&](PatronId id) {
+            std::size_t slot = slotIndex(id);
+            return slot < patronAt.size() && patronAt[slot] == id ? patronPos[slot] : kInvalidHandle;
+        };
+
+        BinaryWriter out;
+        BinaryWriter copies;    // 各书籍的副本数与借出数，与书籍同序，写在后面的一段
+        std::size_t countAt = out.size();
+        out.put(std::uint64_t{0});
+        std::uint32_t written = 0;
+        for (std::size_t slot = 0; slot < cut.bookSlots;) {
+            std::shared_lock<std::shared_mutex> lock(catalogMutex);
+            for (std::size_t end = std::min(cut.bookSlots, slot + kPage); slot < end; ++slot) {
+                readBookAt(static_cast<std::uint32_t>(slot), cut.epoch, [&](const Book& book, BookId id) {
+                    bookAt[slot] = id;
+                    bookPos[slot] = written++;
+                    encodeBook(out, book);
+                    out.put(static_cast<std::uint8_t>(book.getOnLoan() > 0));
+                    copies.put(book.getCopies());
+                    copies.put(book.getOnLoan());
+                });
+            }
+        }
+        out.patch(countAt, static_cast<std::uint64_t>(written));
+
+        countAt = out.size();
+        out.put(std::uint64_t{0});
+        written = 0;
+        for (std::size_t slot = 0; slot < cut.patronSlots;) {
+            std::shared_lock<std::shared_mutex> lock(catalogMutex);
+            for (std::size_t end = std::min(cut.patronSlots, slot + kPage); slot < end; ++slot) {
+                readPatronAt(static_cast<std::uint32_t>(slot), cut.epoch, [&](const Patron& patron, PatronId id) {
+                    patronAt[slot] = id;
+                    patronPos[slot] = written++;
+                    encodePatron(out, patron);
+                });
+            }
+        }
+        out.patch(countAt, static_cast<std::uint64_t>(written));
+
+        // 已压缩为摘要的记录不写出，加载后记录按写出的位置重新编号，
+        // 在借借阅的罚款因此按借出事件写出的位置标识(见末尾一段)
+        auto nextFined = cut.finedLoans.begin();
+        std::uint32_t position = 0;
+        countAt = out.size();
+        out.put(std::uint64_t{0});
+        for (std::size_t from = 0; from < cut.transactionEnd;) {
+            std::shared_lock<std::shared_mutex> lock(catalogMutex);
+            std::size_t n = 0;
+            from = transactions.scan(HistoryFilter{}, from, cut.transactionEnd, [&](std::size_t i, const Transaction& t) {
+                if (n++ == kPage) return false;
+                out.put(bookRef(t.book));
+                out.put(patronRef(t.patron));
+                out.put(Date::unpack(t.date).civilPacked());
+                out.put(static_cast<std::uint8_t>(t.type));
+                if (nextFined != cut.finedLoans.end() && nextFined->first == i) (nextFined++)->first = position;
+                ++position;
+                return true;
+            });
+        }
+        out.patch(countAt, static_cast<std::uint64_t>(position));
+        // 以下各段早期快照没有
+        // 按书籍记录的逾期罚款(单副本时期的格式)，现已改为按借阅记录，这里只写出空段
+        out.put(static_cast<std::uint64_t>(0));
+        // 各书籍的副本数与借出数
+        out.putBytes(copies.data().data(), copies.size());
+        // 在借借阅已计入的逾期罚款，以借出事件写出的位置标识借阅
+        out.put(static_cast<std::uint64_t>(cut.finedLoans.size()));
+        for (const auto& [at, cents] : cut.finedLoans) {
+            out.put(static_cast<std::uint32_t>(at));
+            out.put(cents);
+        }
+        // 已压缩历史的摘要
+        out.put(static_cast<std::uint64_t>(cut.summaries.size()));
+        for (const TransactionLog::Summary& h : cut.summaries) {
+            out.put(h.month);
+            out.put(h.stats.records);
+            out.put(h.stats.checkouts);
+            out.put(h.stats.returns);
+            out.put(h.stats.distinctBooks);
+            out.put(h.stats.distinctPatrons);
+            out.put(Date::fromDays(h.stats.minDay).civilPacked());
+            out.put(Date::fromDays(h.stats.maxDay).civilPacked());
+        }
+        // 预约，按预约先后写出(加载时依次登记即恢复排队次序)，暂停状态由读者欠费决定
+        out.put(static_cast<std::uint64_t>(cut.holds.size()));
+        for (const HoldInfo& h : cut.holds) {
+            out.put(bookRef(h.book));
+            out.put(patronRef(h.patron));
+            out.put(Date::unpack(h.date).civilPacked());
+            out.put(h.priority);
+        }
+        return std::move(out.data());
+    }
+
+    // 生成检查点：短暂持有独占锁，封存已关闭的历史分段、取得日志序号并打开读视图截面，
+    // 之后在锁外序列化并写出快照(借还照常进行)，最后从日志中去掉已被快照覆盖的记录
+    void checkpoint(const std::string& snapshotPath) {
+        if (!wal) return;
+        std::lock_guard<std::mutex> serial(checkpointMutex);
+        std::optional<ReadView> view;
+        std::optional<SnapshotCut> cut;
+        std::uint64_t seq;
+        {
+            std::unique_lock<std::shared_mutex> lock(catalogMutex);
+            transactions.seal();
+            seq = wal->lastSequence();
+            view.emplace(ReadView(*this, viewClock.begin(), books.slotCount(), patrons.slotCount(),
+                                  transactions.size()));
+            cut.emplace(captureSnapshotCut());
+            cut->epoch = view->epoch;
+            cut->bookSlots = view->bookSlots;
+            cut->patronSlots = view->patronSlots;
+            cut->transactionEnd = view->transactionEnd;
+        }
+        wal->waitDurable(seq);
+        std::string body = encodeSnapshot(*cut);
+        view.reset();
+        writeSnapshotFile(snapshotPath, seq, body);
+        wal->truncateThrough(seq);
+    }
+
+    // 从快照内容重建(要求当前图书馆为空)
+    void loadSnapshot(std::string_view body) {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        BinaryReader in(body);
+        auto bookCount = in.get<std::uint64_t>();
+        books.reserve(bookCount);
+        bookIndex.reserve(bookCount);
+        for (std::uint64_t i = 0; i < bookCount; ++i) {
+            Book book = decodeBook(in);
+            book.setOnLoan(in.get<std::uint8_t>() ? 1 : 0);
+            BookId id = books.emplace(std::move(book));
+            searchIndex.add(id, books[id].getTitle(), books[id].getAuthor());
+            bookIndex.emplace(Book::isbnKey(books[id].getISBN()), id);
+        }
+        auto patronCount = in.get<std::uint64_t>();
+        patrons.reserve(patronCount);
+        patronIndex.reserve(patronCount);
+        for (std::uint64_t i = 0; i < patronCount; ++i) {
+            PatronId id = patrons.emplace(decodePatron(in));
+            feeLedger.update(id, 0, patrons[id].getFeeCents());
+            patronIndex.emplace(patrons[id].getCardNumber(), id);
+        }
+        auto transactionCount = in.get<std::uint64_t>();
+        for (std::uint64_t i = 0; i < transactionCount; ++i) {
+            Transaction t;
+            t.book = in.get<BookId>();
+            t.patron = in.get<PatronId>();
+            t.date = Date::fromCivilPacked(in.get<std::uint32_t>()).pack();
+            t.type = static_cast<TransactionType>(in.get<std::uint8_t>());
+            transactions.append(t);
+        }
+        // 以下各段早期快照没有：按书籍记录的罚款、副本数与借出数、按借阅记录的罚款
+        std::vector<std::pair<BookId, Cents>> bookFines;
+        std::vector<std::pair<std::uint32_t, Cents>> loanFines;
+        if (in.remaining() > 0) {
+            auto fined = in.get<std::uint64_t>();
+            for (std::uint64_t i = 0; i < fined; ++i) {
+                BookId b = in.get<BookId>();
+                bookFines.emplace_back(b, in.get<Cents>());
+            }
+        }
+        if (in.remaining() > 0) {
+            for (std::uint64_t i = 0; i < bookCount; ++i) {
+                Book& book = books[books.handleAt(i)];
+                book.setCopies(in.get<std::uint32_t>());
+                book.setOnLoan(in.get<std::uint32_t>());
+            }
+            auto fined = in.get<std::uint64_t>();
+            for (std::uint64_t i = 0; i < fined; ++i) {
+                std::uint32_t t = in.get<std::uint32_t>();
+                loanFines.emplace_back(t, in.get<Cents>());
+            }
+        }
+        if (in.remaining() > 0) {
+            std::vector<TransactionLog::Summary> summaries(in.get<std::uint64_t>());
+            for (TransactionLog::Summary& h : summaries) {
+                h.month = in.get<std::int32_t>();
+                h.stats.records = in.get<std::uint64_t>();
+                h.stats.checkouts = in.get<std::uint64_t>();
+                h.stats.returns = in.get<std::uint64_t>();
+                h.stats.distinctBooks = in.get<std::uint64_t>();
+                h.stats.distinctPatrons = in.get<std::uint64_t>();
+                h.stats.minDay = Date::fromCivilPacked(in.get<std::uint32_t>()).dayNumber();
+                h.stats.maxDay = Date::fromCivilPacked(in.get<std::uint32_t>()).dayNumber();
+            }
+            transactions.restoreSummaries(std::move(summaries));
+        }
+        rebuildLoans();
+        for (const auto& [b, cents] : bookFines) {
+            if (!books.contains(b)) continue;
+            LoanId id = loans.newestLoan(b);
+            if (id != LoanIndex::kNoLoan) loans.setFinedAmount(id, cents);
+        }
+        if (!loanFines.empty()) {
+            std::unordered_map<std::uint32_t, LoanId> byTransaction;
+            for (LoanId id = 0; id < loans.loanCapacity(); ++id) {
+                if (loans.isOpen(id)) byTransaction.emplace(static_cast<std::uint32_t>(loans.checkoutTransaction(id)), id);
+            }
+            for (const auto& [t, cents] : loanFines) {
+                auto it = byTransaction.find(t);
+                if (it != byTransaction.end()) loans.setFinedAmount(it->second, cents);
+            }
+        }
+        if (in.remaining() > 0) {
+            auto count = in.get<std::uint64_t>();
+            for (std::uint64_t i = 0; i < count; ++i) {
+                BookId b = books.handleAt(in.get<std::uint32_t>());
+                PatronId p = patrons.handleAt(in.get<std::uint32_t>());
+                std::uint32_t date = Date::fromCivilPacked(in.get<std::uint32_t>()).pack();
+                holds.add(b, p, date, in.get<std::uint8_t>(), patrons[p].owesFees());
+            }
+        }
+    }
+
+    // 获取所有欠费读者名单(按欠费从高到低)
+    // 需要复制姓名，仅为兼容保留；新代码请使用forEachDebtor
+    std::vector<std::string> getPatronsWithFees() const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        std::vector<std::string> result;
+        result.reserve(feeLedger.debtorCount());
+        feeLedger.forEach([&](PatronId id, Cents) { result.emplace_back(patrons[id].getName()); });
+        return result;
+    }
+
+    // 按欠费从高到低遍历全部欠费读者，回调f(读者, 欠费分)
+    // 只访问欠费读者本身，不复制；回调期间欠费修改会等待，回调中不应再修改欠费
+    template <typename F>
+    void forEachDebtor(F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        feeLedger.forEach([&](PatronId id, Cents amount) { f(patrons[id], amount); });
+    }
+
+    // 分页遍历欠费读者，after为上一页返回的游标(首页为空)，回调f(读者, 欠费分)
+    // 返回下一页游标，没有更多记录时返回空
+    template <typename F>
+    std::optional<DebtorCursor> forEachDebtor(FeeOrder order, const std::optional<DebtorCursor>& after,
+                                              std::size_t limit, F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        return feeLedger.page(order, after, limit,
+                              [&](PatronId id, Cents amount) { f(patrons[id], amount); });
+    }
+
+    // 遍历读者当前在借的书籍，回调f(借出记录, 书籍, 读者)，最近借出的在前
+    // 只访问该读者自己的在借链表；读者未注册时返回false
+    template <typename F>
+    bool forEachLoan(int cardNumber, F&& f) const {
+        std::shared_lock<std::shared_mutex> catalog(catalogMutex);
+        auto it = patronIndex.find(cardNumber);
+        if (it == patronIndex.end()) return false;
+        PatronId patronId = it->second;
+        std::lock_guard<std::mutex> patronLock(patronLocks[stripeOf(patronId)]);
+        loans.forEachLoan(patronId, [&](BookId book, std::size_t transaction) {
+            f(transactions[transaction], books[book], patrons[patronId]);
+        });
+        return true;
+    }
+
+    // 读者在借数量，读者未注册时抛出异常
+    std::size_t getLoanCount(int cardNumber) const {
+        std::shared_lock<std::shared_mutex> catalog(catalogMutex);
+        auto it = patronIndex.find(cardNumber);
+        if (it == patronIndex.end()) {
+            throw std::runtime_error("读者未注册");
+        }
+        PatronId patronId = it->second;
+        std::lock_guard<std::mutex> patronLock(patronLocks[stripeOf(patronId)]);
+        return loans.loanCount(patronId);
+    }
+
+    // 预约书籍：该书没有可借副本时排队，还回的副本按优先级(0~3，越大越先)与预约先后分配给不欠费的读者
+    // 读者欠费、已预约或已借有该书、或该书仍有可借副本时抛出异常；返回该书的预约总数
+    std::size_t placeHold(std::string_view isbn, int cardNumber, const Date& date = Date(),
+                          std::uint8_t priority = 0) {
+        if (priority > HoldIndex::kMaxPriority) {
+            throw std::invalid_argument("预约优先级须为0到3");
+        }
+        std::uint64_t seq = 0;
+        std::size_t queued = 0;
+        {
+            std::shared_lock<std::shared_mutex> catalog(catalogMutex);
+            auto bookIt = bookIndex.find(Book::isbnKey(isbn));
+            if (bookIt == bookIndex.end()) {
+                throw std::runtime_error("未找到该ISBN的书籍");
+            }
+            auto patronIt = patronIndex.find(cardNumber);
+            if (patronIt == patronIndex.end()) {
+                throw std::runtime_error("读者未注册");
+            }
+            BookId bookId = bookIt->second;
+            PatronId patronId = patronIt->second;
+            std::lock_guard<std::mutex> bookLock(bookLocks[stripeOf(bookId)]);
+            std::lock_guard<std::mutex> patronLock(patronLocks[stripeOf(patronId)]);
+            if (patrons[patronId].owesFees()) {
+                throw std::runtime_error("读者有欠费，不能预约");
+            }
+            if (copyFreeFor(bookId, patronId)) {
+                throw std::runtime_error("该书有可借副本，请直接借阅");
+            }
+            if (loans.findLoan(bookId, patronId) != LoanIndex::kNoLoan) {
+                throw std::runtime_error("读者已借有该书");
+            }
+            if (holds.contains(bookId, patronId)) {
+                throw std::runtime_error("读者已预约该书");
+            }
+            BinaryWriter record;
+            record.putString(isbn);
+            record.put(static_cast<std::int32_t>(cardNumber));
+            record.put(date.civilPacked());
+            record.put(priority);
+            seq = logRecord(WalRecordType::placeHold, record);
+            holds.add(bookId, patronId, date.pack(), priority, false);
+            queued = holds.bookHoldCount(bookId);
+        }
+        waitLogged(seq);
+        return queued;
+    }
+
+    // 取消预约，读者没有预约该书时抛出异常
+    void cancelHold(std::string_view isbn, int cardNumber) {
+        std::uint64_t seq = 0;
+        {
+            std::shared_lock<std::shared_mutex> catalog(catalogMutex);
+            auto bookIt = bookIndex.find(Book::isbnKey(isbn));
+            if (bookIt == bookIndex.end()) {
+                throw std::runtime_error("未找到该ISBN的书籍");
+            }
+            auto patronIt = patronIndex.find(cardNumber);
+            if (patronIt == patronIndex.end()) {
+                throw std::runtime_error("读者未注册");
+            }
+            BookId bookId = bookIt->second;
+            PatronId patronId = patronIt->second;
+            std::lock_guard<std::mutex> bookLock(bookLocks[stripeOf(bookId)]);
+            std::lock_guard<std::mutex> patronLock(patronLocks[stripeOf(patronId)]);
+            if (!holds.contains(bookId, patronId)) {
+                throw std::runtime_error("读者没有预约该书");
+            }
+            BinaryWriter record;
+            record.putString(isbn);
+            record.put(static_cast<std::int32_t>(cardNumber));
+            seq = logRecord(WalRecordType::cancelHold, record);
+            holds.remove(bookId, patronId);
+        }
+        waitLogged(seq);
+    }
+
+    // 遍历读者的预约，回调f(预约概况, 书籍)，最近预约的在前；只访问该读者自己的预约链表，读者未注册时返回false
+    template <typename F>
+    bool forEachHold(int cardNumber, F&& f) const {
+        std::shared_lock<std::shared_mutex> catalog(catalogMutex);
+        auto it = patronIndex.find(cardNumber);
+        if (it == patronIndex.end()) return false;
+        PatronId patronId = it->second;
+        std::lock_guard<std::mutex> patronLock(patronLocks[stripeOf(patronId)]);
+        holds.forEachHold(patronId, [&](const HoldInfo& h) { f(h, books[h.book]); });
+        return true;
+    }
+
+    // 全部预约数(含暂停的)
+    std::size_t getHoldCount() const { return holds.size(); }
+
+    // 欠费读者人数
+    std::size_t getDebtorCount() const { return feeLedger.debtorCount(); }
+
+    // 欠费总额(分)
+    Cents getTotalFees() const { return feeLedger.totalOutstanding(); }
+
+    // 某一类型的馆藏与可借情况(读汇总计数，与馆藏规模无关)
+    GenreHoldings getHoldings(Genre genre) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        auto g = static_cast<std::size_t>(genre);
+        GenreHoldings h;
+        h.titles = genreTitles[g];
+        h.copies = genreCopies[g];
+        h.onLoan = genreOnLoan[g].load(std::memory_order_relaxed);
+        return h;
+    }
+
+    // 副本总数
+    std::uint64_t getTotalCopies() const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        return totalCopies;
+    }
+
+    // 包含date的那一天/那一周的借还计数(超出保留范围时全为0)
+    CirculationCounts getCirculationCounts(AnalyticsPeriod period, const Date& date) const {
+        return analytics.counts(period, date.dayNumber());
+    }
+
+    // 包含date的那一天/那一周借出最多的书籍，从高到低回调f(书籍, 借出次数)，最多limit本
+    // 次数为草图估计值，可能略高于实际；已删除的书籍被跳过
+    template <typename F>
+    void forEachTopTitle(AnalyticsPeriod period, const Date& date, std::size_t limit, F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        analytics.topTitles(period, date.dayNumber(), limit, [&](BookId id, std::uint64_t count) {
+            if (const Book* book = books.get(id)) f(*book, count);
+        });
+    }
+
+    // 同上，按作者汇总，回调f(作者, 借出次数)
+    template <typename F>
+    void forEachTopAuthor(AnalyticsPeriod period, const Date& date, std::size_t limit, F&& f) const {
+        analytics.topAuthors(period, date.dayNumber(), limit,
+                             [&](const PooledString& author, std::uint64_t count) { f(author.view(), count); });
+    }
+
+    // 截至date近期走红的书籍，按近期与基准期日均借出之比从高到低回调f(书籍, 走红情况)，最多limit本
+    template <typename F>
+    void forEachTrendingTitle(const Date& date, std::size_t limit, F&& f) const {
+        std::vector<TrendingTitle> trending = analytics.trending(date.dayNumber(), limit);
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        for (const TrendingTitle& t : trending) {
+            if (const Book* book = books.get(t.book)) f(*book, t);
+        }
+    }
+
+    // 遍历所有书籍(持共享锁，不阻塞借还书)
+    template <typename F>
+    void forEachBook(F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        for (const Book& book : books) f(book);
+    }
+
+    // 遍历所有读者(持共享锁，不阻塞借还书)
+    template <typename F>
+    void forEachPatron(F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        for (const Patron& patron : patrons) f(patron);
+    }
+
+    // 遍历开始时已提交的借阅记录，回调f(记录, 书籍, 读者)
+    // 涉及已删除书籍/读者的记录被跳过
+    template <typename F>
+    void forEachTransaction(F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        transactions.scan(HistoryFilter{}, 0, transactions.size(), [&](std::size_t, const Transaction& t) {
+            const Book* book = books.get(t.book);
+            const Patron* patron = patrons.get(t.patron);
+            if (book && patron) f(t, *book, *patron);
+            return true;
+        });
+    }
+
+    // 分页遍历：从游标from(首页为0)开始回调至多limit条，返回下一页游标，没有更多记录时返回空
+    // 书籍/读者的游标为槽位号，翻页期间的删除不影响后续页；借阅记录的游标为记录序号
+    template <typename F>
+    std::optional<std::size_t> forEachBook(std::size_t from, std::size_t limit, F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        return pageSlots(books, from, limit, f);
+    }
+
+    template <typename F>
+    std::optional<std::size_t> forEachPatron(std::size_t from, std::size_t limit, F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        return pageSlots(patrons, from, limit, f);
+    }
+
+    template <typename F>
+    std::optional<std::size_t> forEachTransaction(std::size_t from, std::size_t limit, F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        return pageTransactions(HistoryFilter{}, from, limit, f);
+    }
+
+    // 按条件分页查询借阅历史，游标与返回值同forEachTransaction；书籍或读者不存在时抛出异常
+    // 日期范围不相交、或布隆过滤器表明不含该书/该读者的历史分段整段跳过
+    template <typename F>
+    std::optional<std::size_t> forEachHistory(const HistoryQuery& query, std::size_t from, std::size_t limit,
+                                              F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        HistoryFilter filter;
+        if (query.from) filter.fromDay = query.from->dayNumber();
+        if (query.to) filter.toDay = query.to->dayNumber();
+        if (!query.isbn.empty()) {
+            auto it = bookIndex.find(Book::isbnKey(query.isbn));
+            if (it == bookIndex.end()) {
+                throw std::runtime_error("未找到该ISBN的书籍");
+            }
+            filter.book = it->second;
+        }
+        if (query.cardNumber != 0) {
+            auto it = patronIndex.find(query.cardNumber);
+            if (it == patronIndex.end()) {
+                throw std::runtime_error("读者未注册");
+            }
+            filter.patron = it->second;
+        }
+        return pageTransactions(filter, from, limit, f);
+    }
+
+    // 遍历借阅历史的各分段概况f(HistorySegmentInfo)，按月份从早到晚
+    template <typename F>
+    void forEachHistorySegment(F&& f) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        transactions.forEachSegment(f);
+    }
+
+    // 封存已关闭(不是当月)的历史分段，返回本次封存的分段数；检查点时也会封存
+    std::size_t sealHistory() {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        return transactions.seal();
+    }
+
+    // 把全部记录都早于before的历史分段压缩为摘要，仍在借的借出记录保留，其余记录不再可查
+    // 返回被压缩的分段；有读视图打开时不能压缩
+    // 压缩不写日志，下一次检查点时随快照保存，此前崩溃则恢复为压缩前的历史
+    std::vector<HistorySegmentInfo> compactHistory(const Date& before) {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        if (viewClock.active()) {
+            throw std::runtime_error("有读视图打开，暂不能压缩借阅历史");
+        }
+        std::vector<std::size_t> keep;
+        for (LoanId id = 0; id < loans.loanCapacity(); ++id) {
+            if (loans.isOpen(id)) keep.push_back(loans.checkoutTransaction(id));
+        }
+        std::sort(keep.begin(), keep.end());
+        return transactions.compact(before.dayNumber(), keep);
+    }
+
+    // 设置封存分段的落盘目录(须已存在)，空串表示保留在内存中
+    void setHistorySpillDirectory(const std::string& directory) {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        transactions.setSpillDirectory(directory);
+    }
+
+    // 读视图：打开时刻馆藏、读者与借阅记录的一致快照，之后提交的借还、欠费修改与增删都不可见
+    // 遍历按页进行，每页只持共享锁，不阻塞借还书；页与页之间添加/删除书籍等独占操作也可进行
+    // 视图打开期间写者为被修改的行保留旧版本，视图析构时回收；报表/导出结束后应尽快释放
+    class ReadView {
+    private:
+        static constexpr std::size_t kPageSize = 1024;
+
+        const Library* lib;
+        std::uint64_t epoch;
+        std::size_t bookSlots;
+        std::size_t patronSlots;
+        std::size_t transactionEnd;
+
+        friend class Library;
+        ReadView(const Library& l, std::uint64_t e, std::size_t b, std::size_t p, std::size_t t)
+            : lib(&l), epoch(e), bookSlots(b), patronSlots(p), transactionEnd(t) {}
+
+        // 按槽位分页：read(slot, f)返回该槽位在视图中是否有行
+        template <typename Read, typename F>
+        static std::optional<std::size_t> pageSlots(std::size_t from, std::size_t end, std::size_t limit,
+                                                    Read&& read, F& f) {
+            std::size_t slot = from;
+            for (std::size_t n = 0; slot < end && n < limit; ++slot) {
+                if (read(static_cast<std::uint32_t>(slot), [&](const auto& row, SlotHandle) { f(row); })) ++n;
+            }
+            auto skip = [](const auto&, SlotHandle) {};
+            while (slot < end && !read(static_cast<std::uint32_t>(slot), skip)) ++slot;
+            return slot < end ? std::optional<std::size_t>(slot) : std::nullopt;
+        }
+
+    public:
+        ReadView(ReadView&& other) noexcept
+            : lib(std::exchange(other.lib, nullptr)), epoch(other.epoch), bookSlots(other.bookSlots),
+              patronSlots(other.patronSlots), transactionEnd(other.transactionEnd) {}
+        ReadView(const ReadView&) = delete;
+        ReadView& operator=(const ReadView&) = delete;
+        ReadView& operator=(ReadView&&) = delete;
+
+        ~ReadView() {
+            if (lib) lib->closeView(epoch);
+        }
+
+        // 视图中的借阅记录条数(含涉及已删除书籍/读者的记录)
+        std::size_t transactionCount() const { return transactionEnd; }
+
+        // 分页遍历，游标含义与Library::forEachBook等相同
+        template <typename F>
+        std::optional<std::size_t> forEachBook(std::size_t from, std::size_t limit, F&& f) const {
+            std::shared_lock<std::shared_mutex> lock(lib->catalogMutex);
+            return pageSlots(from, bookSlots, limit,
+                             [&](std::uint32_t slot, auto&& g) { return lib->readBookAt(slot, epoch, g); }, f);
+        }
+
+        template <typename F>
+        std::optional<std::size_t> forEachPatron(std::size_t from, std::size_t limit, F&& f) const {
+            std::shared_lock<std::shared_mutex> lock(lib->catalogMutex);
+            return pageSlots(from, patronSlots, limit,
+                             [&](std::uint32_t slot, auto&& g) { return lib->readPatronAt(slot, epoch, g); }, f);
+        }
+
+        // 回调f(记录, 书籍, 读者)，书籍与读者为视图中的版本；涉及视图打开前已删除的书籍/读者的记录被跳过
+        template <typename F>
+        std::optional<std::size_t> forEachTransaction(std::size_t from, std::size_t limit, F&& f) const {
+            std::shared_lock<std::shared_mutex> lock(lib->catalogMutex);
+            std::size_t n = 0;
+            std::size_t next = lib->transactions.scan(HistoryFilter{}, from, transactionEnd,
+                                                      [&](std::size_t, const Transaction& t) {
+                if (n == limit) return false;
+                bool shown = false;
+                lib->readBookAt(slotIndex(t.book), epoch, [&](const Book& book, BookId b) {
+                    if (b != t.book) return;
+                    lib->readPatronAt(slotIndex(t.patron), epoch, [&](const Patron& patron, PatronId p) {
+                        if (p != t.patron) return;
+                        f(t, book, patron);
+                        shown = true;
+                    });
+                });
+                if (shown) ++n;
+                return true;
+            });
+            return next < transactionEnd ? std::optional<std::size_t>(next) : std::nullopt;
+        }
+
+        // 遍历视图中的全部书籍/读者/借阅记录(逐页加锁)
+        template <typename F>
+        void forEachBook(F&& f) const {
+            for (std::optional<std::size_t> at = 0; at;) at = forEachBook(*at, kPageSize, f);
+        }
+
+        template <typename F>
+        void forEachPatron(F&& f) const {
+            for (std::optional<std::size_t> at = 0; at;) at = forEachPatron(*at, kPageSize, f);
+        }
+
+        template <typename F>
+        void forEachTransaction(F&& f) const {
+            for (std::optional<std::size_t> at = 0; at;) at = forEachTransaction(*at, kPageSize, f);
+        }
+    };
+
+    // 打开读视图：短暂持有独占锁，等在途的借还与修改完成后取得当前纪元
+    ReadView openReadView() const {
+        std::unique_lock<std::shared_mutex> lock(catalogMutex);
+        return ReadView(*this, viewClock.begin(), books.slotCount(), patrons.slotCount(), transactions.size());
+    }
+
+    // 按组合条件分页遍历书籍，游标为槽位号；matched非空时写入满足条件的书籍总数
+    // 可借状态随并发借还变化，结果反映查询时刻附近的状态
+    template <typename F>
+    std::optional<std::size_t> queryBooks(const BookFilterSpec& spec, std::size_t from, std::size_t limit, F&& f,
+                                          std::size_t* matched = nullptr) const {
+        std::shared_lock<std::shared_mutex> lock(catalogMutex);
+        std::vector<BookFilterIndex::Word> bits;
+        std::size_t count = filterIndex.match(spec, bits);
+        if (matched) *matched = count;
+        return BookFilterIndex::forEachSlot(bits, from, limit, [&](std::uint32_t slot) {
+            f(books[books.handleAtSlot(slot)]);
+        });
+    }
+
+    // 以下直接访问接口不加锁，仅供单线程使用
+    const SlotMap<Book>& getBooks() const {
+        return books;
+    }
+    
+    const SlotMap<Patron>& getPatrons() const {
+        return patrons;
+    }
+    
+    // 按句柄获取书籍/读者，用于解析借阅记录；句柄已失效时返回nullptr
+    const Book* getBook(BookId id) const { return books.get(id); }
+    const Patron* getPatron(PatronId id) const { return patrons.get(id); }
+
+    // 获取所有借阅记录
+    const TransactionLog& getTransactions() const {
+        return transactions;
+    }
+};
+
+
+// 图书馆持久化存储：启动时从快照和日志尾部恢复，运行中记录日志并定期生成快照
+class LibraryStore {
+private:
+    Library& lib;
+    std::string snapshotPath;
+    std::string walPath;
+    std::string historyPath;    // 封存的历史分段落盘目录，只作运行期的内存映射，启动时清空
+    std::unique_ptr<WriteAheadLog> wal;
+
+public:
+    // 日志积累到该记录数后生成新快照
+    static constexpr std::uint64_t kCheckpointInterval = 10000;
+
+    LibraryStore(Library& library, const std::string& basePath)
+        : lib(library), snapshotPath(basePath + ".snap"), walPath(basePath + ".wal"),
+          historyPath(basePath + ".history") {}
+
+    ~LibraryStore() { lib.attachLog(nullptr); }
+
+    // 恢复已有状态并开始记录日志；存在已保存的数据时返回true
+    bool open() {
+        std::uint64_t snapshotSeq = 0;
+        bool recovered = false;
+        std::error_code ec;
+        std::filesystem::remove_all(historyPath, ec);
+        if (std::filesystem::create_directories(historyPath, ec)) lib.setHistorySpillDirectory(historyPath);
+        if (std::filesystem::exists(snapshotPath, ec)) {
+            MappedFile file(snapshotPath);
+            std::string_view body;
+            snapshotSeq = readSnapshotFile(file.view(), body);
+            lib.loadSnapshot(body);
+            recovered = true;
+        }
+        WalReplayResult replayed = replayWal(walPath, snapshotSeq,
+            [this](WalRecordType type, BinaryReader& in) { lib.applyLogRecord(type, in); });
+        recovered = recovered || replayed.validBytes > 0;
+
+        wal = std::make_unique<WriteAheadLog>(walPath, replayed);
+        lib.attachLog(wal.get());
+        return recovered;
+    }
+
+    // 生成快照并清空已被覆盖的日志
+    void checkpoint() {
+        lib.checkpoint(snapshotPath);
+    }
+
+    // 日志积累足够多时生成快照
+    void checkpointIfNeeded() {
+        if (wal && wal->recordsSinceCheckpoint() >= kCheckpointInterval) {
+            checkpoint();
+        }
+    }
+};
+
+#endif // LIBRARY_H
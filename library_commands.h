@@ -0,0 +1,1192 @@
+#ifndef LIBRARY_COMMANDS_H
+#define LIBRARY_COMMANDS_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <istream>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "library.h"
+#include "metrics.h"
+#include "report_writer.h"
+
+// 命令层：所有前端(交互式菜单、批处理脚本)都通过CommandEngine操作Library
+//
+// 批处理命令格式，每行一条，字段以空白分隔，含空格的字段可用双引号括起：
+//   addbook <isbn> <书名> <作者> <年份> <类型> [副本数]   类型为1-5或fiction等英文名，副本数默认为1
+//   addcopies <isbn> <数量>                     为已有书籍增加副本
+//   addpatron <姓名> <借书证号> [欠费]
+//   checkout <isbn> <借书证号> [YYYY-MM-DD]     省略日期时使用当天
+//   return <isbn> [借书证号] [YYYY-MM-DD]       省略日期时使用当天；该书有多个副本在借时须给出借书证号
+//   fees <借书证号> <金额>
+//   book <isbn> | patron <借书证号>
+//   loans <借书证号>                           读者当前在借的书籍
+//   fines [YYYY-MM-DD]                         逾期罚款结算(默认截至当天)，可重复执行
+//   delbook <isbn> | delpatron <借书证号>        删除书籍/注销读者(在借中或有欠费时拒绝)
+//   books | patrons | transactions [条数] [游标]  给出条数时分页输出，游标取自上一页结果
+//   export <books|patrons|transactions> <csv|json> <路径>   导出到文件
+//   metrics [reset|on|off|dump <路径>]          查看/清零/开关运行统计，或把统计写入文件(JSON)
+//   holdings                                   按类型统计种数、副本数与可借副本数
+//   debtors [desc|asc] [条数] [游标]             按欠费金额排序，可分页；游标取自上一页结果
+//   search <关键词> [prefix]                    按书名/作者检索，prefix表示前缀匹配
+//   query [genre=<类型>] [year=<起>-<止>] [status=available|lent] [条数] [游标]
+//                                              组合条件筛选书籍，年份两端均含、可省略一端；先输出命中总数
+//   top <titles|authors|genres> [day|week] [YYYY-MM-DD] [条数]
+//                                              某天/某周(默认当天)借出最多的书籍、作者或类型，默认10条
+//   trending [YYYY-MM-DD] [条数]                截至某天近期借出明显增多的书籍，默认10条
+//   history [from=YYYY-MM-DD] [to=YYYY-MM-DD] [book=<isbn>] [patron=<借书证号>] [条数] [游标]
+//                                              按日期范围(两端均含)、书籍或读者查询借阅历史
+//   segments [seal]                            各月历史分段的状态与统计，seal表示先封存已关闭的分段
+//   compact <YYYY-MM-DD>                       把早于该日期的历史分段压缩为摘要(仍在借的借出记录保留)
+//   hold <isbn> <借书证号> [YYYY-MM-DD] [优先级]   没有可借副本时预约排队，优先级0-3(默认0，越大越先)
+//   cancelhold <isbn> <借书证号>                 取消预约
+//   holds <借书证号>                           读者的预约；归还的副本分配给预约读者时，return另输出一行assigned
+// 空行与以#开头的行被忽略
+
+// 命令类型
+enum class CommandType : std::uint8_t {
+    addBook,
+    addPatron,
+    checkout,
+    checkin,
+    setFees,
+    findBook,
+    findPatron,
+    listBooks,
+    listPatrons,
+    listTransactions,
+    listDebtors,
+    search,
+    listLoans,
+    accrueFines,
+    removeBook,
+    removePatron,
+    exportReport,
+    showMetrics,
+    addCopies,
+    showHoldings,
+    queryBooks,
+    topCirculation,
+    trending,
+    queryHistory,
+    listSegments,
+    compactHistory,
+    placeHold,
+    cancelHold,
+    listHolds
+};
+
+constexpr std::size_t kCommandTypeCount = 29;
+static_assert(kCommandTypeCount <= Metrics::kMaxOperations);
+
+// 命令名及参数个数范围，按CommandType顺序排列
+struct CommandSpec {
+    std::string_view name;
+    std::size_t minArgs;
+    std::size_t maxArgs;
+};
+
+constexpr CommandSpec kCommandSpecs[kCommandTypeCount] = {
+    {"addbook", 5, 6},
+    {"addpatron", 2, 3},
+    {"checkout", 2, 3},
+    {"return", 1, 3},
+    {"fees", 2, 2},
+    {"book", 1, 1},
+    {"patron", 1, 1},
+    {"books", 0, 2},
+    {"patrons", 0, 2},
+    {"transactions", 0, 2},
+    {"debtors", 0, 3},
+    {"search", 1, 2},
+    {"loans", 1, 1},
+    {"fines", 0, 1},
+    {"delbook", 1, 1},
+    {"delpatron", 1, 1},
+    {"export", 3, 3},
+    {"metrics", 0, 2},
+    {"addcopies", 2, 2},
+    {"holdings", 0, 0},
+    {"query", 0, 5},
+    {"top", 1, 4},
+    {"trending", 0, 2},
+    {"history", 0, 6},
+    {"segments", 0, 1},
+    {"compact", 1, 1},
+    {"hold", 2, 4},
+    {"cancelhold", 2, 2},
+    {"holds", 1, 1},
+};
+
+inline std::string_view commandName(CommandType type) {
+    return kCommandSpecs[static_cast<std::size_t>(type)].name;
+}
+
+// 运行统计的JSON表示：每条命令一项，只列出执行过的命令
+inline void appendMetricsJson(std::string& out, const Metrics::Snapshot& snapshot) {
+    out += "{\"enabled\":";
+    out += Metrics::global().enabled() ? "true" : "false";
+    out += ",\"operations\":[";
+    bool first = true;
+    for (std::size_t op = 0; op < kCommandTypeCount; ++op) {
+        const OperationStats& o = snapshot[op];
+        if (o.count == 0) continue;
+        if (!first) out += ',';
+        first = false;
+        out += "{\"op\":\"";
+        out += commandName(static_cast<CommandType>(op));
+        out += "\",\"count\":" + std::to_string(o.count);
+        out += ",\"failures\":" + std::to_string(o.failures);
+        out += ",\"avgNs\":" + std::to_string(static_cast<std::uint64_t>(o.averageNs()));
+        out += ",\"p50Ns\":" + std::to_string(o.percentileNs(0.5));
+        out += ",\"p90Ns\":" + std::to_string(o.percentileNs(0.9));
+        out += ",\"p99Ns\":" + std::to_string(o.percentileNs(0.99));
+        out += ",\"maxNs\":" + std::to_string(o.maxNs());
+        out += ",\"reasons\":[";
+        for (std::size_t r = 0; r < o.reasons.size(); ++r) {
+            if (r) out += ',';
+            out += "{\"reason\":";
+            appendJsonString(out, o.reasons[r].first);
+            out += ",\"count\":" + std::to_string(o.reasons[r].second) + "}";
+        }
+        out += "]}";
+    }
+    out += "]}";
+}
+
+// 把当前运行统计写入文件(JSON)
+inline void writeMetricsFile(const std::string& path) {
+    std::string json;
+    appendMetricsJson(json, Metrics::global().snapshot());
+    json += '\n';
+    std::ofstream file(path, std::ios::binary);
+    if (!file.write(json.data(), static_cast<std::streamsize>(json.size()))) {
+        throw std::runtime_error("无法写入统计文件: " + path);
+    }
+}
+
+// 一条命令
+struct Command {
+    CommandType type;
+    std::vector<std::string> args;
+    std::size_t line = 0;   // 批处理中的源行号，交互式命令为0
+};
+
+// 解析一行命令文本；空行/注释返回false且error为空，格式错误返回false并给出error
+inline bool parseCommand(std::string_view text, Command& cmd, std::string& error) {
+    error.clear();
+    std::vector<std::string> tokens;
+    std::size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        if (c == ' ' || c == '\t' || c == '\r') {
+            ++i;
+            continue;
+        }
+        if (c == '#' && tokens.empty()) break;
+        std::string token;
+        if (c == '"') {
+            auto close = text.find('"', i + 1);
+            if (close == std::string_view::npos) {
+                error = "引号未闭合";
+                return false;
+            }
+            token.assign(text.substr(i + 1, close - i - 1));
+            i = close + 1;
+        } else {
+            std::size_t end = i;
+            while (end < text.size() && text[end] != ' ' && text[end] != '\t' && text[end] != '\r') ++end;
+            token.assign(text.substr(i, end - i));
+            i = end;
+        }
+        tokens.push_back(std::move(token));
+    }
+    if (tokens.empty()) return false;
+
+    for (std::size_t t = 0; t < kCommandTypeCount; ++t) {
+        if (tokens[0] == kCommandSpecs[t].name) {
+            std::size_t n = tokens.size() - 1;
+            if (n < kCommandSpecs[t].minArgs || n > kCommandSpecs[t].maxArgs) {
+                error = "参数个数不正确";
+                return false;
+            }
+            cmd.type = static_cast<CommandType>(t);
+            cmd.args.assign(tokens.begin() + 1, tokens.end());
+            return true;
+        }
+    }
+    error = "未知命令: " + tokens[0];
+    return false;
+}
+
+// 命令结果输出接口，由各前端实现
+class ResultWriter {
+public:
+    virtual ~ResultWriter() = default;
+
+    // 命令开始执行
+    virtual void begin(const Command&) {}
+    // 查询/归还命令返回的书籍
+    virtual void book(const Book&) {}
+    // 查询命令返回的读者
+    virtual void patron(const Patron&) {}
+    // 借阅记录(借出或归还事件)
+    virtual void transaction(const Transaction&, const Book&, const Patron&) {}
+    // 欠费读者及其欠费金额(分)
+    virtual void debtor(const Patron&, Cents) {}
+    // 欠费查询汇总：欠费读者总数、欠费总额与下一页游标(没有下一页时为空)
+    virtual void debtorSummary(std::size_t, Cents, const std::string&) {}
+    // 逾期罚款结算结果
+    virtual void fineRun(const FineRunSummary&) {}
+    // 分页查询结束，next为下一页游标(没有下一页时为空)
+    virtual void pageEnd(const std::string&) {}
+    // 分页查询单页最多返回的行数；网络响应须放进一帧，由ResponseEncoder限定
+    virtual std::size_t pageLimit() const { return std::numeric_limits<std::size_t>::max(); }
+    // 导出完成
+    virtual void exported(const ExportSummary&, const std::string&) {}
+    // 运行统计(按CommandType编号)
+    virtual void metrics(const Metrics::Snapshot&) {}
+    // 某一类型的馆藏汇总
+    virtual void holdings(Genre, const GenreHoldings&) {}
+    // 组合条件筛选命中的书籍总数
+    virtual void matchCount(std::size_t) {}
+    // 热门书籍/作者：借出次数(估计值)
+    virtual void rankedBook(const Book&, std::uint64_t) {}
+    virtual void rankedAuthor(std::string_view, std::uint64_t) {}
+    // 某一类型在统计周期内的借出与归还次数
+    virtual void genreCirculation(Genre, std::uint64_t, std::uint64_t) {}
+    // 近期走红的书籍
+    virtual void trendingBook(const Book&, const TrendingTitle&) {}
+    // 借阅历史的一个分段(segments、compact)
+    virtual void historySegment(const HistorySegmentInfo&) {}
+    // 读者的一条预约
+    virtual void hold(const HoldInfo&, const Book&) {}
+    // 归还的副本已借给预约读者
+    virtual void holdFilled(const Book&, const Patron&) {}
+    // 命令结束，失败时error为原因
+    virtual void end(const Command&, bool ok, const std::string& error) = 0;
+};
+
+// 命令执行引擎
+class CommandEngine {
+private:
+    Library& lib;
+
+    // 单次检索返回的最大条数
+    static constexpr std::size_t kSearchLimit = 50;
+    // 热门排行默认条数
+    static constexpr std::size_t kRankingLimit = 10;
+
+    static int parseNumber(const std::string& s, const char* what) {
+        int value;
+        if (!import_detail::parseInt(s, value)) {
+            throw std::invalid_argument(std::string("无效的") + what);
+        }
+        return value;
+    }
+
+    static double parseAmount(const std::string& s) {
+        double value;
+        if (!import_detail::parseDouble(s, value) || !isValidFeeAmount(value)) {
+            throw std::invalid_argument("无效的欠费金额");
+        }
+        return value;
+    }
+
+    static Date parseDate(const std::string& s) {
+        int y, m, d;
+        if (std::sscanf(s.c_str(), "%d-%d-%d", &y, &m, &d) != 3 || !Date::isValid(y, m, d)) {
+            throw std::invalid_argument("无效的日期，应为YYYY-MM-DD");
+        }
+        return Date(y, m, d);
+    }
+
+    // 归还命令的参数：<isbn> [借书证号] [YYYY-MM-DD]，只有两个参数时含'-'的视为日期
+    static LoanRequest parseReturn(const std::vector<std::string>& a) {
+        LoanRequest r{LoanAction::checkin, a[0], 0, Date()};
+        if (a.size() == 3) {
+            r.cardNumber = parseNumber(a[1], "借书证号");
+            r.date = parseDate(a[2]);
+        } else if (a.size() == 2) {
+            if (a[1].find('-') != std::string::npos) r.date = parseDate(a[1]);
+            else r.cardNumber = parseNumber(a[1], "借书证号");
+        }
+        return r;
+    }
+
+    static std::uint32_t parseCopies(const std::string& s) {
+        int n = parseNumber(s, "副本数");
+        if (n <= 0 || static_cast<std::uint32_t>(n) > Book::kMaxCopies) {
+            throw std::invalid_argument("副本数必须为1到65536之间的整数");
+        }
+        return static_cast<std::uint32_t>(n);
+    }
+
+    // 组合筛选参数：key=value形式的条件在前，其余为分页参数[条数] [游标]
+    static BookFilterSpec parseFilter(const std::vector<std::string>& a, std::vector<std::string>& paging) {
+        BookFilterSpec spec;
+        for (const std::string& arg : a) {
+            std::size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                paging.push_back(arg);
+                continue;
+            }
+            if (!paging.empty()) throw std::invalid_argument("筛选条件须写在条数与游标之前");
+            std::string key = arg.substr(0, eq), value = arg.substr(eq + 1);
+            if (key == "genre") {
+                std::uint8_t genre;
+                if (!import_detail::parseGenre(value, genre)) throw std::invalid_argument("无效的书籍类型");
+                spec.genre = genre;
+            } else if (key == "year") {
+                std::size_t dash = value.find('-');
+                if (dash == std::string::npos) {
+                    spec.yearFrom = spec.yearTo = parseNumber(value, "出版年份");
+                } else {
+                    if (dash > 0) spec.yearFrom = parseNumber(value.substr(0, dash), "出版年份");
+                    if (dash + 1 < value.size()) spec.yearTo = parseNumber(value.substr(dash + 1), "出版年份");
+                }
+                if (spec.yearFrom > spec.yearTo) throw std::invalid_argument("出版年份范围的起点大于终点");
+            } else if (key == "status") {
+                if (value == "available") spec.available = true;
+                else if (value == "lent") spec.available = false;
+                else throw std::invalid_argument("状态只能为available或lent");
+            } else {
+                throw std::invalid_argument("未知的筛选条件: " + key);
+            }
+        }
+        if (paging.size() > 2) throw std::invalid_argument("多余的参数");
+        return spec;
+    }
+
+    void queryBooks(const std::vector<std::string>& a, ResultWriter& out) {
+        std::vector<std::string> paging;
+        BookFilterSpec spec = parseFilter(a, paging);
+        listPaged(paging, out, [&](std::size_t from, std::size_t limit) {
+            std::size_t matched = 0;
+            auto next = lib.queryBooks(spec, from, limit, [&](const Book& b) { out.book(b); }, &matched);
+            out.matchCount(matched);
+            return next;
+        });
+    }
+
+    // 借阅历史查询参数：key=value形式的条件在前，其余为分页参数[条数] [游标]
+    static HistoryQuery parseHistory(const std::vector<std::string>& a, std::vector<std::string>& paging) {
+        HistoryQuery query;
+        for (const std::string& arg : a) {
+            std::size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                paging.push_back(arg);
+                continue;
+            }
+            if (!paging.empty()) throw std::invalid_argument("查询条件须写在条数与游标之前");
+            std::string key = arg.substr(0, eq), value = arg.substr(eq + 1);
+            if (key == "from") query.from = parseDate(value);
+            else if (key == "to") query.to = parseDate(value);
+            else if (key == "book") query.isbn = value;
+            else if (key == "patron") query.cardNumber = parseNumber(value, "借书证号");
+            else throw std::invalid_argument("未知的查询条件: " + key);
+        }
+        if (query.from && query.to && *query.to < *query.from) {
+            throw std::invalid_argument("日期范围的起点晚于终点");
+        }
+        if (paging.size() > 2) throw std::invalid_argument("多余的参数");
+        return query;
+    }
+
+    void queryHistory(const std::vector<std::string>& a, ResultWriter& out) {
+        std::vector<std::string> paging;
+        HistoryQuery query = parseHistory(a, paging);
+        listPaged(paging, out, [&](std::size_t from, std::size_t limit) {
+            return lib.forEachHistory(query, from, limit,
+                [&](const Transaction& t, const Book& b, const Patron& p) { out.transaction(t, b, p); });
+        });
+    }
+
+    // 预约命令：<isbn> <借书证号> [YYYY-MM-DD] [优先级]，可选参数中含'-'的视为日期；成功后输出这条预约
+    void placeHold(const std::vector<std::string>& a, ResultWriter& out) {
+        int card = parseNumber(a[1], "借书证号");
+        Date date;
+        int priority = 0;
+        for (std::size_t i = 2; i < a.size(); ++i) {
+            if (a[i].find('-') != std::string::npos) {
+                date = parseDate(a[i]);
+            } else {
+                priority = parseNumber(a[i], "优先级");
+                if (priority < 0 || priority > HoldIndex::kMaxPriority) {
+                    throw std::invalid_argument("预约优先级须为0到3");
+                }
+            }
+        }
+        lib.placeHold(a[0], card, date, static_cast<std::uint8_t>(priority));
+        std::uint64_t key = Book::isbnKey(a[0]);
+        lib.forEachHold(card, [&](const HoldInfo& h, const Book& b) {
+            if (Book::isbnKey(b.getISBN()) == key) out.hold(h, b);
+        });
+    }
+
+    // 借阅统计的可选参数：统计周期、日期(含'-')与条数，顺序不限
+    struct RankingArgs {
+        AnalyticsPeriod period = AnalyticsPeriod::day;
+        Date date;
+        std::size_t limit = kRankingLimit;
+    };
+
+    static RankingArgs parseRanking(std::span<const std::string> a, bool allowPeriod) {
+        RankingArgs r;
+        for (const std::string& arg : a) {
+            if (allowPeriod && arg == "day") {
+                r.period = AnalyticsPeriod::day;
+            } else if (allowPeriod && arg == "week") {
+                r.period = AnalyticsPeriod::week;
+            } else if (arg.find('-') != std::string::npos) {
+                r.date = parseDate(arg);
+            } else {
+                int n = parseNumber(arg, "条数");
+                if (n <= 0) throw std::invalid_argument("条数必须为正数");
+                r.limit = static_cast<std::size_t>(n);
+            }
+        }
+        return r;
+    }
+
+    void topCirculation(const std::vector<std::string>& a, ResultWriter& out) {
+        RankingArgs r = parseRanking(std::span<const std::string>(a).subspan(1), true);
+        if (a[0] == "titles") {
+            lib.forEachTopTitle(r.period, r.date, r.limit,
+                                [&](const Book& b, std::uint64_t count) { out.rankedBook(b, count); });
+        } else if (a[0] == "authors") {
+            lib.forEachTopAuthor(r.period, r.date, r.limit,
+                                 [&](std::string_view author, std::uint64_t count) { out.rankedAuthor(author, count); });
+        } else if (a[0] == "genres") {
+            CirculationCounts c = lib.getCirculationCounts(r.period, r.date);
+            std::array<std::size_t, kGenreCount> order;
+            for (std::size_t g = 0; g < kGenreCount; ++g) order[g] = g;
+            std::stable_sort(order.begin(), order.end(),
+                [&](std::size_t x, std::size_t y) { return c.genreCheckouts[x] > c.genreCheckouts[y]; });
+            for (std::size_t i = 0; i < std::min(r.limit, kGenreCount); ++i) {
+                std::size_t g = order[i];
+                out.genreCirculation(static_cast<Genre>(g), c.genreCheckouts[g], c.genreReturns[g]);
+            }
+        } else {
+            throw std::invalid_argument("统计对象只能为titles、authors或genres");
+        }
+    }
+
+    // 分页游标文本格式为"金额(分):读者句柄"
+    static std::string formatCursor(const DebtorCursor& c) {
+        return std::to_string(c.amount) + ":" + std::to_string(c.patron);
+    }
+
+    static DebtorCursor parseCursor(const std::string& s) {
+        long long amount;
+        unsigned long patron;
+        if (std::sscanf(s.c_str(), "%lld:%lu", &amount, &patron) != 2 || amount <= 0) {
+            throw std::invalid_argument("无效的分页游标");
+        }
+        return DebtorCursor{amount, static_cast<PatronId>(patron)};
+    }
+
+    // 分页列出书籍/读者/借阅记录；没有参数时列出全部
+    // 输出方式限定了单页行数时(网络响应)，条数截到该上限，没有参数也只返回第一页，并总是给出下一页游标
+    template <typename Each>
+    void listPaged(const std::vector<std::string>& a, ResultWriter& out, Each&& each) {
+        std::size_t limit = out.pageLimit();
+        if (a.empty() && limit == std::numeric_limits<std::size_t>::max()) {
+            each(0, limit);
+            return;
+        }
+        if (!a.empty()) {
+            int n = parseNumber(a[0], "条数");
+            if (n <= 0) throw std::invalid_argument("条数必须为正数");
+            limit = std::min(limit, static_cast<std::size_t>(n));
+        }
+        std::size_t from = 0;
+        if (a.size() == 2) {
+            int cursor;
+            if (!import_detail::parseInt(a[1], cursor) || cursor < 0) {
+                throw std::invalid_argument("无效的分页游标");
+            }
+            from = static_cast<std::size_t>(cursor);
+        }
+        std::optional<std::size_t> next = each(from, limit);
+        out.pageEnd(next ? std::to_string(*next) : "");
+    }
+
+    void exportReport(const std::vector<std::string>& a, ResultWriter& out) {
+        ExportKind kind;
+        if (!parseExportKind(a[0], kind)) {
+            throw std::invalid_argument("导出内容只能为books、patrons或transactions");
+        }
+        ExportFormat format;
+        if (!parseExportFormat(a[1], format)) {
+            throw std::invalid_argument("导出格式只能为csv或json");
+        }
+        std::ofstream file(a[2], std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("无法写入导出文件: " + a[2]);
+        }
+        OutputBuffer buffer(file);
+        ExportSummary summary = ReportExporter(lib, buffer, format).run(kind);
+        if (!file) {
+            throw std::runtime_error("写入导出文件失败: " + a[2]);
+        }
+        out.exported(summary, a[2]);
+    }
+
+    void metricsCommand(const std::vector<std::string>& a, ResultWriter& out) {
+        Metrics& m = Metrics::global();
+        if (a.empty()) {
+            out.metrics(m.snapshot());
+        } else if (a[0] == "reset" && a.size() == 1) {
+            m.reset();
+        } else if (a[0] == "on" && a.size() == 1) {
+            m.setEnabled(true);
+        } else if (a[0] == "off" && a.size() == 1) {
+            m.setEnabled(false);
+        } else if (a[0] == "dump" && a.size() == 2) {
+            writeMetricsFile(a[1]);
+        } else {
+            throw std::invalid_argument("用法: metrics [reset|on|off|dump <路径>]");
+        }
+    }
+
+    void listDebtors(const std::vector<std::string>& a, ResultWriter& out) {
+        FeeOrder order = FeeOrder::descending;
+        if (!a.empty()) {
+            if (a[0] == "asc") order = FeeOrder::ascending;
+            else if (a[0] != "desc") throw std::invalid_argument("排序方式只能为asc或desc");
+        }
+        std::size_t limit = SIZE_MAX;
+        if (a.size() >= 2) {
+            int n = parseNumber(a[1], "条数");
+            if (n <= 0) throw std::invalid_argument("条数必须为正数");
+            limit = static_cast<std::size_t>(n);
+        }
+        std::optional<DebtorCursor> after;
+        if (a.size() == 3) after = parseCursor(a[2]);
+
+        auto next = lib.forEachDebtor(order, after, limit,
+                                      [&](const Patron& p, Cents amount) { out.debtor(p, amount); });
+        out.debtorSummary(lib.getDebtorCount(), lib.getTotalFees(), next ? formatCursor(*next) : "");
+    }
+
+    void dispatch(const Command& cmd, ResultWriter& out) {
+        const auto& a = cmd.args;
+        switch (cmd.type) {
+            case CommandType::addBook: {
+                std::uint8_t genre;
+                if (!import_detail::parseGenre(a[4], genre)) {
+                    throw std::invalid_argument("无效的书籍类型");
+                }
+                int year = parseNumber(a[3], "出版年份");
+                if (year <= 0 || year > getCurrentYear()) {
+                    throw std::invalid_argument("无效的出版年份");
+                }
+                std::uint32_t copies = a.size() == 6 ? parseCopies(a[5]) : 1;
+                lib.addBook(Book(a[0], a[1], a[2], year, static_cast<Genre>(genre), copies));
+                break;
+            }
+            case CommandType::addPatron: {
+                int card = parseNumber(a[1], "借书证号");
+                if (card <= 0) {
+                    throw std::invalid_argument("证号必须为正数");
+                }
+                Patron patron(a[0], card);
+                if (a.size() == 3) patron.setFees(parseAmount(a[2]));
+                lib.addPatron(patron);
+                break;
+            }
+            case CommandType::checkout:
+                lib.checkOutBook(a[0], parseNumber(a[1], "借书证号"),
+                                 a.size() == 3 ? parseDate(a[2]) : Date());
+                break;
+            case CommandType::checkin: {
+                LoanRequest r = parseReturn(a);
+                std::optional<Patron> filled;
+                Book returned = lib.returnBook(r.isbn, r.cardNumber, r.date,
+                                               [&](const Book&, const Patron& p) { filled.emplace(p); });
+                out.book(returned);
+                if (filled) out.holdFilled(returned, *filled);
+                break;
+            }
+            case CommandType::setFees:
+                lib.setPatronFees(parseNumber(a[0], "借书证号"), parseAmount(a[1]));
+                break;
+            case CommandType::findBook:
+                if (!lib.withBook(a[0], [&](const Book& b) { out.book(b); })) {
+                    throw std::runtime_error("未找到该ISBN的书籍");
+                }
+                break;
+            case CommandType::findPatron:
+                if (!lib.withPatron(parseNumber(a[0], "借书证号"), [&](const Patron& p) { out.patron(p); })) {
+                    throw std::runtime_error("读者未注册");
+                }
+                break;
+            case CommandType::listBooks:
+                listPaged(a, out, [&](std::size_t from, std::size_t limit) {
+                    return lib.forEachBook(from, limit, [&](const Book& b) { out.book(b); });
+                });
+                break;
+            case CommandType::listPatrons:
+                listPaged(a, out, [&](std::size_t from, std::size_t limit) {
+                    return lib.forEachPatron(from, limit, [&](const Patron& p) { out.patron(p); });
+                });
+                break;
+            case CommandType::listTransactions:
+                listPaged(a, out, [&](std::size_t from, std::size_t limit) {
+                    return lib.forEachTransaction(from, limit,
+                        [&](const Transaction& t, const Book& b, const Patron& p) { out.transaction(t, b, p); });
+                });
+                break;
+            case CommandType::listDebtors:
+                listDebtors(a, out);
+                break;
+            case CommandType::search: {
+                SearchMode mode = SearchMode::contains;
+                if (a.size() == 2) {
+                    if (a[1] != "prefix") throw std::invalid_argument("检索方式只能为prefix");
+                    mode = SearchMode::prefix;
+                }
+                lib.searchBooks(a[0], mode, kSearchLimit, [&](const Book& b, int) { out.book(b); });
+                break;
+            }
+            case CommandType::listLoans: {
+                bool found = lib.forEachLoan(parseNumber(a[0], "借书证号"),
+                    [&](const Transaction& t, const Book& b, const Patron& p) { out.transaction(t, b, p); });
+                if (!found) throw std::runtime_error("读者未注册");
+                break;
+            }
+            case CommandType::accrueFines:
+                out.fineRun(lib.accrueOverdueFines(a.empty() ? Date() : parseDate(a[0])));
+                break;
+            case CommandType::removeBook:
+                lib.removeBook(a[0]);
+                break;
+            case CommandType::removePatron:
+                lib.removePatron(parseNumber(a[0], "借书证号"));
+                break;
+            case CommandType::exportReport:
+                exportReport(a, out);
+                break;
+            case CommandType::showMetrics:
+                metricsCommand(a, out);
+                break;
+            case CommandType::addCopies:
+                lib.addCopies(a[0], parseCopies(a[1]));
+                break;
+            case CommandType::showHoldings:
+                for (std::size_t g = 0; g < kGenreCount; ++g) {
+                    out.holdings(static_cast<Genre>(g), lib.getHoldings(static_cast<Genre>(g)));
+                }
+                break;
+            case CommandType::queryBooks:
+                queryBooks(a, out);
+                break;
+            case CommandType::topCirculation:
+                topCirculation(a, out);
+                break;
+            case CommandType::trending: {
+                RankingArgs r = parseRanking(a, false);
+                lib.forEachTrendingTitle(r.date, r.limit,
+                                         [&](const Book& b, const TrendingTitle& t) { out.trendingBook(b, t); });
+                break;
+            }
+            case CommandType::queryHistory:
+                queryHistory(a, out);
+                break;
+            case CommandType::listSegments:
+                if (!a.empty()) {
+                    if (a[0] != "seal") throw std::invalid_argument("只能为seal");
+                    lib.sealHistory();
+                }
+                lib.forEachHistorySegment([&](const HistorySegmentInfo& info) { out.historySegment(info); });
+                break;
+            case CommandType::compactHistory:
+                for (const HistorySegmentInfo& info : lib.compactHistory(parseDate(a[0]))) out.historySegment(info);
+                break;
+            case CommandType::placeHold:
+                placeHold(a, out);
+                break;
+            case CommandType::cancelHold:
+                lib.cancelHold(a[0], parseNumber(a[1], "借书证号"));
+                break;
+            case CommandType::listHolds: {
+                bool found = lib.forEachHold(parseNumber(a[0], "借书证号"),
+                                             [&](const HoldInfo& h, const Book& b) { out.hold(h, b); });
+                if (!found) throw std::runtime_error("读者未注册");
+                break;
+            }
+        }
+    }
+
+    // 借还批处理的缓冲，跨批复用
+    std::vector<LoanRequest> loanRequests;
+    std::vector<std::size_t> loanOwners;
+    std::vector<LoanStatus> loanResults;
+    std::vector<std::string> loanErrors;
+    std::vector<std::optional<Book>> loanReturned;
+    std::vector<std::optional<Patron>> loanFilled;
+    std::vector<std::uint64_t> loanNs;
+
+public:
+    explicit CommandEngine(Library& library) : lib(library) {}
+
+    // 单批合并执行的借还命令上限
+    static constexpr std::size_t kLoanBatchSize = 256;
+
+    static bool isLoanCommand(CommandType type) {
+        return type == CommandType::checkout || type == CommandType::checkin;
+    }
+
+    // 把连续的借还命令合并为一批执行：只取一次共享锁、只等待一次日志落盘，
+    // 无书、有欠费等日常失败以结果码返回而不经过异常。逐条输出结果，返回成功条数
+    // cmds中只能是checkout/checkin；每条命令逐条计时计入运行统计：自身的解析与处理耗时，
+    // 送入图书馆的请求再加上整批共同等待日志落盘的时间
+    std::size_t executeLoans(std::span<const Command> cmds, ResultWriter& out) {
+        Metrics& metrics = Metrics::global();
+        std::uint64_t start = metrics.start();
+        std::uint64_t mark = start;
+        // 自上一次计时以来的耗时(统计关闭时为0)
+        auto lap = [&] {
+            if (!start) return std::uint64_t(0);
+            std::uint64_t ns = Metrics::elapsedNs(mark);
+            mark += ns;
+            return ns;
+        };
+        loanRequests.clear();
+        loanOwners.clear();
+        loanErrors.assign(cmds.size(), std::string());
+        loanReturned.assign(cmds.size(), std::nullopt);
+        loanFilled.assign(cmds.size(), std::nullopt);
+        loanNs.assign(cmds.size(), 0);
+        for (std::size_t i = 0; i < cmds.size(); ++i) {
+            const auto& a = cmds[i].args;
+            try {
+                if (cmds[i].type == CommandType::checkout) {
+                    loanRequests.push_back(LoanRequest{LoanAction::checkout, a[0], parseNumber(a[1], "借书证号"),
+                                                       a.size() == 3 ? parseDate(a[2]) : Date()});
+                } else {
+                    loanRequests.push_back(parseReturn(a));
+                }
+                loanOwners.push_back(i);
+            } catch (const std::exception& e) {
+                loanErrors[i] = e.what();
+            }
+            loanNs[i] = lap();
+        }
+
+        try {
+            lib.processLoans(loanRequests, loanResults,
+                [this](std::size_t k, const Book& book) {
+                    if (loanRequests[k].action == LoanAction::checkin) loanReturned[loanOwners[k]].emplace(book);
+                },
+                [this](std::size_t k, const Book&, const Patron& patron) { loanFilled[loanOwners[k]].emplace(patron); },
+                [&](std::size_t k) { loanNs[loanOwners[k]] += lap(); });
+            for (std::size_t k = 0; k < loanResults.size(); ++k) {
+                if (loanResults[k] != LoanStatus::ok) loanErrors[loanOwners[k]] = loanStatusMessage(loanResults[k]);
+            }
+        } catch (const std::exception& e) {
+            // 日志写入失败：整批都不能确认已落盘，全部报告失败
+            for (std::size_t owner : loanOwners) {
+                loanErrors[owner] = e.what();
+                loanReturned[owner].reset();
+                loanFilled[owner].reset();
+            }
+        }
+
+        std::uint64_t logWait = lap();
+        for (std::size_t owner : loanOwners) loanNs[owner] += logWait;
+        std::size_t succeeded = 0;
+        for (std::size_t i = 0; i < cmds.size(); ++i) {
+            const std::string& error = loanErrors[i];
+            if (start) metrics.record(static_cast<std::size_t>(cmds[i].type), loanNs[i], error);
+            out.begin(cmds[i]);
+            if (loanReturned[i]) out.book(*loanReturned[i]);
+            if (loanFilled[i]) out.holdFilled(*loanReturned[i], *loanFilled[i]);
+            out.end(cmds[i], error.empty(), error);
+            if (error.empty()) ++succeeded;
+        }
+        return succeeded;
+    }
+
+    // 执行一条命令；业务错误不抛出，而是通过返回值与out.end报告
+    // 每条命令的耗时与成败按命令类型计入运行统计，失败按错误信息细分
+    bool execute(const Command& cmd, ResultWriter& out) {
+        out.begin(cmd);
+        std::string error;
+        Metrics& metrics = Metrics::global();
+        std::uint64_t start = metrics.start();
+        try {
+            dispatch(cmd, out);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        metrics.finish(static_cast<std::size_t>(cmd.type), start, error);
+        out.end(cmd, error.empty(), error);
+        return error.empty();
+    }
+};
+
+// 以JSON Lines格式输出结果：每条查询结果一行，每条命令结束一行
+// 内部先写入大缓冲再整块输出，避免逐字段的流操作开销
+class JsonLinesWriter : public ResultWriter {
+private:
+    std::ostream& os;
+    std::string buffer;
+    std::size_t line = 0;
+    static constexpr std::size_t kFlushBytes = 1 << 16;
+
+    void appendString(std::string_view s) { appendJsonString(buffer, s); }
+
+    void appendBook(const Book& b) {
+        buffer += "{\"isbn\":";
+        appendString(b.getISBN());
+        buffer += ",\"title\":";
+        appendString(b.getTitle());
+        buffer += ",\"author\":";
+        appendString(b.getAuthor());
+        buffer += ",\"year\":" + std::to_string(b.getCopyrightYear());
+        buffer += ",\"genre\":" + std::to_string(static_cast<int>(b.getGenre()) + 1);
+        buffer += b.getCheckoutStatus() ? ",\"checkedOut\":true" : ",\"checkedOut\":false";
+        buffer += ",\"copies\":" + std::to_string(b.getCopies());
+        buffer += ",\"available\":" + std::to_string(b.getAvailableCopies()) + "}";
+    }
+
+    void appendPatron(const Patron& p) {
+        buffer += "{\"name\":";
+        appendString(p.getName());
+        buffer += ",\"card\":" + std::to_string(p.getCardNumber());
+        buffer += ",\"fees\":" + formatCents(p.getFeeCents()) + "}";
+    }
+
+    void rowPrefix(const char* key) {
+        buffer += "{\"line\":" + std::to_string(line) + ",\"" + key + "\":";
+    }
+
+    void endRow() {
+        buffer += "}\n";
+        if (buffer.size() >= kFlushBytes) flush();
+    }
+
+public:
+    explicit JsonLinesWriter(std::ostream& out) : os(out) {}
+    ~JsonLinesWriter() override { flush(); }
+
+    void flush() {
+        os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+
+    // 输出无法解析的行
+    void malformed(std::size_t lineNo, const std::string& error) {
+        buffer += "{\"line\":" + std::to_string(lineNo) + ",\"ok\":false,\"error\":";
+        appendString(error);
+        endRow();
+    }
+
+    // 直接写入一行原始JSON(用于汇总等)
+    void raw(std::string_view json) {
+        buffer += json;
+        buffer += '\n';
+    }
+
+    void begin(const Command& cmd) override { line = cmd.line; }
+
+    void book(const Book& b) override {
+        rowPrefix("book");
+        appendBook(b);
+        endRow();
+    }
+
+    void patron(const Patron& p) override {
+        rowPrefix("patron");
+        appendPatron(p);
+        endRow();
+    }
+
+    void transaction(const Transaction& t, const Book& b, const Patron& p) override {
+        rowPrefix("transaction");
+        buffer += "{\"isbn\":";
+        appendString(b.getISBN());
+        buffer += ",\"title\":";
+        appendString(b.getTitle());
+        buffer += ",\"card\":" + std::to_string(p.getCardNumber());
+        buffer += ",\"patron\":";
+        appendString(p.getName());
+        buffer += ",\"type\":\"";
+        buffer += t.type == TransactionType::checkin ? "checkin" : "checkout";
+        buffer += "\",\"date\":\"" + Date::unpack(t.date).toString() + "\"}";
+        endRow();
+    }
+
+    void debtor(const Patron& p, Cents amount) override {
+        rowPrefix("debtor");
+        buffer += "{\"name\":";
+        appendString(p.getName());
+        buffer += ",\"card\":" + std::to_string(p.getCardNumber());
+        buffer += ",\"fees\":" + formatCents(amount) + "}";
+        endRow();
+    }
+
+    void debtorSummary(std::size_t count, Cents total, const std::string& next) override {
+        rowPrefix("debtors");
+        buffer += "{\"count\":" + std::to_string(count) + ",\"total\":" + formatCents(total);
+        buffer += ",\"next\":";
+        if (next.empty()) buffer += "null";
+        else appendString(next);
+        buffer += "}";
+        endRow();
+    }
+
+    void pageEnd(const std::string& next) override {
+        rowPrefix("page");
+        buffer += "{\"next\":";
+        if (next.empty()) buffer += "null";
+        else buffer += next;
+        buffer += "}";
+        endRow();
+    }
+
+    void exported(const ExportSummary& r, const std::string& path) override {
+        rowPrefix("export");
+        buffer += "{\"path\":";
+        appendString(path);
+        buffer += ",\"rows\":" + std::to_string(r.rows);
+        buffer += ",\"bytes\":" + std::to_string(r.bytes);
+        buffer += ",\"seconds\":" + std::to_string(r.seconds) + "}";
+        endRow();
+    }
+
+    void metrics(const Metrics::Snapshot& snapshot) override {
+        rowPrefix("metrics");
+        appendMetricsJson(buffer, snapshot);
+        endRow();
+    }
+
+    void holdings(Genre genre, const GenreHoldings& h) override {
+        rowPrefix("holdings");
+        buffer += "{\"genre\":" + std::to_string(static_cast<int>(genre) + 1);
+        buffer += ",\"name\":";
+        appendString(genreName(genre));
+        buffer += ",\"titles\":" + std::to_string(h.titles);
+        buffer += ",\"copies\":" + std::to_string(h.copies);
+        buffer += ",\"onLoan\":" + std::to_string(h.onLoan);
+        buffer += ",\"available\":" + std::to_string(h.available()) + "}";
+        endRow();
+    }
+
+    void matchCount(std::size_t n) override {
+        rowPrefix("matched");
+        buffer += std::to_string(n);
+        endRow();
+    }
+
+    void rankedBook(const Book& b, std::uint64_t count) override {
+        rowPrefix("top");
+        buffer += "{\"book\":";
+        appendBook(b);
+        buffer += ",\"checkouts\":" + std::to_string(count) + "}";
+        endRow();
+    }
+
+    void rankedAuthor(std::string_view author, std::uint64_t count) override {
+        rowPrefix("top");
+        buffer += "{\"author\":";
+        appendString(author);
+        buffer += ",\"checkouts\":" + std::to_string(count) + "}";
+        endRow();
+    }
+
+    void genreCirculation(Genre genre, std::uint64_t checkouts, std::uint64_t returns) override {
+        rowPrefix("top");
+        buffer += "{\"genre\":" + std::to_string(static_cast<int>(genre) + 1);
+        buffer += ",\"name\":";
+        appendString(genreName(genre));
+        buffer += ",\"checkouts\":" + std::to_string(checkouts);
+        buffer += ",\"returns\":" + std::to_string(returns) + "}";
+        endRow();
+    }
+
+    void trendingBook(const Book& b, const TrendingTitle& t) override {
+        rowPrefix("trending");
+        buffer += "{\"book\":";
+        appendBook(b);
+        buffer += ",\"recent\":" + std::to_string(t.recent);
+        buffer += ",\"baseline\":" + std::to_string(t.baseline);
+        buffer += ",\"lift\":" + std::to_string(t.lift) + "}";
+        endRow();
+    }
+
+    void hold(const HoldInfo& h, const Book& b) override {
+        rowPrefix("hold");
+        buffer += "{\"isbn\":";
+        appendString(b.getISBN());
+        buffer += ",\"title\":";
+        appendString(b.getTitle());
+        buffer += ",\"date\":\"" + Date::unpack(h.date).toString() + "\"";
+        buffer += ",\"priority\":" + std::to_string(h.priority);
+        buffer += ",\"suspended\":";
+        buffer += h.suspended ? "true" : "false";
+        buffer += ",\"queued\":" + std::to_string(h.queued) + "}";
+        endRow();
+    }
+
+    void holdFilled(const Book& b, const Patron& p) override {
+        rowPrefix("assigned");
+        buffer += "{\"isbn\":";
+        appendString(b.getISBN());
+        buffer += ",\"title\":";
+        appendString(b.getTitle());
+        buffer += ",\"card\":" + std::to_string(p.getCardNumber());
+        buffer += ",\"patron\":";
+        appendString(p.getName());
+        buffer += "}";
+        endRow();
+    }
+
+    void historySegment(const HistorySegmentInfo& h) override {
+        rowPrefix("segment");
+        char month[16];
+        std::snprintf(month, sizeof(month), "%04d-%02d", h.year(), h.monthOfYear());
+        buffer += "{\"month\":\"";
+        buffer += month;
+        buffer += "\",\"state\":\"";
+        buffer += segmentStateName(h.state);
+        buffer += "\",\"first\":" + std::to_string(h.first);
+        buffer += ",\"end\":" + std::to_string(h.end);
+        buffer += ",\"records\":" + std::to_string(h.stats.records);
+        buffer += ",\"checkouts\":" + std::to_string(h.stats.checkouts);
+        buffer += ",\"returns\":" + std::to_string(h.stats.returns);
+        // 原始存储的分段不统计涉及的书籍/读者数
+        if (h.state == SegmentState::sealed || h.state == SegmentState::compacted) {
+            buffer += ",\"books\":" + std::to_string(h.stats.distinctBooks);
+            buffer += ",\"patrons\":" + std::to_string(h.stats.distinctPatrons);
+        }
+        if (h.stats.records > 0) {
+            buffer += ",\"from\":\"" + Date::fromDays(h.stats.minDay).toString();
+            buffer += "\",\"to\":\"" + Date::fromDays(h.stats.maxDay).toString() + "\"";
+        }
+        buffer += ",\"encodedBytes\":" + std::to_string(h.encodedBytes);
+        buffer += ",\"rawBytes\":" + std::to_string(h.rawBytes);
+        buffer += ",\"spilled\":";
+        buffer += h.spilled ? "true" : "false";
+        buffer += ",\"retained\":" + std::to_string(h.retained) + "}";
+        endRow();
+    }
+
+    void fineRun(const FineRunSummary& r) override {
+        rowPrefix("fines");
+        buffer += "{\"asOf\":\"" + r.asOf.toString() + "\"";
+        buffer += ",\"openLoans\":" + std::to_string(r.openLoans);
+        buffer += ",\"overdueLoans\":" + std::to_string(r.overdueLoans);
+        buffer += ",\"finedLoans\":" + std::to_string(r.finedLoans);
+        buffer += ",\"patronsCharged\":" + std::to_string(r.patronsCharged);
+        buffer += ",\"posted\":" + formatCents(r.posted);
+        buffer += ",\"threads\":" + std::to_string(r.threads);
+        buffer += ",\"seconds\":" + std::to_string(r.seconds) + "}";
+        endRow();
+    }
+
+    void end(const Command& cmd, bool ok, const std::string& error) override {
+        buffer += "{\"line\":" + std::to_string(cmd.line) + ",\"cmd\":\"";
+        buffer += commandName(cmd.type);
+        buffer += ok ? "\",\"ok\":true" : "\",\"ok\":false,\"error\":";
+        if (!ok) appendString(error);
+        endRow();
+    }
+};
+
+// 批处理统计
+struct BatchSummary {
+    std::size_t commands = 0;       // 执行的命令数
+    std::size_t succeeded = 0;      // 成功数
+    std::size_t failed = 0;         // 执行失败数
+    std::size_t malformed = 0;      // 无法解析的行数
+    std::array<std::size_t, kCommandTypeCount> perType{};  // 各类命令数
+    double seconds = 0;             // 执行耗时
+
+    double opsPerSecond() const { return seconds > 0 ? commands / seconds : 0; }
+};
+
+// 读取命令流并全速执行，结果以JSON Lines写入out，最后一行为吞吐汇总
+inline BatchSummary runCommandBatch(Library& lib, std::istream& in, std::ostream& out) {
+    CommandEngine engine(lib);
+    JsonLinesWriter writer(out);
+    BatchSummary summary;
+    std::string text, error;
+    Command cmd;
+    std::size_t lineNo = 0;
+
+    // 连续的借还命令先攒起来，遇到其他命令、格式错误的行或攒满一批时合并执行
+    std::vector<Command> loans;
+    auto flushLoans = [&] {
+        if (loans.empty()) return;
+        std::size_t ok = engine.executeLoans(loans, writer);
+        summary.succeeded += ok;
+        summary.failed += loans.size() - ok;
+        loans.clear();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    while (std::getline(in, text)) {
+        ++lineNo;
+        if (!parseCommand(text, cmd, error)) {
+            if (!error.empty()) {
+                flushLoans();
+                ++summary.malformed;
+                writer.malformed(lineNo, error);
+            }
+            continue;
+        }
+        cmd.line = lineNo;
+        ++summary.commands;
+        ++summary.perType[static_cast<std::size_t>(cmd.type)];
+        if (CommandEngine::isLoanCommand(cmd.type)) {
+            loans.push_back(std::move(cmd));
+            if (loans.size() == CommandEngine::kLoanBatchSize) flushLoans();
+            continue;
+        }
+        flushLoans();
+        if (engine.execute(cmd, writer)) {
+            ++summary.succeeded;
+        } else {
+            ++summary.failed;
+        }
+    }
+    flushLoans();
+    summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string json = "{\"summary\":{\"commands\":" + std::to_string(summary.commands) +
+                       ",\"succeeded\":" + std::to_string(summary.succeeded) +
+                       ",\"failed\":" + std::to_string(summary.failed) +
+                       ",\"malformed\":" + std::to_string(summary.malformed) +
+                       ",\"seconds\":" + std::to_string(summary.seconds) +
+                       ",\"opsPerSec\":" + std::to_string(summary.opsPerSecond()) + ",\"perCommand\":{";
+    bool first = true;
+    for (std::size_t t = 0; t < kCommandTypeCount; ++t) {
+        if (summary.perType[t] == 0) continue;
+        if (!first) json += ',';
+        first = false;
+        json += '"';
+        json += kCommandSpecs[t].name;
+        json += "\":" + std::to_string(summary.perType[t]);
+    }
+    json += "}}}";
+    writer.raw(json);
+    writer.flush();
+    return summary;
+}
+
+#endif // LIBRARY_COMMANDS_H
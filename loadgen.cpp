@@ -0,0 +1,435 @@
+// 借还服务压力测试：模拟大量分馆终端同时连接homework1 --serve
+// 用法: loadgen --socket <套接字路径> [--desks <终端数>] [--seconds <秒数>] [--pipeline <每终端在途请求数>]
+//               [--threads <线程数>] [--books <书籍数>] [--setup] [--output <结果文件>]
+// 每个终端一个连接、一位读者(借书证号为kCardBase+终端编号)，在途请求保持pipeline条：
+// 约一成按ISBN查书，其余在借书与还书(还自己借到的书)之间随机选择
+// --setup先通过一个连接把书籍与终端读者导入服务(已存在的记录忽略)
+// 结束时按操作输出一行JSON：次数、失败数、吞吐与延迟分位数(从发出请求到收到响应)
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "circulation_protocol.h"
+
+#ifdef __linux__
+
+using Clock = std::chrono::steady_clock;
+
+// 终端读者借书证号的起点，避免与馆内已有读者冲突
+constexpr int kCardBase = 900000;
+
+enum LoadOp : std::size_t { opCheckout, opReturn, opLookup, kLoadOps };
+constexpr const char* kLoadOpNames[kLoadOps] = {"checkout", "return", "book"};
+
+struct LoadOptions {
+    std::string socketPath;
+    std::size_t desks = 1000;
+    double seconds = 10;
+    std::size_t pipeline = 4;
+    unsigned threads = 4;
+    std::size_t books = 10000;
+    bool setup = false;
+};
+
+static std::string makeIsbn(std::size_t i) {
+    return std::to_string(i) + "-" + std::to_string(i % 97) + "-" + std::to_string(i % 13) + "-X";
+}
+
+static std::uint64_t nowNs() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+}
+
+static int connectTo(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw std::invalid_argument("套接字路径过长: " + path);
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::string error = std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        throw std::runtime_error("无法连接 " + path + ": " + error);
+    }
+    return fd;
+}
+
+static void sendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("发送失败: ") + std::strerror(errno));
+        }
+        data.remove_prefix(static_cast<std::size_t>(n));
+    }
+}
+
+// 读满count条响应，返回其中失败的条数
+static std::size_t receiveResponses(int fd, std::string& in, std::size_t count) {
+    std::size_t failed = 0;
+    char chunk[64 * 1024];
+    while (count > 0) {
+        std::string_view payload;
+        std::size_t used = 0, frame;
+        while (count > 0 && takeFrame(std::string_view(in).substr(used), payload, frame)) {
+            if (!decodeResponse(payload).ok) ++failed;
+            used += frame;
+            --count;
+        }
+        in.erase(0, used);
+        if (count == 0) break;
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n <= 0) throw std::runtime_error("服务端关闭了连接");
+        in.append(chunk, static_cast<std::size_t>(n));
+    }
+    return failed;
+}
+
+// 导入书籍与终端读者：每次流水线发送一批再读回这一批的响应
+static void setupData(const LoadOptions& o) {
+    constexpr std::size_t kChunk = 1000;
+    int fd = connectTo(o.socketPath);
+    const char* genres[] = {"fiction", "nonfiction", "periodical", "biography", "children"};
+    BinaryWriter out;
+    std::string in;
+    std::size_t total = o.books + o.desks, sent = 0, failed = 0;
+    while (sent < total) {
+        out.clear();
+        std::size_t end = std::min(total, sent + kChunk);
+        for (std::size_t i = sent; i < end; ++i) {
+            if (i < o.books) {
+                encodeRequest(out, CommandType::addBook,
+                              {makeIsbn(i), "书名" + std::to_string(i), "作者" + std::to_string(i % 500),
+                               std::to_string(1900 + i % 120), genres[i % 5]});
+            } else {
+                std::size_t desk = i - o.books;
+                encodeRequest(out, CommandType::addPatron,
+                              {"终端" + std::to_string(desk), std::to_string(kCardBase + desk)});
+            }
+        }
+        sendAll(fd, out.data());
+        failed += receiveResponses(fd, in, end - sent);
+        sent = end;
+    }
+    ::close(fd);
+    std::cerr << "已导入 " << o.books << " 本书籍、" << o.desks << " 位终端读者(" << failed << " 条已存在或失败)\n";
+}
+
+// 一个模拟终端
+struct Desk {
+    int fd = -1;
+    int card = 0;
+    std::mt19937 rng;
+    std::vector<std::size_t> borrowed;      // 已借到、尚未发出归还的书籍编号
+    struct InFlight {
+        LoadOp op;
+        std::size_t book;
+        std::uint64_t sentNs;
+    };
+    std::deque<InFlight> inFlight;          // 响应按请求顺序返回
+    BinaryWriter out;
+    std::size_t sent = 0;
+    std::string in;
+};
+
+struct LoadResult {
+    std::array<OperationStats, kLoadOps> ops{};
+    std::size_t protocolErrors = 0;
+
+    void record(LoadOp op, std::uint64_t ns, bool ok) {
+        OperationStats& s = ops[op];
+        ++s.count;
+        if (!ok) ++s.failures;
+        s.totalNs += ns;
+        ++s.histogram[metrics_detail::bucketOf(ns)];
+    }
+
+    void merge(const LoadResult& other) {
+        for (std::size_t op = 0; op < kLoadOps; ++op) {
+            ops[op].count += other.ops[op].count;
+            ops[op].failures += other.ops[op].failures;
+            ops[op].totalNs += other.ops[op].totalNs;
+            for (std::size_t b = 0; b < metrics_detail::kBuckets; ++b) {
+                ops[op].histogram[b] += other.ops[op].histogram[b];
+            }
+        }
+        protocolErrors += other.protocolErrors;
+    }
+};
+
+// 一个线程驱动一组终端
+class DeskDriver {
+private:
+    const LoadOptions& opt;
+    std::vector<Desk> desks;
+    int epfd;
+    LoadResult result;
+
+    // 为终端选择并编码下一条请求
+    void enqueue(Desk& d) {
+        std::uint32_t roll = d.rng() % 100;
+        std::uint64_t t = nowNs();
+        if (roll < 10) {
+            std::size_t book = d.rng() % opt.books;
+            encodeRequest(d.out, CommandType::findBook, {makeIsbn(book)});
+            d.inFlight.push_back({opLookup, book, t});
+        } else if (!d.borrowed.empty() && (roll < 55 || d.borrowed.size() >= 5)) {
+            std::size_t book = d.borrowed.back();
+            d.borrowed.pop_back();
+            encodeRequest(d.out, CommandType::checkin, {makeIsbn(book), std::to_string(d.card)});
+            d.inFlight.push_back({opReturn, book, t});
+        } else {
+            std::size_t book = d.rng() % opt.books;
+            encodeRequest(d.out, CommandType::checkout, {makeIsbn(book), std::to_string(d.card)});
+            d.inFlight.push_back({opCheckout, book, t});
+        }
+    }
+
+    void watch(Desk& d, bool writable) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | (writable ? EPOLLOUT : 0u);
+        ev.data.ptr = &d;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, d.fd, &ev);
+    }
+
+    // 写出终端积攒的请求，写不完时等待可写；返回false表示连接已断开
+    bool flush(Desk& d) {
+        const std::string& data = d.out.data();
+        while (d.sent < data.size()) {
+            ssize_t n = ::send(d.fd, data.data() + d.sent, data.size() - d.sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0) {
+                d.sent += static_cast<std::size_t>(n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && errno == EAGAIN) {
+                watch(d, true);
+                return true;
+            } else {
+                return false;
+            }
+        }
+        d.out.clear();
+        d.sent = 0;
+        return true;
+    }
+
+    void disconnect(Desk& d) {
+        ++result.protocolErrors;
+        epoll_ctl(epfd, EPOLL_CTL_DEL, d.fd, nullptr);
+        ::close(d.fd);
+        d.fd = -1;
+    }
+
+    // 处理收到的响应，每收到一条补发一条；返回false表示连接已断开
+    bool receive(Desk& d, bool sending) {
+        char chunk[16 * 1024];
+        ssize_t n = ::recv(d.fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+        if (n < 0) return errno == EAGAIN || errno == EINTR;
+        if (n == 0) return false;
+        d.in.append(chunk, static_cast<std::size_t>(n));
+
+        std::uint64_t t = nowNs();
+        std::string_view payload;
+        std::size_t used = 0, frame;
+        while (!d.inFlight.empty() && takeFrame(std::string_view(d.in).substr(used), payload, frame)) {
+            used += frame;
+            Desk::InFlight req = d.inFlight.front();
+            d.inFlight.pop_front();
+            bool ok = decodeResponse(payload).ok;
+            result.record(req.op, t - req.sentNs, ok);
+            if (ok && req.op == opCheckout) d.borrowed.push_back(req.book);
+            if (sending) enqueue(d);
+        }
+        d.in.erase(0, used);
+        return true;
+    }
+
+public:
+    DeskDriver(const LoadOptions& o, std::size_t first, std::size_t count) : opt(o), desks(count) {
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+        for (std::size_t i = 0; i < count; ++i) {
+            Desk& d = desks[i];
+            d.fd = connectTo(o.socketPath);
+            d.card = kCardBase + static_cast<int>(first + i);
+            d.rng.seed(static_cast<std::uint32_t>(first + i) * 2654435761u + 1);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.ptr = &d;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, d.fd, &ev);
+        }
+    }
+
+    ~DeskDriver() {
+        for (Desk& d : desks) {
+            if (d.fd >= 0) ::close(d.fd);
+        }
+        ::close(epfd);
+    }
+
+    // 运行到截止时间，之后不再发新请求，等待在途请求返回(最多等grace)
+    void run(Clock::time_point deadline, std::chrono::seconds grace) {
+        std::size_t open = desks.size();
+        for (Desk& d : desks) {
+            for (std::size_t k = 0; k < opt.pipeline; ++k) enqueue(d);
+            if (!flush(d)) {
+                disconnect(d);
+                --open;
+            }
+        }
+        std::vector<epoll_event> events(256);
+        auto drainUntil = deadline + grace;
+        while (open > 0) {
+            auto now = Clock::now();
+            bool sending = now < deadline;
+            if (!sending) {
+                bool idle = std::all_of(desks.begin(), desks.end(),
+                                        [](const Desk& d) { return d.fd < 0 || d.inFlight.empty(); });
+                if (idle || now >= drainUntil) break;
+            }
+            int n = epoll_wait(epfd, events.data(), static_cast<int>(events.size()), 100);
+            for (int i = 0; i < n; ++i) {
+                Desk& d = *static_cast<Desk*>(events[i].data.ptr);
+                if (d.fd < 0) continue;
+                if (events[i].events & EPOLLOUT) watch(d, false);
+                bool alive = !(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) || receive(d, sending);
+                if (!alive || !flush(d)) {
+                    disconnect(d);
+                    --open;
+                }
+            }
+        }
+    }
+
+    const LoadResult& outcome() const { return result; }
+};
+
+static void report(std::ostream& os, const LoadOptions& o, const LoadResult& r, double seconds) {
+    std::uint64_t total = 0;
+    for (std::size_t op = 0; op < kLoadOps; ++op) {
+        const OperationStats& s = r.ops[op];
+        total += s.count;
+        os << "{\"desks\":" << o.desks << ",\"pipeline\":" << o.pipeline
+           << ",\"op\":\"" << kLoadOpNames[op] << "\""
+           << ",\"ops\":" << s.count
+           << ",\"failures\":" << s.failures
+           << ",\"opsPerSec\":" << (seconds > 0 ? s.count / seconds : 0)
+           << ",\"p50Ns\":" << s.percentileNs(0.50)
+           << ",\"p90Ns\":" << s.percentileNs(0.90)
+           << ",\"p99Ns\":" << s.percentileNs(0.99)
+           << ",\"maxNs\":" << s.maxNs() << "}\n";
+    }
+    os << "{\"desks\":" << o.desks << ",\"pipeline\":" << o.pipeline
+       << ",\"op\":\"total\",\"ops\":" << total
+       << ",\"seconds\":" << seconds
+       << ",\"opsPerSec\":" << (seconds > 0 ? total / seconds : 0)
+       << ",\"disconnected\":" << r.protocolErrors << "}\n";
+}
+
+int main(int argc, char* argv[]) {
+    LoadOptions o;
+    std::string output;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--socket" && i + 1 < argc) {
+                o.socketPath = argv[++i];
+            } else if (arg == "--desks" && i + 1 < argc) {
+                o.desks = std::stoull(argv[++i]);
+            } else if (arg == "--seconds" && i + 1 < argc) {
+                o.seconds = std::stod(argv[++i]);
+            } else if (arg == "--pipeline" && i + 1 < argc) {
+                o.pipeline = std::max<std::size_t>(1, std::stoull(argv[++i]));
+            } else if (arg == "--threads" && i + 1 < argc) {
+                o.threads = std::max(1u, static_cast<unsigned>(std::stoul(argv[++i])));
+            } else if (arg == "--books" && i + 1 < argc) {
+                o.books = std::max<std::size_t>(1, std::stoull(argv[++i]));
+            } else if (arg == "--setup") {
+                o.setup = true;
+            } else if (arg == "--output" && i + 1 < argc) {
+                output = argv[++i];
+            } else {
+                throw std::invalid_argument(arg);
+            }
+        }
+    } catch (const std::exception&) {
+        o.socketPath.clear();
+    }
+    if (o.socketPath.empty()) {
+        std::cerr << "用法: " << argv[0] << " --socket <套接字路径> [--desks <终端数>] [--seconds <秒数>]"
+                  << " [--pipeline <每终端在途请求数>] [--threads <线程数>] [--books <书籍数>] [--setup]"
+                  << " [--output <结果文件>]\n";
+        return 2;
+    }
+
+    try {
+        // 每个终端一个连接，把打开文件数的软上限提到硬上限
+        rlimit files;
+        if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+            files.rlim_cur = files.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &files);
+        }
+
+        if (o.setup) setupData(o);
+
+        std::ofstream file;
+        if (!output.empty()) {
+            file.open(output);
+            if (!file) throw std::runtime_error("无法写入结果文件: " + output);
+        }
+        std::ostream& os = output.empty() ? std::cout : file;
+
+        o.threads = static_cast<unsigned>(std::min<std::size_t>(o.threads, std::max<std::size_t>(1, o.desks)));
+        std::vector<std::unique_ptr<DeskDriver>> drivers;
+        for (unsigned t = 0; t < o.threads; ++t) {
+            std::size_t first = o.desks * t / o.threads;
+            std::size_t last = o.desks * (t + 1) / o.threads;
+            drivers.push_back(std::make_unique<DeskDriver>(o, first, last - first));
+        }
+
+        auto start = Clock::now();
+        auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(o.seconds));
+        std::vector<std::thread> threads;
+        for (auto& d : drivers) {
+            threads.emplace_back([&d, deadline] { d->run(deadline, std::chrono::seconds(5)); });
+        }
+        for (auto& t : threads) t.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        LoadResult total;
+        for (auto& d : drivers) total.merge(d->outcome());
+        report(os, o, total, seconds);
+        return total.protocolErrors == 0 ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "压力测试失败: " << e.what() << "\n";
+        return 2;
+    }
+}
+
+#else
+
+int main() {
+    std::cerr << "借还服务压力测试仅支持Linux\n";
+    return 2;
+}
+
+#endif
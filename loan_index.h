@@ -0,0 +1,188 @@
+#ifndef LOAN_INDEX_H
+#define LOAN_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "slot_map.h"
+#include "transaction_log.h"
+
+// 借阅槽编号
+using LoanId = std::uint32_t;
+
+// 在借索引：每笔在借借阅占一个借阅槽(指向借出事件)，同一读者、同一书籍的在借借阅各串成一条双向链表
+// 一种书可以有多个副本同时借出；借阅槽总数不少于全部副本数，借出时从空闲栈取一个槽，归还时放回
+// 书籍/读者表项按句柄的槽位号存放，借阅中保存完整句柄
+// 借出/归还都是O(1)，查询读者在借书籍只遍历该读者自己的链表，查找某书的借阅只遍历该书借出的副本
+//
+// 并发(由Library保证)：
+//   - 容量调整(addBook/addPatron/增加副本)在独占锁下进行
+//   - open/close须同时持有该书与该读者的分片锁；读者链表指针只在读者锁下修改，书籍链表指针只在书籍锁下修改，
+//     因此持有读者分片锁即可安全遍历其在借链表，持有书籍分片锁即可遍历该书的在借副本
+//   - 空闲借阅槽栈由内部互斥锁保护，总在分片锁之内获取
+class LoanIndex {
+public:
+    static constexpr LoanId kNoLoan = 0xFFFFFFFFu;
+
+private:
+    // 每笔借阅一项；transaction为借出事件在TransactionLog中的序号
+    // 借出日期与书籍类型冗余保存一份，逾期结算只需顺序扫描本表
+    struct OpenLoan {
+        std::uint32_t transaction = 0;
+        BookId book = kInvalidHandle;
+        PatronId patron = kInvalidHandle;
+        LoanId prev = kNoLoan;          // 同一读者链表中的前一笔
+        LoanId next = kNoLoan;          // 同一读者链表中的后一笔
+        LoanId bookPrev = kNoLoan;      // 同一书籍链表中的前一笔
+        LoanId bookNext = kNoLoan;      // 同一书籍链表中的后一笔
+        std::uint32_t date = 0;         // 借出日期(天数)
+        std::int64_t fined = 0;         // 已计入读者欠费的逾期罚款(分)
+        std::uint8_t genre = 0;         // 书籍类型
+        bool open = false;
+    };
+
+    // 每位读者/每种书一项
+    struct LoanList {
+        LoanId head = kNoLoan;
+        std::uint32_t count = 0;
+    };
+
+    std::vector<OpenLoan> loans;
+    std::vector<LoanList> books;
+    std::vector<LoanList> patrons;
+    std::vector<LoanId> freeLoans;      // 空闲借阅槽
+    std::mutex freeMutex;
+
+public:
+    // 随馆藏/读者/副本增长调整容量；借阅槽只增不减
+    void resizeBooks(std::size_t n) { books.resize(n); }
+    void resizePatrons(std::size_t n) { patrons.resize(n); }
+    void reserveBooks(std::size_t n) { books.reserve(n); }
+    void reservePatrons(std::size_t n) { patrons.reserve(n); }
+    void resizeLoans(std::size_t n) {
+        for (std::size_t i = loans.size(); i < n; ++i) freeLoans.push_back(static_cast<LoanId>(i));
+        if (n > loans.size()) loans.resize(n);
+    }
+
+    // 登记借阅：书籍book由读者patron于date借出，对应借出事件序号为transaction，返回借阅槽
+    // 调用方保证该书仍有可借副本(因而有空闲借阅槽)
+    LoanId open(BookId book, PatronId patron, std::size_t transaction, std::uint32_t date,
+                std::uint8_t genre) {
+        LoanId id;
+        {
+            std::lock_guard<std::mutex> lock(freeMutex);
+            id = freeLoans.back();
+            freeLoans.pop_back();
+        }
+        OpenLoan& loan = loans[id];
+        LoanList& byPatron = patrons[slotIndex(patron)];
+        LoanList& byBook = books[slotIndex(book)];
+        loan.transaction = static_cast<std::uint32_t>(transaction);
+        loan.book = book;
+        loan.patron = patron;
+        loan.prev = kNoLoan;
+        loan.next = byPatron.head;
+        loan.bookPrev = kNoLoan;
+        loan.bookNext = byBook.head;
+        loan.date = date;
+        loan.fined = 0;
+        loan.genre = genre;
+        loan.open = true;
+        if (byPatron.head != kNoLoan) loans[byPatron.head].prev = id;
+        byPatron.head = id;
+        ++byPatron.count;
+        if (byBook.head != kNoLoan) loans[byBook.head].bookPrev = id;
+        byBook.head = id;
+        ++byBook.count;
+        return id;
+    }
+
+    // 结束借阅，从读者与书籍链表中摘除并交还借阅槽
+    void close(LoanId id) {
+        OpenLoan& loan = loans[id];
+        LoanList& byPatron = patrons[slotIndex(loan.patron)];
+        LoanList& byBook = books[slotIndex(loan.book)];
+        if (loan.prev != kNoLoan) loans[loan.prev].next = loan.next;
+        else byPatron.head = loan.next;
+        if (loan.next != kNoLoan) loans[loan.next].prev = loan.prev;
+        if (loan.bookPrev != kNoLoan) loans[loan.bookPrev].bookNext = loan.bookNext;
+        else byBook.head = loan.bookNext;
+        if (loan.bookNext != kNoLoan) loans[loan.bookNext].bookPrev = loan.bookPrev;
+        loan.prev = loan.next = loan.bookPrev = loan.bookNext = kNoLoan;
+        loan.fined = 0;
+        loan.open = false;
+        --byPatron.count;
+        --byBook.count;
+        std::lock_guard<std::mutex> lock(freeMutex);
+        freeLoans.push_back(id);
+    }
+
+    // 该借阅槽是否在借
+    bool isOpen(LoanId id) const { return loans[id].open; }
+    // 借阅的书籍与读者(仅在借时有意义)
+    BookId book(LoanId id) const { return loans[id].book; }
+    PatronId borrower(LoanId id) const { return loans[id].patron; }
+    // 借出事件序号(仅在借时有意义)
+    std::size_t checkoutTransaction(LoanId id) const { return loans[id].transaction; }
+
+    // 借出日期(天数，仅在借时有意义)
+    std::uint32_t checkoutDate(LoanId id) const { return loans[id].date; }
+    // 书籍类型
+    std::uint8_t genre(LoanId id) const { return loans[id].genre; }
+    // 已计入的逾期罚款
+    std::int64_t finedAmount(LoanId id) const { return loans[id].fined; }
+    void setFinedAmount(LoanId id, std::int64_t cents) { loans[id].fined = cents; }
+
+    // 借阅槽总数
+    std::size_t loanCapacity() const { return loans.size(); }
+
+    // 该书借出的副本数
+    std::size_t bookLoanCount(BookId book) const { return books[slotIndex(book)].count; }
+
+    // 读者patron借阅该书的一笔借阅(最近借出的)，没有时返回kNoLoan
+    LoanId findLoan(BookId book, PatronId patron) const {
+        for (LoanId id = books[slotIndex(book)].head; id != kNoLoan; id = loans[id].bookNext) {
+            if (loans[id].patron == patron) return id;
+        }
+        return kNoLoan;
+    }
+
+    // 该书最早借出的一笔借阅，没有时返回kNoLoan
+    LoanId oldestLoan(BookId book) const {
+        LoanId id = books[slotIndex(book)].head;
+        if (id == kNoLoan) return kNoLoan;
+        while (loans[id].bookNext != kNoLoan) id = loans[id].bookNext;
+        return id;
+    }
+
+    // 该书最近借出的一笔借阅，没有时返回kNoLoan
+    LoanId newestLoan(BookId book) const { return books[slotIndex(book)].head; }
+
+    // 书籍被删除时清空其表项(调用方保证没有借出的副本)
+    void resetBook(BookId book) { books[slotIndex(book)] = LoanList(); }
+    // 读者被删除时清空其表项(调用方保证没有在借书籍)
+    void resetPatron(PatronId patron) { patrons[slotIndex(patron)] = LoanList(); }
+
+    // 读者在借数量
+    std::size_t loanCount(PatronId patron) const { return patrons[slotIndex(patron)].count; }
+
+    // 遍历读者的在借书籍，回调f(书籍句柄, 借出事件序号)，最近借出的在前
+    template <typename F>
+    void forEachLoan(PatronId patron, F&& f) const {
+        for (LoanId id = patrons[slotIndex(patron)].head; id != kNoLoan; id = loans[id].next) {
+            f(loans[id].book, static_cast<std::size_t>(loans[id].transaction));
+        }
+    }
+
+    // 清空
+    void clear() {
+        loans.clear();
+        books.clear();
+        patrons.clear();
+        freeLoans.clear();
+    }
+};
+
+#endif // LOAN_INDEX_H
@@ -0,0 +1,55 @@
+#ifndef LOAN_REQUESTS_H
+#define LOAN_REQUESTS_H
+
+#include <cstdint>
+#include <string_view>
+
+#include "date.h"
+
+// 批量借还：请求与逐条结果码
+// 无书、读者未注册、有欠费、已借出等都是服务台的日常结果，批量接口以结果码返回而不抛异常；
+// 抛异常的checkOutBook/returnBook只是在结果码之上的一层包装
+
+// 借还动作
+enum class LoanAction : std::uint8_t {
+    checkout,
+    checkin
+};
+
+// 单条借还请求；isbn须在处理期间保持有效
+// 归还时cardNumber为0表示不指定读者，该书只有一个副本在借时即归还这一本，多个副本在借时须指定读者
+struct LoanRequest {
+    LoanAction action = LoanAction::checkout;
+    std::string_view isbn;
+    int cardNumber = 0;
+    Date date = Date::fromDays(0);
+};
+
+// 单条请求的结果
+enum class LoanStatus : std::uint8_t {
+    ok,
+    unknownBook,        // 馆藏中没有这本书
+    unknownPatron,      // 读者未注册
+    feesOwed,           // 读者有欠费，不能借书
+    alreadyCheckedOut,  // 书籍已被借出(没有可借副本)
+    notCheckedOut,      // 书籍没有被借出(或没有借给指定读者)，无法归还
+    ambiguousReturn,    // 该书有多个副本在借，归还时须指定读者
+    reservedForHolds    // 可借副本已留给排在前面的预约读者
+};
+
+// 结果码对应的提示信息
+inline const char* loanStatusMessage(LoanStatus status) {
+    switch (status) {
+        case LoanStatus::ok: return "成功";
+        case LoanStatus::unknownBook: return "图书馆中没有这本书";
+        case LoanStatus::unknownPatron: return "读者未注册";
+        case LoanStatus::feesOwed: return "读者有欠费，不能借书";
+        case LoanStatus::alreadyCheckedOut: return "书籍已被借出";
+        case LoanStatus::notCheckedOut: return "这本书没有被借出";
+        case LoanStatus::ambiguousReturn: return "这本书有多个副本在借，请指定借书证号";
+        case LoanStatus::reservedForHolds: return "可借副本已留给预约读者";
+    }
+    return "未知结果";
+}
+
+#endif // LOAN_REQUESTS_H
@@ -0,0 +1,89 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 只读内存映射文件
+// 打开失败时抛出std::runtime_error；空文件映射为空视图
+class MappedFile {
+private:
+    const char* data = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("无法打开文件: " + path);
+        }
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        length = static_cast<std::size_t>(size.QuadPart);
+        if (length > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping == nullptr) {
+                CloseHandle(file);
+                throw std::runtime_error("无法映射文件: " + path);
+            }
+            data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("无法打开文件: " + path);
+        }
+        struct stat st;
+        ::fstat(fd, &st);
+        length = static_cast<std::size_t>(st.st_size);
+        if (length > 0) {
+            void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("无法映射文件: " + path);
+            }
+            ::madvise(p, length, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(p);
+        }
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data) ::munmap(const_cast<char*>(data), length);
+        if (fd >= 0) ::close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // 获取文件内容视图(在对象销毁前有效)
+    std::string_view view() const { return std::string_view(data, length); }
+    std::size_t size() const { return length; }
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,266 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 运行统计：按操作记录次数、失败次数(按失败原因细分)与耗时分布
+//   - 每个线程写自己的计数块，记录时没有共享写、没有锁；查看时把所有线程的计数块相加
+//   - 耗时用对数-线性直方图：每个2的幂区间再等分为8格，相对误差约12.5%，从纳秒到分钟只需约300个桶
+//   - 统计关闭时记录前只读一个原子标志，不读时钟
+//   - 清零不改动各线程的计数，而是记下当前值作为基线，之后的快照减去基线
+
+// 耗时直方图的桶
+namespace metrics_detail {
+
+constexpr unsigned kSubBits = 3;                        // 每个2的幂区间分为2^3格
+constexpr unsigned kSubBuckets = 1u << kSubBits;
+constexpr unsigned kMaxExponent = 40;                   // 2^40纳秒(约18分钟)以上并入最后一桶
+constexpr std::size_t kBuckets = (kMaxExponent - kSubBits + 2) * kSubBuckets;
+
+// 耗时(纳秒)所在的桶
+constexpr std::size_t bucketOf(std::uint64_t ns) {
+    if (ns < kSubBuckets) return static_cast<std::size_t>(ns);
+    unsigned e = static_cast<unsigned>(std::bit_width(ns)) - 1;
+    if (e > kMaxExponent) return kBuckets - 1;
+    return (e - kSubBits + 1) * kSubBuckets + ((ns >> (e - kSubBits)) & (kSubBuckets - 1));
+}
+
+// 桶的下界(含)
+constexpr std::uint64_t bucketLow(std::size_t bucket) {
+    if (bucket < kSubBuckets) return bucket;
+    unsigned e = static_cast<unsigned>(bucket / kSubBuckets) + kSubBits - 1;
+    return (kSubBuckets + bucket % kSubBuckets) << (e - kSubBits);
+}
+
+// 桶的上界(不含)
+constexpr std::uint64_t bucketHigh(std::size_t bucket) {
+    return bucket + 1 < kBuckets ? bucketLow(bucket + 1) : bucketLow(bucket) * 2;
+}
+
+static_assert(bucketOf(7) == 7 && bucketOf(8) == 8 && bucketOf(15) == 15 && bucketOf(16) == 16);
+static_assert(bucketLow(bucketOf(1000)) <= 1000 && 1000 < bucketHigh(bucketOf(1000)));
+static_assert(bucketOf(std::uint64_t(1) << 50) == kBuckets - 1);
+
+} // namespace metrics_detail
+
+// 单个操作的统计
+struct OperationStats {
+    std::uint64_t count = 0;        // 执行次数(含失败)
+    std::uint64_t failures = 0;     // 失败次数
+    std::uint64_t totalNs = 0;      // 总耗时
+    std::array<std::uint64_t, metrics_detail::kBuckets> histogram{};
+    std::vector<std::pair<std::string, std::uint64_t>> reasons;  // 失败原因及次数，按次数从高到低
+
+    double averageNs() const { return count ? static_cast<double>(totalNs) / count : 0; }
+
+    // 耗时分位数(p取0-1)，取所在桶的中点
+    std::uint64_t percentileNs(double p) const {
+        if (count == 0) return 0;
+        auto rank = static_cast<std::uint64_t>(p * (count - 1)) + 1;
+        std::uint64_t seen = 0;
+        for (std::size_t b = 0; b < histogram.size(); ++b) {
+            seen += histogram[b];
+            if (seen >= rank) return (metrics_detail::bucketLow(b) + metrics_detail::bucketHigh(b)) / 2;
+        }
+        return 0;
+    }
+
+    // 最大耗时所在桶的上界
+    std::uint64_t maxNs() const {
+        for (std::size_t b = histogram.size(); b-- > 0;) {
+            if (histogram[b]) return metrics_detail::bucketHigh(b) - 1;
+        }
+        return 0;
+    }
+};
+
+class Metrics {
+public:
+    static constexpr std::size_t kMaxOperations = 32;   // 操作编号须小于此值
+    static constexpr std::size_t kMaxReasons = 64;      // 超出的失败原因并入"其他"
+
+    using Snapshot = std::array<OperationStats, kMaxOperations>;
+
+private:
+    using Counter = std::atomic<std::uint64_t>;
+
+    // 每个线程一块；只有所属线程写入，查看时其他线程只读
+    struct ThreadBlock {
+        std::array<Counter, kMaxOperations> count{};
+        std::array<Counter, kMaxOperations> failures{};
+        std::array<Counter, kMaxOperations> totalNs{};
+        std::array<std::array<Counter, metrics_detail::kBuckets>, kMaxOperations> histogram{};
+        std::array<std::array<Counter, kMaxReasons>, kMaxOperations> reasons{};
+        std::atomic<bool> inUse{true};
+    };
+
+    // 线程退出时交还计数块，计数保留，块留给之后的新线程继续累加
+    struct Lease {
+        ThreadBlock* block = nullptr;
+        ~Lease() {
+            if (block) block->inUse.store(false, std::memory_order_release);
+        }
+    };
+
+    std::atomic<bool> on{true};
+
+    mutable std::mutex mutex;                               // 保护以下成员
+    std::vector<std::unique_ptr<ThreadBlock>> blocks;
+    std::vector<std::string> reasonNames;                   // 原因编号 -> 文本
+    std::map<std::string, std::size_t, std::less<>> reasonIds;
+    Snapshot baseline{};                                    // 上次清零时的累计值
+
+    Metrics() = default;
+
+    static std::uint64_t now() {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static void bump(Counter& c, std::uint64_t n = 1) {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    ThreadBlock& threadBlock() {
+        static thread_local Lease lease;
+        if (lease.block) return *lease.block;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& b : blocks) {
+            bool expected = false;
+            if (b->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                lease.block = b.get();
+                return *lease.block;
+            }
+        }
+        blocks.push_back(std::make_unique<ThreadBlock>());
+        lease.block = blocks.back().get();
+        return *lease.block;
+    }
+
+    // 失败原因的编号(只在失败时调用)
+    std::size_t reasonId(std::string_view reason) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = reasonIds.find(reason);
+        if (it != reasonIds.end()) return it->second;
+        if (reasonNames.size() == kMaxReasons - 1) return kMaxReasons - 1;
+        reasonNames.emplace_back(reason);
+        reasonIds.emplace(std::string(reason), reasonNames.size() - 1);
+        return reasonNames.size() - 1;
+    }
+
+    // 所有线程的累计值(调用方持有mutex)
+    Snapshot totals() const {
+        Snapshot s{};
+        std::vector<std::array<std::uint64_t, kMaxReasons>> reasons(kMaxOperations);
+        for (const auto& b : blocks) {
+            for (std::size_t op = 0; op < kMaxOperations; ++op) {
+                std::uint64_t count = b->count[op].load(std::memory_order_relaxed);
+                if (count == 0) continue;
+                OperationStats& o = s[op];
+                o.count += count;
+                o.failures += b->failures[op].load(std::memory_order_relaxed);
+                o.totalNs += b->totalNs[op].load(std::memory_order_relaxed);
+                for (std::size_t i = 0; i < metrics_detail::kBuckets; ++i) {
+                    o.histogram[i] += b->histogram[op][i].load(std::memory_order_relaxed);
+                }
+                for (std::size_t r = 0; r < kMaxReasons; ++r) {
+                    reasons[op][r] += b->reasons[op][r].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        for (std::size_t op = 0; op < kMaxOperations; ++op) {
+            for (std::size_t r = 0; r < kMaxReasons; ++r) {
+                if (reasons[op][r] == 0) continue;
+                s[op].reasons.emplace_back(r < reasonNames.size() ? reasonNames[r] : "其他", reasons[op][r]);
+            }
+        }
+        return s;
+    }
+
+public:
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    // 全局统计
+    static Metrics& global() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+    void setEnabled(bool enable) { on.store(enable, std::memory_order_relaxed); }
+
+    // 开始计时，统计关闭时返回0且不读时钟
+    std::uint64_t start() const { return enabled() ? now() : 0; }
+
+    // 结束计时并记录一次操作，failure非空表示失败；startNs为0(开始时统计关闭)时不记录
+    void finish(std::size_t op, std::uint64_t startNs, std::string_view failure = {}) {
+        if (startNs == 0) return;
+        record(op, elapsedNs(startNs), failure);
+    }
+
+    // 自start()返回的startNs以来的耗时
+    static std::uint64_t elapsedNs(std::uint64_t startNs) {
+        std::uint64_t end = now();
+        return end > startNs ? end - startNs : 0;
+    }
+
+    // 记录一次耗时为ns的操作(批量执行时逐条计时后记录)
+    void record(std::size_t op, std::uint64_t ns, std::string_view failure = {}) {
+        if (op >= kMaxOperations) return;
+        ThreadBlock& b = threadBlock();
+        bump(b.count[op]);
+        bump(b.totalNs[op], ns);
+        bump(b.histogram[op][metrics_detail::bucketOf(ns)]);
+        if (!failure.empty()) {
+            bump(b.failures[op]);
+            bump(b.reasons[op][reasonId(failure)]);
+        }
+    }
+
+    // 自上次清零以来的统计
+    Snapshot snapshot() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        Snapshot s = totals();
+        for (std::size_t op = 0; op < kMaxOperations; ++op) {
+            OperationStats& o = s[op];
+            const OperationStats& base = baseline[op];
+            o.count -= base.count;
+            o.failures -= base.failures;
+            o.totalNs -= base.totalNs;
+            for (std::size_t i = 0; i < metrics_detail::kBuckets; ++i) o.histogram[i] -= base.histogram[i];
+            for (auto& [reason, n] : o.reasons) {
+                for (const auto& [baseReason, baseN] : base.reasons) {
+                    if (baseReason == reason) n -= baseN;
+                }
+            }
+            o.reasons.erase(std::remove_if(o.reasons.begin(), o.reasons.end(),
+                                           [](const auto& r) { return r.second == 0; }),
+                            o.reasons.end());
+            std::sort(o.reasons.begin(), o.reasons.end(),
+                      [](const auto& x, const auto& y) { return x.second > y.second; });
+        }
+        return s;
+    }
+
+    // 清零
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        baseline = totals();
+    }
+};
+
+#endif // METRICS_H
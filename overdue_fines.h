@@ -0,0 +1,64 @@
+#ifndef OVERDUE_FINES_H
+#define OVERDUE_FINES_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "date.h"
+#include "fee_ledger.h"
+
+// 逾期罚款：按书籍类型设定借期与罚款标准
+// 每次结算计算每笔在借借阅截至结算日应缴的罚款总额，只把比上次已计入部分多出的差额记到读者欠费上，
+// 因此同一天重复结算不会重复计费，隔几天再结算也只补计新增的天数
+
+// 单个类型的逾期规则
+struct OverduePolicy {
+    std::int32_t loanDays;      // 借期(天)
+    std::int32_t graceDays;     // 到期后的宽限天数，宽限期内不计罚款
+    Cents dailyFine;            // 每逾期一天的罚款(分)
+    Cents maxFine;              // 单笔借阅的罚款上限(分)，0表示不设上限
+
+    // 到期日
+    constexpr Date dueDate(Date checkout) const { return checkout + loanDays; }
+
+    // 截至asOf应缴的罚款总额
+    constexpr Cents fineAsOf(Date checkout, Date asOf) const {
+        std::int32_t overdue = (asOf - dueDate(checkout)) - graceDays;
+        if (overdue <= 0) return 0;
+        Cents fine = overdue * dailyFine;
+        return maxFine > 0 ? std::min(fine, maxFine) : fine;
+    }
+};
+
+// 各类型的逾期规则，按Genre的顺序排列
+constexpr std::size_t kGenreCount = 5;
+using FinePolicy = std::array<OverduePolicy, kGenreCount>;
+
+// 默认规则：期刊借期短、罚款高；儿童读物罚款低且上限低
+constexpr FinePolicy kDefaultFinePolicy = {{
+    {30, 0, 10, 2000},   // 小说
+    {30, 0, 10, 2000},   // 非小说类文学作品
+    {7, 0, 20, 1000},    // 期刊
+    {30, 0, 10, 2000},   // 传记
+    {21, 3, 5, 500},     // 儿童读物
+}};
+
+static_assert(kDefaultFinePolicy[2].fineAsOf(Date(2024, 1, 1), Date(2024, 1, 8)) == 0);
+static_assert(kDefaultFinePolicy[2].fineAsOf(Date(2024, 1, 1), Date(2024, 1, 11)) == 60);
+static_assert(kDefaultFinePolicy[2].fineAsOf(Date(2024, 1, 1), Date(2025, 1, 1)) == 1000);
+
+// 一次结算的统计
+struct FineRunSummary {
+    Date asOf = Date::fromDays(0);  // 结算日
+    std::size_t openLoans = 0;      // 扫描的在借借阅数
+    std::size_t overdueLoans = 0;   // 逾期借阅数
+    std::size_t finedLoans = 0;     // 本次新增罚款的借阅数
+    std::size_t patronsCharged = 0; // 本次欠费有变化的读者数
+    Cents posted = 0;               // 本次新增罚款总额
+    unsigned threads = 0;           // 使用的线程数
+    double seconds = 0;             // 耗时
+};
+
+#endif // OVERDUE_FINES_H
@@ -0,0 +1,424 @@
+#ifndef PERSISTENCE_H
+#define PERSISTENCE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+// 持久化：预写日志(WAL) + 二进制快照
+// 日志记录格式: [u32 负载长度][u64 序号][u8 类型][负载][u32 校验和]
+// 快照格式:     [8字节魔数][u64 覆盖到的日志序号][Library自定义内容][u32 校验和]
+// 恢复时先映射并加载快照，再只重放序号大于快照序号的日志尾部
+
+// 日志记录类型
+enum class WalRecordType : std::uint8_t {
+    addBook = 1,
+    addPatron = 2,
+    checkout = 3,
+    checkin = 4,
+    setFees = 5,
+    accrueFines = 6,    // 逾期罚款结算(结算日与规则)，重放时按同一规则重新结算
+    removeBook = 7,
+    removePatron = 8,
+    addCopies = 9,      // 为已有书籍增加副本(ISBN与增加的数量)
+    placeHold = 10,     // 预约(ISBN、借书证号、日期与优先级)；归还后分配给预约读者时另写一条借出记录
+    cancelHold = 11     // 取消预约(ISBN与借书证号)
+};
+
+// FNV-1a校验和
+inline std::uint32_t fnv1a(std::string_view data, std::uint32_t hash = 2166136261u) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 二进制编码缓冲(本机字节序)
+class BinaryWriter {
+private:
+    std::string buffer;
+
+public:
+    template <typename T>
+    void put(T value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void putString(std::string_view s) {
+        put(static_cast<std::uint32_t>(s.size()));
+        buffer.append(s);
+    }
+
+    void putBytes(const void* data, std::size_t n) {
+        buffer.append(static_cast<const char*>(data), n);
+    }
+
+    const std::string& data() const { return buffer; }
+    std::string& data() { return buffer; }
+    std::size_t size() const { return buffer.size(); }
+
+    // 覆盖offset处先前写入的定长值(先占位、写完后回填计数)
+    template <typename T>
+    void patch(std::size_t offset, T value) {
+        std::memcpy(buffer.data() + offset, &value, sizeof(T));
+    }
+    void clear() { buffer.clear(); }
+};
+
+// 二进制解码游标，数据不足时抛出std::runtime_error
+class BinaryReader {
+private:
+    std::string_view data;
+
+public:
+    explicit BinaryReader(std::string_view d) : data(d) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string_view getString() {
+        return take(get<std::uint32_t>());
+    }
+
+    std::string_view take(std::size_t n) {
+        if (n > data.size()) {
+            throw std::runtime_error("持久化数据不完整");
+        }
+        std::string_view out = data.substr(0, n);
+        data.remove_prefix(n);
+        return out;
+    }
+
+    std::size_t remaining() const { return data.size(); }
+};
+
+// 日志重放结果
+struct WalReplayResult {
+    std::uint64_t lastSeq;      // 最后一条有效记录的序号
+    std::uint64_t validBytes;   // 有效记录占用的字节数，其后为损坏的尾部
+};
+
+// 重放日志文件，对序号大于afterSeq的每条完整记录回调handler(类型, 负载读取器)
+// 遇到截断或校验失败的尾部即停止(视为崩溃时未写完的记录)
+template <typename Handler>
+WalReplayResult replayWal(const std::string& path, std::uint64_t afterSeq, Handler&& handler) {
+    WalReplayResult result{afterSeq, 0};
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) return result;
+
+    MappedFile file(path);
+    std::string_view rest = file.view();
+    constexpr std::size_t kHeader = sizeof(std::uint32_t) + sizeof(std::uint64_t) + 1;
+    while (rest.size() >= kHeader) {
+        std::uint32_t length;
+        std::uint64_t seq;
+        std::memcpy(&length, rest.data(), sizeof(length));
+        std::memcpy(&seq, rest.data() + sizeof(length), sizeof(seq));
+        std::size_t total = kHeader + length + sizeof(std::uint32_t);
+        if (rest.size() < total) break;
+
+        std::uint32_t stored;
+        std::memcpy(&stored, rest.data() + kHeader + length, sizeof(stored));
+        if (fnv1a(rest.substr(0, kHeader + length)) != stored) break;
+
+        if (seq > afterSeq) {
+            auto type = static_cast<WalRecordType>(rest[kHeader - 1]);
+            BinaryReader payload(rest.substr(kHeader, length));
+            handler(type, payload);
+            result.lastSeq = seq;
+        }
+        rest.remove_prefix(total);
+        result.validBytes += total;
+    }
+    return result;
+}
+
+// 用临时文件原子替换目标文件，并把目录项的修改落盘
+// 替换前不删除目标文件：任何时刻崩溃，目标路径上要么是旧文件要么是新文件
+inline void replaceFileDurably(const std::string& tmp, const std::string& path) {
+#ifdef _WIN32
+    if (!MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        throw std::runtime_error("无法替换文件: " + path);
+    }
+#else
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("无法替换文件: " + path);
+    }
+    // rename只修改目录项，须同步所在目录，否则掉电后目录可能仍指向旧文件
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    if (dir.empty()) dir = ".";
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        throw std::runtime_error("无法打开目录: " + dir);
+    }
+    int synced = ::fsync(fd);
+    ::close(fd);
+    if (synced != 0) {
+        throw std::runtime_error("无法同步目录: " + dir);
+    }
+#endif
+}
+
+// 预写日志，支持组提交
+// append只把记录放入内存缓冲并返回序号；后台刷盘线程把积累的记录一次写入并fsync，
+// 多个并发提交者共享同一次fsync。waitDurable阻塞到指定序号已落盘。
+// 写入或fsync失败后日志进入失败状态(不可恢复)：已落盘序号不再前进，等待中的和之后的
+// waitDurable/append都抛出std::runtime_error，相应的命令报告失败
+class WriteAheadLog {
+private:
+    std::string path;
+    std::FILE* file = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable pendingCv;  // 有新记录待刷盘
+    std::condition_variable durableCv;  // 有记录已落盘或日志已失败
+    std::string pending;                // 尚未写入文件的记录
+    std::uint64_t lastSeq;              // 最后分配的序号
+    std::uint64_t durableSeq;           // 已落盘的最大序号
+    std::uint64_t sinceCheckpoint = 0;  // 自上次检查点以来的记录数
+    std::string failure;                // 失败原因，非空表示日志已失败
+    bool stopping = false;
+    bool flushing = false;
+    std::thread flusher;
+
+    static bool syncFile(std::FILE* f) {
+        if (std::fflush(f) != 0) return false;
+#ifdef _WIN32
+        return _commit(_fileno(f)) == 0;
+#else
+        return ::fsync(fileno(f)) == 0;
+#endif
+    }
+
+    // 调用方持有mutex
+    void throwIfFailed() const {
+        if (!failure.empty()) throw std::runtime_error(failure);
+    }
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            pendingCv.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty() && stopping) break;
+
+            std::string batch;
+            batch.swap(pending);
+            std::uint64_t batchSeq = lastSeq;
+            // 失败后文件尾部可能只写入了一部分，不再写入任何记录
+            if (!failure.empty()) continue;
+            flushing = true;
+            lock.unlock();
+
+            bool ok = std::fwrite(batch.data(), 1, batch.size(), file) == batch.size();
+            ok = syncFile(file) && ok;
+
+            lock.lock();
+            flushing = false;
+            if (ok) {
+                durableSeq = batchSeq;
+            } else {
+                failure = "写入日志失败: " + path;
+            }
+            durableCv.notify_all();
+        }
+    }
+
+public:
+    // 以追加方式打开日志，replayed为恢复阶段的重放结果(用于截掉损坏的尾部)
+    WriteAheadLog(const std::string& p, const WalReplayResult& replayed)
+        : path(p), lastSeq(replayed.lastSeq), durableSeq(replayed.lastSeq) {
+        std::error_code ec;
+        if (std::filesystem::exists(path, ec) && std::filesystem::file_size(path, ec) > replayed.validBytes) {
+            std::filesystem::resize_file(path, replayed.validBytes);
+        }
+        file = std::fopen(path.c_str(), "ab");
+        if (!file) {
+            throw std::runtime_error("无法打开日志文件: " + path);
+        }
+        flusher = std::thread(&WriteAheadLog::flushLoop, this);
+    }
+
+    ~WriteAheadLog() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        pendingCv.notify_one();
+        flusher.join();
+        if (file) std::fclose(file);
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // 追加一条记录到缓冲，返回其序号；日志已失败时抛出异常
+    std::uint64_t append(WalRecordType type, std::string_view payload) {
+        BinaryWriter record;
+        std::lock_guard<std::mutex> lock(mutex);
+        throwIfFailed();
+        std::uint64_t seq = ++lastSeq;
+        record.put(static_cast<std::uint32_t>(payload.size()));
+        record.put(seq);
+        record.put(static_cast<std::uint8_t>(type));
+        record.putBytes(payload.data(), payload.size());
+        record.put(fnv1a(record.data()));
+        pending += record.data();
+        ++sinceCheckpoint;
+        pendingCv.notify_one();
+        return seq;
+    }
+
+    // 等待指定序号的记录落盘；日志失败且该记录未落盘时抛出异常
+    void waitDurable(std::uint64_t seq) {
+        std::unique_lock<std::mutex> lock(mutex);
+        durableCv.wait(lock, [&] { return durableSeq >= seq || !failure.empty(); });
+        if (durableSeq < seq) throwIfFailed();
+    }
+
+    // 追加并等待落盘
+    void commit(WalRecordType type, std::string_view payload) {
+        waitDurable(append(type, payload));
+    }
+
+    // 最后分配的序号
+    std::uint64_t lastSequence() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return lastSeq;
+    }
+
+    // 自上次检查点以来追加的记录数
+    std::uint64_t recordsSinceCheckpoint() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return sinceCheckpoint;
+    }
+
+    // 快照已覆盖到seq后，从日志文件中去掉序号不大于seq的记录，保留之后追加的记录
+    // 剩余记录写入临时文件后原子替换日志文件，期间暂停刷盘(append照常进入缓冲)，只需等正在进行的一次刷盘结束
+    void truncateThrough(std::uint64_t seq) {
+        std::unique_lock<std::mutex> lock(mutex);
+        durableCv.wait(lock, [this] { return !flushing; });
+        throwIfFailed();
+
+        std::string tail;
+        {
+            MappedFile current(path);
+            std::string_view rest = current.view();
+            constexpr std::size_t kHeader = sizeof(std::uint32_t) + sizeof(std::uint64_t) + 1;
+            while (rest.size() >= kHeader) {
+                std::uint32_t length;
+                std::uint64_t recordSeq;
+                std::memcpy(&length, rest.data(), sizeof(length));
+                std::memcpy(&recordSeq, rest.data() + sizeof(length), sizeof(recordSeq));
+                if (recordSeq > seq) break;
+                rest.remove_prefix(std::min(rest.size(), kHeader + length + sizeof(std::uint32_t)));
+            }
+            tail.assign(rest);
+        }
+
+        std::string tmp = path + ".tmp";
+        std::FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (!f) {
+            throw std::runtime_error("无法重建日志文件: " + tmp);
+        }
+        bool ok = std::fwrite(tail.data(), 1, tail.size(), f) == tail.size();
+        ok = syncFile(f) && ok;
+        ok = std::fclose(f) == 0 && ok;
+        if (!ok) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("重建日志文件失败: " + tmp);
+        }
+        // 关闭后替换失败或无法重新打开时日志进入失败状态(刷盘线程不再写入)
+        std::fclose(file);
+        file = nullptr;
+        try {
+            replaceFileDurably(tmp, path);
+        } catch (const std::exception& e) {
+            failure = e.what();
+        }
+        if (failure.empty() && !(file = std::fopen(path.c_str(), "ab"))) {
+            failure = "无法打开日志文件: " + path;
+        }
+        if (!failure.empty()) {
+            durableCv.notify_all();
+            throw std::runtime_error(failure);
+        }
+        sinceCheckpoint = lastSeq - seq;
+    }
+};
+
+// 快照文件魔数
+constexpr char kSnapshotMagic[8] = {'L', 'I', 'B', 'S', 'N', 'A', 'P', '1'};
+
+// 把快照内容(不含头尾)写入临时文件并原子替换目标文件
+// 返回时新快照及其目录项均已落盘，调用方随后才能清空日志；失败时抛出异常，原快照不受影响
+inline void writeSnapshotFile(const std::string& path, std::uint64_t seq, const std::string& body) {
+    BinaryWriter header;
+    header.putBytes(kSnapshotMagic, sizeof(kSnapshotMagic));
+    header.put(seq);
+    std::uint32_t checksum = fnv1a(body, fnv1a(header.data()));
+
+    std::string tmp = path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        throw std::runtime_error("无法写入快照: " + tmp);
+    }
+    bool ok = std::fwrite(header.data().data(), 1, header.size(), f) == header.size();
+    ok = std::fwrite(body.data(), 1, body.size(), f) == body.size() && ok;
+    ok = std::fwrite(&checksum, 1, sizeof(checksum), f) == sizeof(checksum) && ok;
+    ok = std::fflush(f) == 0 && ok;
+#ifdef _WIN32
+    ok = _commit(_fileno(f)) == 0 && ok;
+#else
+    ok = ::fsync(fileno(f)) == 0 && ok;
+#endif
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("写入快照失败: " + tmp);
+    }
+    replaceFileDurably(tmp, path);
+}
+
+// 校验快照文件头尾，返回快照覆盖的日志序号，body输出快照内容
+inline std::uint64_t readSnapshotFile(std::string_view file, std::string_view& body) {
+    constexpr std::size_t kHeader = sizeof(kSnapshotMagic) + sizeof(std::uint64_t);
+    if (file.size() < kHeader + sizeof(std::uint32_t) ||
+        std::memcmp(file.data(), kSnapshotMagic, sizeof(kSnapshotMagic)) != 0) {
+        throw std::runtime_error("快照文件格式错误");
+    }
+    std::uint32_t stored;
+    std::memcpy(&stored, file.data() + file.size() - sizeof(stored), sizeof(stored));
+    std::string_view covered = file.substr(0, file.size() - sizeof(stored));
+    if (fnv1a(covered) != stored) {
+        throw std::runtime_error("快照文件校验失败");
+    }
+    std::uint64_t seq;
+    std::memcpy(&seq, file.data() + sizeof(kSnapshotMagic), sizeof(seq));
+    body = covered.substr(kHeader);
+    return seq;
+}
+
+#endif // PERSISTENCE_H
@@ -0,0 +1,194 @@
+#ifndef READ_VIEW_H
+#define READ_VIEW_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
+
+#include "slot_map.h"
+
+// 多版本读视图(MVCC)的基础设施：纪元时钟与按槽位的行版本链
+//
+// 纪元：打开读视图时取当前纪元V并把纪元加一，之后的修改都带着更大的纪元号。
+// 视图V看到的是"纪元号不大于V的最新版本"。打开视图须在没有写者在途时进行(Library在独占锁下打开)，
+// 因此视图得到的是一个一致的截面。
+//
+// 行版本：每个槽位保存当前行的纪元号(stamp)与一条旧版本链(新在前)。
+// 有视图打开时，写者在修改一行之前若发现该行的stamp小于当前纪元，就把修改前的整行(含句柄，空槽位记为空版本)
+// 压入版本链，再把stamp改为当前纪元；同一纪元内的后续修改不再保存。没有视图时写者只读一个原子计数。
+// 读者先看当前行：stamp不大于V且读取前后stamp未变则直接使用，否则沿版本链找到第一个stamp不大于V的版本。
+// stamp、链头与链指针都用顺序一致的原子操作，行内的可变字段(借出数、欠费)本身也是原子变量。
+//
+// 回收(基于纪元)：旧版本被取代时的纪元记为retired；仅当所有仍打开的视图都不小于retired时，它不会再被任何视图读到。
+// 同一条链上可回收的版本总是一段后缀，读者在到达它们之前就已停下，因此截断无需等待读者。
+//
+// 并发(由Library保证)：容量调整在独占锁下；保存版本在该行的写锁(分片锁或独占锁)下；截断在共享锁加该行的分片锁下。
+
+// 纪元时钟与打开中的视图
+class EpochClock {
+private:
+    std::atomic<std::uint64_t> current{1};
+    std::atomic<std::size_t> openCount{0};
+    std::mutex mutex;
+    std::multiset<std::uint64_t> open;
+
+public:
+    static constexpr std::uint64_t kNone = std::numeric_limits<std::uint64_t>::max();
+
+    // 打开一个视图，返回其纪元(调用方保证没有写者在途)
+    std::uint64_t begin() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::uint64_t v = current.load();
+        current.store(v + 1);
+        open.insert(v);
+        openCount.fetch_add(1);
+        return v;
+    }
+
+    // 关闭纪元为v的视图，返回仍打开的视图中最小的纪元，没有时返回kNone
+    std::uint64_t end(std::uint64_t v) {
+        std::lock_guard<std::mutex> lock(mutex);
+        open.erase(open.find(v));
+        openCount.fetch_sub(1);
+        return open.empty() ? kNone : *open.begin();
+    }
+
+    // 是否有打开的视图
+    bool active() const { return openCount.load() > 0; }
+    // 当前纪元(写者给修改打上的纪元号)
+    std::uint64_t epoch() const { return current.load(); }
+};
+
+// 一类行(书籍或读者)的版本存储，按槽位号编号
+template <typename T>
+class VersionStore {
+private:
+    struct Version {
+        std::optional<T> row;           // 被取代前的整行，空槽位为空
+        SlotHandle handle;              // 当时占用该槽位的句柄
+        std::uint64_t stamp;            // 该版本生效时的纪元
+        std::uint64_t retired;          // 被取代时的纪元
+        std::atomic<Version*> older{nullptr};
+
+        Version(const T* r, SlotHandle h, std::uint64_t s, std::uint64_t e) : handle(h), stamp(s), retired(e) {
+            if (r) row.emplace(*r);
+        }
+    };
+
+    // 原子成员需显式拷贝，只在独占锁下扩容时拷贝
+    struct Slot {
+        std::atomic<std::uint64_t> stamp{0};
+        std::atomic<Version*> head{nullptr};
+
+        Slot() = default;
+        Slot(const Slot& other) : stamp(other.stamp.load()), head(other.head.load()) {}
+    };
+
+    std::vector<Slot> slots;
+    std::deque<std::pair<std::uint64_t, std::uint32_t>> retiredSlots;  // (retired, 槽位)，按retired递增
+    std::mutex retiredMutex;
+
+    static void freeChain(Version* v) {
+        while (v) {
+            Version* next = v->older.load();
+            delete v;
+            v = next;
+        }
+    }
+
+public:
+    VersionStore() = default;
+
+    ~VersionStore() {
+        for (Slot& s : slots) freeChain(s.head.load());
+    }
+
+    VersionStore(const VersionStore&) = delete;
+    VersionStore& operator=(const VersionStore&) = delete;
+
+    // 按槽位总数调整容量(只增不减)
+    void resize(std::size_t n) {
+        if (n > slots.size()) slots.resize(n);
+    }
+
+    // 修改一行之前调用：live为当前行(空槽位为nullptr)，handle为当前句柄
+    void preserve(std::uint32_t slot, const T* live, SlotHandle handle, std::uint64_t epoch) {
+        Slot& s = slots[slot];
+        std::uint64_t stamp = s.stamp.load();
+        if (stamp >= epoch) return;
+        auto* v = new Version(live, handle, stamp, epoch);
+        v->older.store(s.head.load());
+        s.head.store(v);
+        s.stamp.store(epoch);
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        retiredSlots.emplace_back(epoch, slot);
+    }
+
+    // 读取槽位在视图v中的版本，存在时回调f(行, 句柄)并返回true；live/handle为当前行与句柄
+    template <typename F>
+    bool read(std::uint32_t slot, std::uint64_t v, const T* live, SlotHandle handle, F&& f) const {
+        const Slot& s = slots[slot];
+        std::uint64_t stamp = s.stamp.load();
+        if (stamp <= v) {
+            if (!live) return false;
+            T copy(*live);
+            if (s.stamp.load() == stamp) {
+                f(copy, handle);
+                return true;
+            }
+        }
+        for (Version* p = s.head.load(); p; p = p->older.load()) {
+            if (p->stamp <= v) {
+                if (!p->row) return false;
+                f(*p->row, p->handle);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 取出所有已不被任何视图需要的版本所在的槽位(minOpen为仍打开视图的最小纪元)
+    std::vector<std::uint32_t> takeRetired(std::uint64_t minOpen) {
+        std::vector<std::uint32_t> out;
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        while (!retiredSlots.empty() && retiredSlots.front().first <= minOpen) {
+            out.push_back(retiredSlots.front().second);
+            retiredSlots.pop_front();
+        }
+        return out;
+    }
+
+    // 截掉槽位版本链中retired不大于minOpen的后缀并释放
+    void truncate(std::uint32_t slot, std::uint64_t minOpen) {
+        Slot& s = slots[slot];
+        Version* prev = nullptr;
+        Version* v = s.head.load();
+        while (v && v->retired > minOpen) {
+            prev = v;
+            v = v->older.load();
+        }
+        if (!v) return;
+        if (prev) prev->older.store(nullptr);
+        else s.head.store(nullptr);
+        freeChain(v);
+    }
+
+    // 清空全部版本(仅在没有视图时调用)
+    void clear() {
+        for (Slot& s : slots) {
+            freeChain(s.head.exchange(nullptr));
+            s.stamp.store(0);
+        }
+        slots.clear();
+        std::lock_guard<std::mutex> lock(retiredMutex);
+        retiredSlots.clear();
+    }
+};
+
+#endif // READ_VIEW_H
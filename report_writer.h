@@ -0,0 +1,311 @@
+#ifndef REPORT_WRITER_H
+#define REPORT_WRITER_H
+
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "library.h"
+
+// 报表：分页浏览与CSV/JSON导出
+// 所有输出先追加到一块大缓冲，积累到阈值后整块写出，每个字段只是一次内存追加，
+// 数字与日期用to_chars直接写入缓冲，不经过流的格式化，也不产生临时字符串。
+// 导出按页从Library取数据，每页之间释放共享锁，导出大量借阅记录时不会长时间阻塞添加书籍/读者
+
+// 以JSON字符串(含引号)形式追加
+inline void appendJsonString(std::string& out, std::string_view s) {
+    out += '"';
+    for (char c : s) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char esc[8];
+                    std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+                    out += esc;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+// 以CSV字段形式追加：含逗号、引号或换行时加引号并把引号写两遍
+inline void appendCsvField(std::string& out, std::string_view s) {
+    if (s.find_first_of(",\"\r\n") == std::string_view::npos) {
+        out += s;
+        return;
+    }
+    out += '"';
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+// 带大缓冲的输出
+class OutputBuffer {
+private:
+    std::ostream& os;
+    std::string buffer;
+    std::size_t flushBytes;
+    std::uint64_t written = 0;
+
+public:
+    static constexpr std::size_t kDefaultFlushBytes = 1 << 20;
+
+    explicit OutputBuffer(std::ostream& out, std::size_t flushAt = kDefaultFlushBytes)
+        : os(out), flushBytes(flushAt) {
+        buffer.reserve(flushBytes + 4096);
+    }
+
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    OutputBuffer& put(std::string_view s) {
+        buffer += s;
+        return *this;
+    }
+
+    OutputBuffer& put(char c) {
+        buffer += c;
+        return *this;
+    }
+
+    OutputBuffer& putInt(long long value) {
+        char buf[24];
+        auto r = std::to_chars(buf, buf + sizeof(buf), value);
+        buffer.append(buf, r.ptr);
+        return *this;
+    }
+
+    // 金额(分)按"元.角分"输出
+    OutputBuffer& putCents(Cents cents) {
+        if (cents < 0) {
+            buffer += '-';
+            cents = -cents;
+        }
+        putInt(cents / 100);
+        buffer += '.';
+        buffer += static_cast<char>('0' + cents % 100 / 10);
+        buffer += static_cast<char>('0' + cents % 10);
+        return *this;
+    }
+
+    // 日期按YYYY-MM-DD输出
+    OutputBuffer& putDate(const Date& date) {
+        auto two = [this](int v) {
+            buffer += static_cast<char>('0' + v / 10);
+            buffer += static_cast<char>('0' + v % 10);
+        };
+        int year = date.year();
+        two(year / 100);
+        two(year % 100);
+        buffer += '-';
+        two(date.month());
+        buffer += '-';
+        two(date.day());
+        return *this;
+    }
+
+    OutputBuffer& putJson(std::string_view s) {
+        appendJsonString(buffer, s);
+        return *this;
+    }
+
+    OutputBuffer& putCsv(std::string_view s) {
+        appendCsvField(buffer, s);
+        return *this;
+    }
+
+    // 一行结束，缓冲达到阈值时整块写出
+    void endRow() {
+        if (buffer.size() >= flushBytes) flush();
+    }
+
+    void flush() {
+        if (buffer.empty()) return;
+        os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        written += buffer.size();
+        buffer.clear();
+    }
+
+    // 已写出与缓冲中的字节数
+    std::uint64_t bytes() const { return written + buffer.size(); }
+};
+
+// 导出格式
+enum class ExportFormat : std::uint8_t {
+    csv,    // 首行为表头
+    json    // JSON数组，每条记录占一行
+};
+
+// 导出内容
+enum class ExportKind : std::uint8_t {
+    books,
+    patrons,
+    transactions
+};
+
+inline bool parseExportFormat(std::string_view s, ExportFormat& format) {
+    if (s == "csv") format = ExportFormat::csv;
+    else if (s == "json") format = ExportFormat::json;
+    else return false;
+    return true;
+}
+
+inline bool parseExportKind(std::string_view s, ExportKind& kind) {
+    if (s == "books") kind = ExportKind::books;
+    else if (s == "patrons") kind = ExportKind::patrons;
+    else if (s == "transactions") kind = ExportKind::transactions;
+    else return false;
+    return true;
+}
+
+// 一次导出的统计
+struct ExportSummary {
+    std::size_t rows = 0;       // 导出的记录数
+    std::uint64_t bytes = 0;    // 写出的字节数
+    double seconds = 0;         // 耗时
+};
+
+// 把书籍/读者/借阅记录流式导出为CSV或JSON
+// 书籍CSV的前五列与批量导入格式一致(类型为1-5)，可直接用于导入
+// 导出在一个读视图上进行，得到开始时刻的一致快照，导出期间借还书照常提交
+class ReportExporter {
+private:
+    const Library& lib;
+    OutputBuffer& out;
+    ExportFormat format;
+    std::size_t rows = 0;
+
+    // 每页条数：每页之间释放共享锁
+    static constexpr std::size_t kPageSize = 1 << 14;
+
+    void beginRecord() {
+        if (format == ExportFormat::json) out.put(rows == 0 ? "\n" : ",\n");
+        ++rows;
+    }
+
+    void endRecord() {
+        out.put(format == ExportFormat::json ? "}" : "\n");
+        out.endRow();
+    }
+
+    // 输出一个字段；CSV按列顺序输出，JSON输出"名称":值
+    void field(const char* name, bool first) {
+        if (format == ExportFormat::json) {
+            out.put(first ? "{\"" : ",\"").put(name).put("\":");
+        } else if (!first) {
+            out.put(',');
+        }
+    }
+
+    void text(const char* name, std::string_view value, bool first = false) {
+        field(name, first);
+        if (format == ExportFormat::json) out.putJson(value);
+        else out.putCsv(value);
+    }
+
+    void number(const char* name, long long value, bool first = false) {
+        field(name, first);
+        out.putInt(value);
+    }
+
+    void book(const Book& b) {
+        beginRecord();
+        text("isbn", b.getISBN(), true);
+        text("title", b.getTitle());
+        text("author", b.getAuthor());
+        number("year", b.getCopyrightYear());
+        number("genre", static_cast<int>(b.getGenre()) + 1);
+        field("checkedOut", false);
+        if (format == ExportFormat::json) out.put(b.getCheckoutStatus() ? "true" : "false");
+        else out.put(b.getCheckoutStatus() ? '1' : '0');
+        number("copies", b.getCopies());
+        number("available", b.getAvailableCopies());
+        endRecord();
+    }
+
+    void patron(const Patron& p) {
+        beginRecord();
+        text("name", p.getName(), true);
+        number("card", p.getCardNumber());
+        field("fees", false);
+        out.putCents(p.getFeeCents());
+        endRecord();
+    }
+
+    void transaction(const Transaction& t, const Book& b, const Patron& p) {
+        beginRecord();
+        text("isbn", b.getISBN(), true);
+        text("title", b.getTitle());
+        number("card", p.getCardNumber());
+        text("patron", p.getName());
+        text("type", t.type == TransactionType::checkin ? "checkin" : "checkout");
+        field("date", false);
+        if (format == ExportFormat::json) out.put('"').putDate(Date::unpack(t.date)).put('"');
+        else out.putDate(Date::unpack(t.date));
+        endRecord();
+    }
+
+public:
+    ReportExporter(const Library& library, OutputBuffer& output, ExportFormat f)
+        : lib(library), out(output), format(f) {}
+
+    // 导出全部记录，返回统计(字节数含调用前已写入out的部分)
+    ExportSummary run(ExportKind kind) {
+        auto start = std::chrono::steady_clock::now();
+        rows = 0;
+        if (format == ExportFormat::json) {
+            out.put('[');
+        } else {
+            switch (kind) {
+                case ExportKind::books: out.put("isbn,title,author,year,genre,checkedOut,copies,available\n"); break;
+                case ExportKind::patrons: out.put("name,card,fees\n"); break;
+                case ExportKind::transactions: out.put("isbn,title,card,patron,type,date\n"); break;
+            }
+        }
+
+        Library::ReadView view = lib.openReadView();
+        std::optional<std::size_t> cursor = 0;
+        while (cursor) {
+            switch (kind) {
+                case ExportKind::books:
+                    cursor = view.forEachBook(*cursor, kPageSize, [this](const Book& b) { book(b); });
+                    break;
+                case ExportKind::patrons:
+                    cursor = view.forEachPatron(*cursor, kPageSize, [this](const Patron& p) { patron(p); });
+                    break;
+                case ExportKind::transactions:
+                    cursor = view.forEachTransaction(*cursor, kPageSize,
+                        [this](const Transaction& t, const Book& b, const Patron& p) { transaction(t, b, p); });
+                    break;
+            }
+        }
+
+        if (format == ExportFormat::json) out.put(rows == 0 ? "]\n" : "\n]\n");
+        out.flush();
+        ExportSummary summary;
+        summary.rows = rows;
+        summary.bytes = out.bytes();
+        summary.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return summary;
+    }
+};
+
+#endif // REPORT_WRITER_H
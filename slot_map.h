@@ -0,0 +1,159 @@
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// 槽位表(slot map)：元素紧密存放在一个数组中，外部通过带代数的句柄访问
+//   - 插入、删除、按句柄查找都是O(1)；删除时把末尾元素移入空位，遍历始终是紧密数组
+//   - 句柄为32位：低24位为槽位号，高8位为代数；槽位被删除后代数加一，旧句柄随即失效，
+//     因此借阅记录、索引等可以长期保存句柄，而不必担心指向被删除后重新分配的元素
+//   - 代数不回绕：槽位用满256代后不再放回空闲链表(退役)，旧句柄因此永远不会重新生效；
+//     代价是同一槽位每被复用256次多占一个空槽位
+//   - 槽位号在元素存活期间不变，可作为旁路数组(在借索引、锁分片等)的下标
+//   - 从未删除过元素时，句柄恰好等于插入顺序的下标
+// 与std::vector一样，插入可能使元素的引用失效，需由调用方(Library)加锁保护
+
+using SlotHandle = std::uint32_t;
+
+constexpr unsigned kSlotIndexBits = 24;
+constexpr std::uint32_t kSlotIndexMask = (1u << kSlotIndexBits) - 1;
+constexpr std::uint32_t kMaxSlots = kSlotIndexMask;      // 最大槽位数(约1677万)
+constexpr SlotHandle kInvalidHandle = 0xFFFFFFFFu;       // 永远无效的句柄
+
+// 句柄的槽位号
+constexpr std::uint32_t slotIndex(SlotHandle h) { return h & kSlotIndexMask; }
+// 句柄的代数
+constexpr std::uint32_t slotGeneration(SlotHandle h) { return h >> kSlotIndexBits; }
+
+template <typename T>
+class SlotMap {
+private:
+    static constexpr std::uint32_t kNoSlot = 0xFFFFFFFFu;
+    static constexpr std::uint8_t kMaxGeneration = 0xFF;
+
+    struct Slot {
+        std::uint32_t dense = 0;        // 存活时为元素在values中的位置；空闲时为下一个空闲槽位
+        std::uint8_t generation = 0;    // 当前代数
+        bool live = false;
+    };
+
+    std::vector<T> values;              // 紧密存放的元素
+    std::vector<SlotHandle> owners;     // values[i]的句柄
+    std::vector<Slot> slots;
+    std::uint32_t freeHead = kNoSlot;   // 空闲槽位链表
+
+    static SlotHandle makeHandle(std::uint32_t index, std::uint8_t generation) {
+        return (static_cast<SlotHandle>(generation) << kSlotIndexBits) | index;
+    }
+
+    const Slot* slotOf(SlotHandle h) const {
+        std::uint32_t index = slotIndex(h);
+        if (index >= slots.size()) return nullptr;
+        const Slot& s = slots[index];
+        return s.live && s.generation == slotGeneration(h) ? &s : nullptr;
+    }
+
+public:
+    using iterator = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    // 插入元素，返回其句柄
+    template <typename... Args>
+    SlotHandle emplace(Args&&... args) {
+        std::uint32_t index;
+        if (freeHead != kNoSlot) {
+            index = freeHead;
+            freeHead = slots[index].dense;
+        } else {
+            if (slots.size() >= kMaxSlots) {
+                throw std::runtime_error("元素数量已达容量上限");
+            }
+            index = static_cast<std::uint32_t>(slots.size());
+            slots.resize(slots.size() + 1);
+        }
+        values.emplace_back(std::forward<Args>(args)...);
+        Slot& s = slots[index];
+        s.dense = static_cast<std::uint32_t>(values.size() - 1);
+        s.live = true;
+        SlotHandle h = makeHandle(index, s.generation);
+        owners.push_back(h);
+        return h;
+    }
+
+    SlotHandle insert(const T& value) { return emplace(value); }
+
+    // 删除元素，句柄无效时返回false
+    bool erase(SlotHandle h) {
+        if (!slotOf(h)) return false;
+        Slot& s = slots[slotIndex(h)];
+        std::uint32_t pos = s.dense;
+        std::uint32_t last = static_cast<std::uint32_t>(values.size() - 1);
+        if (pos != last) {
+            values[pos] = std::move(values[last]);
+            owners[pos] = owners[last];
+            slots[slotIndex(owners[pos])].dense = pos;
+        }
+        values.pop_back();
+        owners.pop_back();
+        s.live = false;
+        if (s.generation == kMaxGeneration) return true;   // 退役，不再复用
+        ++s.generation;
+        s.dense = freeHead;
+        freeHead = slotIndex(h);
+        return true;
+    }
+
+    // 句柄是否有效
+    bool contains(SlotHandle h) const { return slotOf(h) != nullptr; }
+
+    // 按句柄取元素，句柄无效时返回nullptr
+    T* get(SlotHandle h) {
+        const Slot* s = slotOf(h);
+        return s ? &values[s->dense] : nullptr;
+    }
+
+    const T* get(SlotHandle h) const {
+        const Slot* s = slotOf(h);
+        return s ? &values[s->dense] : nullptr;
+    }
+
+    // 按句柄取元素(调用方保证句柄有效)
+    T& operator[](SlotHandle h) { return values[slots[slotIndex(h)].dense]; }
+    const T& operator[](SlotHandle h) const { return values[slots[slotIndex(h)].dense]; }
+
+    // 槽位号当前对应的句柄，槽位空闲时返回kInvalidHandle
+    SlotHandle handleAtSlot(std::uint32_t index) const {
+        if (index >= slots.size() || !slots[index].live) return kInvalidHandle;
+        return makeHandle(index, slots[index].generation);
+    }
+
+    // 紧密数组中第i个元素的句柄
+    SlotHandle handleAt(std::size_t i) const { return owners[i]; }
+
+    std::size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+    // 槽位总数(含空闲槽位)，旁路数组按此调整大小
+    std::size_t slotCount() const { return slots.size(); }
+
+    void reserve(std::size_t n) {
+        values.reserve(n);
+        owners.reserve(n);
+        slots.reserve(n);
+    }
+
+    // 紧密遍历(顺序在删除后会变化)
+    iterator begin() { return values.begin(); }
+    iterator end() { return values.end(); }
+    const_iterator begin() const { return values.begin(); }
+    const_iterator end() const { return values.end(); }
+
+    // 最近插入的元素
+    T& back() { return values.back(); }
+    const T& back() const { return values.back(); }
+};
+
+#endif // SLOT_MAP_H
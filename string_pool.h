@@ -0,0 +1,158 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 字符串池：书名、作者、读者姓名等文本统一存放在只增不减的大块内存(arena)中
+// 对象只保存一个指针大小的句柄，拷贝对象不再复制字符串，读取时直接得到string_view。
+// 所有文本都经intern去重：被拒绝的重复书籍、删除后重新加入的书籍、快照/日志解码时构造的临时对象
+// 都复用已有的记录，arena的大小只随出现过的不同文本增长，不随构造次数增长。
+// 已存入的文本在程序结束前不会移动或释放，因此句柄和取得的string_view始终有效。
+
+// 池中字符串的句柄：指向[u32 长度][字节]，空句柄表示空串
+class PooledString {
+private:
+    const char* entry = nullptr;
+
+    friend class StringPool;
+    explicit PooledString(const char* e) : entry(e) {}
+
+public:
+    PooledString() = default;
+
+    std::string_view view() const {
+        if (!entry) return {};
+        std::uint32_t length;
+        std::memcpy(&length, entry, sizeof(length));
+        return std::string_view(entry + sizeof(length), length);
+    }
+
+    operator std::string_view() const { return view(); }
+
+    // 句柄的位模式(供需要整数键的索引使用)
+    std::uintptr_t bits() const { return reinterpret_cast<std::uintptr_t>(entry); }
+
+    bool operator==(const PooledString& other) const { return view() == other.view(); }
+
+    friend std::ostream& operator<<(std::ostream& os, const PooledString& s) { return os << s.view(); }
+};
+
+class StringPool {
+private:
+    static constexpr std::size_t kBlockSize = 1 << 20;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    std::size_t left = 0;
+    std::size_t bytes = 0;
+
+    // 去重索引：开放寻址(线性探测)表，槽中存池内记录的地址，空槽为nullptr
+    // 装载率不超过1/2，每条文本约占8~16字节，比std::unordered_set的节点省内存
+    std::vector<const char*> slots;
+    std::size_t count = 0;
+    mutable std::shared_mutex mutex;
+
+    static std::size_t hashOf(std::string_view s) { return std::hash<std::string_view>{}(s); }
+
+    // s所在的槽或应插入的空槽(表非空)
+    std::size_t probe(std::string_view s, std::size_t hash) const {
+        std::size_t mask = slots.size() - 1;
+        for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+            if (!slots[i] || PooledString(slots[i]).view() == s) return i;
+        }
+    }
+
+    const char* lookup(std::string_view s, std::size_t hash) const {
+        return slots.empty() ? nullptr : slots[probe(s, hash)];
+    }
+
+    // 容量翻倍并重新放置已有记录(调用方持有独占锁)
+    void grow() {
+        std::vector<const char*> old(std::max<std::size_t>(64, slots.size() * 2), nullptr);
+        old.swap(slots);
+        for (const char* e : old) {
+            if (!e) continue;
+            std::string_view v = PooledString(e).view();
+            slots[probe(v, hashOf(v))] = e;
+        }
+    }
+
+    // 追加一条记录(调用方持有独占锁)
+    const char* append(std::string_view s) {
+        std::size_t need = sizeof(std::uint32_t) + s.size();
+        need = (need + alignof(std::uint32_t) - 1) & ~(alignof(std::uint32_t) - 1);
+        if (need > left) {
+            std::size_t size = std::max(kBlockSize, need);
+            blocks.emplace_back(new char[size]);
+            cursor = blocks.back().get();
+            left = size;
+        }
+        char* entry = cursor;
+        auto length = static_cast<std::uint32_t>(s.size());
+        std::memcpy(entry, &length, sizeof(length));
+        std::memcpy(entry + sizeof(length), s.data(), s.size());
+        cursor += need;
+        left -= need;
+        bytes += need;
+        return entry;
+    }
+
+public:
+    StringPool() = default;
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // 全局字符串池，Book/Patron的文本字段都存放于此
+    static StringPool& global() {
+        static StringPool pool;
+        return pool;
+    }
+
+    // 存入文本并去重，相同内容返回同一句柄；已有的文本只需共享锁下查一次表
+    PooledString intern(std::string_view s) {
+        if (s.empty()) return PooledString();
+        std::size_t hash = hashOf(s);
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            if (const char* e = lookup(s, hash)) return PooledString(e);
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (const char* e = lookup(s, hash)) return PooledString(e);
+        if ((count + 1) * 2 > slots.size()) grow();
+        const char* e = append(s);
+        slots[probe(s, hash)] = e;
+        ++count;
+        return PooledString(e);
+    }
+
+    // 查找已存入的文本，不存在时返回空句柄
+    PooledString find(std::string_view s) const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return PooledString(lookup(s, hashOf(s)));
+    }
+
+    // 已占用的字节数
+    std::size_t bytesUsed() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return bytes;
+    }
+
+    // 去重后的文本数
+    std::size_t internedCount() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return count;
+    }
+};
+
+#endif // STRING_POOL_H
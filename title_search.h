@@ -0,0 +1,287 @@
+#ifndef TITLE_SEARCH_H
+#define TITLE_SEARCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "transaction_log.h"
+
+// 书名/作者全文检索：基于字符n-gram的倒排索引
+// 中文没有空格分词，因此以Unicode字符为单位建立一元与二元gram：
+// 单字查询使用一元gram，多字查询使用二元gram求交集，再对候选做子串校验排除误命中。
+// ASCII字母统一转小写，空白与ASCII标点视为分段符，gram不跨段。
+
+// 检索方式
+enum class SearchMode : std::uint8_t {
+    contains,   // 书名或作者包含关键词
+    prefix      // 书名或作者以关键词开头
+};
+
+// 检索命中
+struct SearchHit {
+    BookId book;    // 书籍句柄
+    int score;      // 相关度，越大越靠前
+};
+
+namespace search_detail {
+
+// 解码UTF-8并规范化到out(覆盖原内容，复用其容量)，分段符以0表示(连续分段符合并)
+inline void normalize(std::string_view text, std::u32string& out) {
+    out.clear();
+    out.reserve(text.size());
+    std::size_t i = 0;
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        char32_t cp;
+        std::size_t len;
+        if (c < 0x80) { cp = c; len = 1; }
+        else if ((c >> 5) == 0x6) { cp = c & 0x1F; len = 2; }
+        else if ((c >> 4) == 0xE) { cp = c & 0x0F; len = 3; }
+        else if ((c >> 3) == 0x1E) { cp = c & 0x07; len = 4; }
+        else { ++i; continue; }  // 非法首字节，跳过
+        if (i + len > text.size()) break;
+        for (std::size_t k = 1; k < len; ++k) {
+            cp = (cp << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F);
+        }
+        i += len;
+
+        bool separator = cp < 0x80 && !((cp >= '0' && cp <= '9') || (cp >= 'a' && cp <= 'z') ||
+                                        (cp >= 'A' && cp <= 'Z'));
+        // 全角空格与中文标点也作为分段符
+        separator = separator || cp == 0x3000 || (cp >= 0x3001 && cp <= 0x303F) ||
+                    (cp >= 0xFF01 && cp <= 0xFF0F) || cp == 0x00B7;
+        if (separator) {
+            if (!out.empty() && out.back() != 0) out.push_back(0);
+            continue;
+        }
+        if (cp >= 'A' && cp <= 'Z') cp += 'a' - 'A';
+        out.push_back(cp);
+    }
+    if (!out.empty() && out.back() == 0) out.pop_back();
+}
+
+inline std::u32string normalize(std::string_view text) {
+    std::u32string out;
+    normalize(text, out);
+    return out;
+}
+
+// gram类别，占键的高8位
+enum GramKind : std::uint64_t {
+    titleUnigram = 1,
+    titleBigram = 2,
+    authorUnigram = 3,
+    authorBigram = 4,
+    titleStart = 5,     // 书名首字
+    authorStart = 6     // 作者首字
+};
+
+inline std::uint64_t gramKey(GramKind kind, char32_t a, char32_t b = 0) {
+    return (static_cast<std::uint64_t>(kind) << 56) | (static_cast<std::uint64_t>(a) << 21) | b;
+}
+
+// 收集一段规范化文本的全部gram键
+inline void collectGrams(const std::u32string& text, GramKind unigram, GramKind bigram,
+                         GramKind start, std::vector<std::uint64_t>& keys) {
+    if (!text.empty()) keys.push_back(gramKey(start, text[0]));
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == 0) continue;
+        keys.push_back(gramKey(unigram, text[i]));
+        if (i + 1 < text.size() && text[i + 1] != 0) {
+            keys.push_back(gramKey(bigram, text[i], text[i + 1]));
+        }
+    }
+}
+
+} // namespace search_detail
+
+// 倒排索引
+// 倒排表中保存索引内部的文档号而非书籍句柄：文档号按添加顺序递增，倒排表只需追加即天然有序，
+// 求交集为线性归并。删除只把文档标记为已删除(O(1))，检索时跳过；
+// 已删除的文档超过一半时整体压缩一次，重新编号并清理倒排表，摊还到每次删除仍为常数开销
+class TitleSearchIndex {
+private:
+    using DocId = std::uint32_t;
+    static constexpr std::size_t kMinCompact = 1024;
+
+    std::unordered_map<std::uint64_t, std::vector<DocId>> postings;
+    std::vector<BookId> docs;           // 文档号 -> 书籍句柄，已删除为kInvalidHandle
+    std::vector<DocId> docOfSlot;       // 书籍槽位号 -> 文档号
+    std::size_t removedDocs = 0;
+
+    // 重新编号存活文档并清理倒排表
+    void compact() {
+        std::vector<DocId> remap(docs.size());
+        std::vector<BookId> live;
+        live.reserve(docs.size() - removedDocs);
+        for (DocId d = 0; d < docs.size(); ++d) {
+            if (docs[d] == kInvalidHandle) continue;
+            remap[d] = static_cast<DocId>(live.size());
+            docOfSlot[slotIndex(docs[d])] = remap[d];
+            live.push_back(docs[d]);
+        }
+        for (auto it = postings.begin(); it != postings.end();) {
+            auto& list = it->second;
+            std::size_t kept = 0;
+            for (DocId d : list) {
+                if (docs[d] != kInvalidHandle) list[kept++] = remap[d];
+            }
+            list.resize(kept);
+            if (list.empty()) it = postings.erase(it);
+            else ++it;
+        }
+        docs.swap(live);
+        removedDocs = 0;
+    }
+
+    const std::vector<DocId>* find(std::uint64_t key) const {
+        auto it = postings.find(key);
+        return it == postings.end() ? nullptr : &it->second;
+    }
+
+    // 求查询在某一字段上的候选集(所有gram的倒排表交集)
+    std::vector<DocId> candidates(const std::u32string& query, search_detail::GramKind unigram,
+                                   search_detail::GramKind bigram, search_detail::GramKind start,
+                                   SearchMode mode) const {
+        using namespace search_detail;
+        std::vector<const std::vector<DocId>*> lists;
+        auto need = [&](std::uint64_t key) {
+            const auto* list = find(key);
+            lists.push_back(list);
+            return list != nullptr;
+        };
+
+        bool ok = true;
+        if (mode == SearchMode::prefix) ok = need(gramKey(start, query[0]));
+        std::size_t segmentLength = 0;
+        for (std::size_t i = 0; ok && i <= query.size(); ++i) {
+            if (i < query.size() && query[i] != 0) {
+                if (segmentLength > 0) ok = need(gramKey(bigram, query[i - 1], query[i]));
+                ++segmentLength;
+                continue;
+            }
+            // 单字的段只能使用一元gram
+            if (segmentLength == 1) ok = need(gramKey(unigram, query[i - 1]));
+            segmentLength = 0;
+        }
+        if (!ok || lists.empty()) return {};
+
+        // 从最短的倒排表开始求交集
+        std::sort(lists.begin(), lists.end(),
+                  [](const auto* a, const auto* b) { return a->size() < b->size(); });
+        std::vector<DocId> result = *lists[0];
+        std::vector<DocId> next;
+        for (std::size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+            next.clear();
+            std::set_intersection(result.begin(), result.end(), lists[i]->begin(), lists[i]->end(),
+                                  std::back_inserter(next));
+            result.swap(next);
+        }
+        return result;
+    }
+
+    // 子串/前缀校验
+    static bool matches(const std::u32string& text, const std::u32string& query, SearchMode mode) {
+        if (mode == SearchMode::prefix) {
+            return text.compare(0, query.size(), query) == 0;
+        }
+        return text.find(query) != std::u32string::npos;
+    }
+
+public:
+    // 索引一本书
+    void add(BookId id, std::string_view title, std::string_view author) {
+        using namespace search_detail;
+        if (docs.size() == std::numeric_limits<DocId>::max()) compact();
+        DocId doc = static_cast<DocId>(docs.size());
+        docs.push_back(id);
+        if (slotIndex(id) >= docOfSlot.size()) docOfSlot.resize(slotIndex(id) + 1);
+        docOfSlot[slotIndex(id)] = doc;
+
+        std::vector<std::uint64_t> keys;
+        collectGrams(normalize(title), titleUnigram, titleBigram, titleStart, keys);
+        collectGrams(normalize(author), authorUnigram, authorBigram, authorStart, keys);
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        for (std::uint64_t key : keys) postings[key].push_back(doc);
+    }
+
+    // 移除一本书的索引(书籍须已通过add索引)
+    void remove(BookId id) {
+        DocId doc = docOfSlot[slotIndex(id)];
+        if (docs[doc] != id) return;
+        docs[doc] = kInvalidHandle;
+        ++removedDocs;
+        if (removedDocs >= kMinCompact && removedDocs * 2 > docs.size()) compact();
+    }
+
+    // 检索，返回按相关度排序的前limit条
+    // textOf(id, title, author)为回调，以string_view取回书名与作者做校验和打分
+    template <typename TextOf>
+    std::vector<SearchHit> search(std::string_view query, SearchMode mode, std::size_t limit,
+                                  TextOf&& textOf) const {
+        using namespace search_detail;
+        std::u32string q = normalize(query);
+        if (q.empty() || limit == 0) return {};
+
+        std::vector<DocId> inTitle = candidates(q, titleUnigram, titleBigram, titleStart, mode);
+        std::vector<DocId> inAuthor = candidates(q, authorUnigram, authorBigram, authorStart, mode);
+        std::vector<DocId> all;
+        all.reserve(inTitle.size() + inAuthor.size());
+        std::set_union(inTitle.begin(), inTitle.end(), inAuthor.begin(), inAuthor.end(),
+                       std::back_inserter(all));
+
+        std::vector<SearchHit> hits;
+        std::string_view title, author;
+        std::u32string t, a;    // 逐个候选复用的解码缓冲，整次检索只在变长时分配
+        for (DocId doc : all) {
+            BookId id = docs[doc];
+            if (id == kInvalidHandle) continue;  // 已删除
+            textOf(id, title, author);
+            normalize(title, t);
+            normalize(author, a);
+            int score = 0;
+            // 书名命中权重高于作者；完全相同、以关键词开头的更靠前；同等条件下短书名优先
+            if (matches(t, q, mode)) {
+                score += 1000;
+                if (t == q) score += 500;
+                else if (t.compare(0, q.size(), q) == 0) score += 200;
+            }
+            if (matches(a, q, mode)) {
+                score += 400;
+                if (a == q) score += 200;
+            }
+            if (score == 0) continue;  // n-gram误命中
+            score -= static_cast<int>(std::min<std::size_t>(t.size(), 100));
+            hits.push_back({id, score});
+        }
+
+        auto order = [](const SearchHit& x, const SearchHit& y) {
+            return x.score != y.score ? x.score > y.score : x.book < y.book;
+        };
+        if (hits.size() > limit) {
+            std::partial_sort(hits.begin(), hits.begin() + limit, hits.end(), order);
+            hits.resize(limit);
+        } else {
+            std::sort(hits.begin(), hits.end(), order);
+        }
+        return hits;
+    }
+
+    // 清空索引
+    void clear() {
+        postings.clear();
+        docs.clear();
+        docOfSlot.clear();
+        removedDocs = 0;
+    }
+};
+
+#endif // TITLE_SEARCH_H
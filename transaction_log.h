@@ -0,0 +1,467 @@
+#ifndef TRANSACTION_LOG_H
+#define TRANSACTION_LOG_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "date.h"
+#include "history_segment.h"
+#include "slot_map.h"
+
+// 书籍/读者句柄：Library中books/patrons槽位表的句柄(见slot_map.h)
+using BookId = SlotHandle;
+using PatronId = SlotHandle;
+
+// 借阅事件类型
+enum class TransactionType : std::uint8_t {
+    checkout,   // 借出
+    checkin     // 归还
+};
+
+// 借阅记录：定长紧凑记录，只保存句柄，名称等信息在需要时再通过Library解析
+// 书籍或读者被删除后，记录中的句柄随之失效，解析时可以据此识别
+struct Transaction {
+    BookId book;            // 书籍句柄
+    PatronId patron;        // 读者句柄
+    std::uint32_t date;     // 日期，自1970-01-01起的天数(见Date::pack)
+    TransactionType type;   // 事件类型
+};
+
+// 借阅历史查询条件，未给出的条件不限制
+struct HistoryFilter {
+    std::int32_t fromDay = std::numeric_limits<std::int32_t>::min();   // 起始日期(天数，含)
+    std::int32_t toDay = std::numeric_limits<std::int32_t>::max();     // 截止日期(天数，含)
+    std::optional<BookId> book;
+    std::optional<PatronId> patron;
+
+    bool matches(const Transaction& t) const {
+        auto day = static_cast<std::int32_t>(t.date);
+        return day >= fromDay && day <= toDay && (!book || t.book == *book) && (!patron || t.patron == *patron);
+    }
+};
+
+// 历史分段的状态
+enum class SegmentState : std::uint8_t {
+    open,       // 正在追加的最新分段
+    closed,     // 已有更新的分段，尚未封存(仍为列式原始存储)
+    sealed,     // 已压缩封存，只读
+    compacted   // 已压缩为摘要，只保留仍在借的借出记录
+};
+
+inline std::string_view segmentStateName(SegmentState state) {
+    switch (state) {
+        case SegmentState::open: return "open";
+        case SegmentState::closed: return "closed";
+        case SegmentState::sealed: return "sealed";
+        case SegmentState::compacted: return "compacted";
+    }
+    return "";
+}
+
+// 历史分段的概况
+struct HistorySegmentInfo {
+    std::int32_t month = 0;         // 年 * 12 + 月 - 1
+    SegmentState state = SegmentState::open;
+    std::size_t first = 0;          // 首条记录序号
+    std::size_t end = 0;            // 末条记录序号 + 1
+    SegmentStats stats;             // 原始与封存状态下只统计记录数、借出/归还数与日期范围
+    std::size_t encodedBytes = 0;   // 封存后的编码字节数
+    std::size_t rawBytes = 0;       // 同样记录数的列式原始存储字节数
+    bool spilled = false;           // 编码内容是否已写入文件并映射
+    std::size_t retained = 0;       // 压缩后保留的记录数
+
+    int year() const { return month / 12; }
+    int monthOfYear() const { return month % 12 + 1; }
+};
+
+// 借阅记录日志：按月分段，各段内按块分配的列式存储
+// 每块固定容纳kChunkSize条记录，各字段分列连续存放，追加时不会搬移已有数据，顺序扫描某一列时缓存友好
+// 记录的序号在全局连续编号，封存、压缩都不改变已有记录的序号
+//
+// 分段：记录日期进入更晚的月份时开启新分段(日期早于当前分段月份的记录仍记入当前分段，分段按实际日期范围统计)
+//   - seal把已关闭的分段压缩编码(见SealedSegment)，并释放完全落在已封存范围内的原始块；
+//     设置了落盘目录时，封存的分段写入文件并改为内存映射访问
+//   - compact把早于给定日期的已封存分段压缩为摘要，只保留调用方指定的记录(仍在借的借出记录)，其余记录不再可读
+//   - 按日期范围或按书籍/读者扫描时，先按分段的日期范围与布隆过滤器跳过不相关的分段
+//
+// 并发：append内部加锁串行化；读取无锁，只会看到发布时已写完的记录
+//   seal/compact/restoreSummaries会改变已有记录的存放位置，调用方须保证期间没有并发的读取与追加(Library持独占锁)
+class TransactionLog {
+public:
+    static constexpr std::size_t kChunkSize = 4096;
+    static constexpr std::size_t kMaxChunks = 1 << 16;  // 容量上限约2.7亿条
+    static constexpr std::size_t kMaxSegments = 1 << 16;
+
+    // 已压缩分段的摘要
+    struct Summary {
+        std::int32_t month;
+        SegmentStats stats;
+    };
+
+private:
+    struct Chunk {
+        std::array<BookId, kChunkSize> books;
+        std::array<PatronId, kChunkSize> patrons;
+        std::array<std::uint32_t, kChunkSize> dates;
+        std::array<TransactionType, kChunkSize> types;
+    };
+
+    struct Segment {
+        std::int32_t month;
+        std::int32_t monthEnd;          // 下个月第一天(天数)
+        std::size_t first;
+        // 以下统计在追加时更新，读者以relaxed读取
+        std::atomic<std::int32_t> minDay{std::numeric_limits<std::int32_t>::max()};
+        std::atomic<std::int32_t> maxDay{std::numeric_limits<std::int32_t>::min()};
+        std::atomic<std::uint64_t> checkouts{0};
+        std::atomic<std::uint64_t> returns{0};
+        SegmentState state = SegmentState::open;    // open(原始存储)/sealed/compacted，只在独占期间修改
+        std::unique_ptr<SealedSegment> sealed;
+        SegmentStats summary;                       // 压缩后的摘要
+        std::vector<std::pair<std::size_t, Transaction>> retained;  // 压缩后保留的记录，按序号排列
+
+        Segment(std::int32_t m, std::int32_t end, std::size_t f) : month(m), monthEnd(end), first(f) {}
+    };
+
+    // 块目录与分段目录预先定长分配，追加新块/新分段时不会搬移目录，读者因此无需加锁
+    std::unique_ptr<std::atomic<Chunk*>[]> chunks;
+    std::unique_ptr<std::atomic<Segment*>[]> segments;
+    std::atomic<std::size_t> count{0};
+    std::atomic<std::size_t> segmentCount{0};
+    std::mutex appendMutex;
+
+    std::size_t sealedEnd = 0;          // 此序号之前的记录都在已封存或已压缩的分段中
+    std::size_t freedChunks = 0;        // 此块号之前的原始块已释放
+    std::size_t droppedRecords = 0;     // 压缩时丢弃的记录数
+    std::vector<Summary> archived;      // 从快照恢复的摘要(早于现有全部分段)
+    std::string spillDirectory;
+
+    Transaction raw(std::size_t i) const {
+        const Chunk& c = *chunks[i / kChunkSize].load(std::memory_order_acquire);
+        std::size_t slot = i % kChunkSize;
+        return Transaction{c.books[slot], c.patrons[slot], c.dates[slot], c.types[slot]};
+    }
+
+    // 含有序号i的分段下标(segs为分段数，须大于0)
+    std::size_t segmentOf(std::size_t i, std::size_t segs) const {
+        std::size_t lo = 0, hi = segs;
+        while (hi - lo > 1) {
+            std::size_t mid = (lo + hi) / 2;
+            if (segments[mid].load(std::memory_order_relaxed)->first <= i) lo = mid;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    // 第k个分段的结束序号；最后一个分段以limit为界(limit须在读取分段数之前取得)
+    std::size_t segmentEnd(std::size_t k, std::size_t segs, std::size_t limit) const {
+        return k + 1 < segs ? segments[k + 1].load(std::memory_order_acquire)->first : limit;
+    }
+
+    static std::int32_t monthOf(const Date& d) { return d.year() * 12 + d.month() - 1; }
+
+    static Date monthStart(std::int32_t month) { return Date(month / 12, month % 12 + 1, 1); }
+
+    // 分段的日期范围与过滤器是否可能含有满足条件的记录
+    static bool mayMatch(const Segment& s, const HistoryFilter& filter) {
+        std::int32_t lo, hi;
+        if (s.state == SegmentState::compacted) {
+            if (s.retained.empty()) return false;
+            lo = s.summary.minDay;
+            hi = s.summary.maxDay;
+        } else {
+            lo = s.minDay.load(std::memory_order_relaxed);
+            hi = s.maxDay.load(std::memory_order_relaxed);
+        }
+        if (hi < filter.fromDay || lo > filter.toDay) return false;
+        if (s.state == SegmentState::sealed) {
+            if (filter.book && !s.sealed->mayContainBook(*filter.book)) return false;
+            if (filter.patron && !s.sealed->mayContainPatron(*filter.patron)) return false;
+        }
+        return true;
+    }
+
+    HistorySegmentInfo describe(std::size_t k, std::size_t segs, std::size_t limit) const {
+        const Segment& s = *segments[k].load(std::memory_order_acquire);
+        HistorySegmentInfo info;
+        info.month = s.month;
+        info.state = s.state == SegmentState::open && k + 1 < segs ? SegmentState::closed : s.state;
+        info.first = s.first;
+        info.end = segmentEnd(k, segs, limit);
+        info.rawBytes = (info.end - info.first) * (sizeof(BookId) + sizeof(PatronId) + sizeof(std::uint32_t) +
+                                                   sizeof(TransactionType));
+        if (s.state == SegmentState::compacted) {
+            info.stats = s.summary;
+            info.retained = s.retained.size();
+            return info;
+        }
+        info.stats.records = info.end - info.first;
+        info.stats.checkouts = s.checkouts.load(std::memory_order_relaxed);
+        info.stats.returns = s.returns.load(std::memory_order_relaxed);
+        info.stats.minDay = s.minDay.load(std::memory_order_relaxed);
+        info.stats.maxDay = s.maxDay.load(std::memory_order_relaxed);
+        if (s.state == SegmentState::sealed) {
+            info.stats = s.sealed->stats();
+            info.encodedBytes = s.sealed->encodedBytes();
+            info.spilled = s.sealed->isSpilled();
+        }
+        return info;
+    }
+
+    // 封存第k个分段，其记录为[first, end)
+    void sealSegment(Segment& s, std::size_t end) {
+        s.sealed = std::make_unique<SealedSegment>(end - s.first, static_cast<std::uint8_t>(TransactionType::checkout),
+            [&](std::size_t i, SlotHandle& book, SlotHandle& patron, std::uint32_t& date, std::uint8_t& type) {
+                Transaction t = raw(s.first + i);
+                book = t.book;
+                patron = t.patron;
+                date = t.date;
+                type = static_cast<std::uint8_t>(t.type);
+            });
+        if (!spillDirectory.empty()) {
+            Date start = monthStart(s.month);
+            char name[64];
+            std::snprintf(name, sizeof(name), "/%04d-%02d-%zu.seg", start.year(), start.month(), s.first);
+            s.sealed->spill(spillDirectory + name);
+        }
+        s.state = SegmentState::sealed;
+    }
+
+public:
+    // 只读前向迭代器，解引用得到记录的值拷贝(已封存的记录逐条解码，批量读取请用scan)
+    class const_iterator {
+    private:
+        const TransactionLog* log;
+        std::size_t pos;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Transaction;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Transaction;
+
+        const_iterator(const TransactionLog* l = nullptr, std::size_t p = 0) : log(l), pos(p) {}
+
+        Transaction operator*() const { return (*log)[pos]; }
+        const_iterator& operator++() { ++pos; return *this; }
+        const_iterator operator++(int) { const_iterator tmp = *this; ++pos; return tmp; }
+        bool operator==(const const_iterator& other) const { return pos == other.pos; }
+        bool operator!=(const const_iterator& other) const { return pos != other.pos; }
+    };
+
+    TransactionLog()
+        : chunks(new std::atomic<Chunk*>[kMaxChunks]()), segments(new std::atomic<Segment*>[kMaxSegments]()) {}
+
+    ~TransactionLog() {
+        std::size_t used = (size() + kChunkSize - 1) / kChunkSize;
+        for (std::size_t i = freedChunks; i < used; ++i) delete chunks[i].load();
+        for (std::size_t i = 0; i < segmentCount.load(); ++i) delete segments[i].load();
+    }
+
+    TransactionLog(const TransactionLog&) = delete;
+    TransactionLog& operator=(const TransactionLog&) = delete;
+
+    // 追加一条记录并返回其序号，可被多个线程同时调用
+    std::size_t append(const Transaction& t) {
+        std::lock_guard<std::mutex> lock(appendMutex);
+        std::size_t n = count.load(std::memory_order_relaxed);
+        std::size_t slot = n % kChunkSize;
+        if (slot == 0) {
+            if (n / kChunkSize == kMaxChunks) {
+                throw std::runtime_error("借阅记录已达容量上限");
+            }
+        }
+        auto day = static_cast<std::int32_t>(t.date);
+        std::size_t segs = segmentCount.load(std::memory_order_relaxed);
+        Segment* s = segs ? segments[segs - 1].load(std::memory_order_relaxed) : nullptr;
+        if (!s || day >= s->monthEnd) {
+            if (segs == kMaxSegments) {
+                throw std::runtime_error("借阅历史分段已达上限");
+            }
+            std::int32_t month = monthOf(Date::unpack(t.date));
+            auto next = new Segment(month, monthStart(month + 1).dayNumber(), n);
+            segments[segs].store(next, std::memory_order_release);
+            // 先发布新分段再发布新的计数，读者取得计数后再读分段数，不会把新分段的记录算进旧分段
+            segmentCount.store(segs + 1, std::memory_order_release);
+            s = next;
+        }
+        if (slot == 0) chunks[n / kChunkSize].store(new Chunk(), std::memory_order_release);
+        Chunk& c = *chunks[n / kChunkSize].load(std::memory_order_relaxed);
+        c.books[slot] = t.book;
+        c.patrons[slot] = t.patron;
+        c.dates[slot] = t.date;
+        c.types[slot] = t.type;
+        if (day < s->minDay.load(std::memory_order_relaxed)) s->minDay.store(day, std::memory_order_relaxed);
+        if (day > s->maxDay.load(std::memory_order_relaxed)) s->maxDay.store(day, std::memory_order_relaxed);
+        (t.type == TransactionType::checkout ? s->checkouts : s->returns).fetch_add(1, std::memory_order_relaxed);
+        // 写完记录后再发布新的计数
+        count.store(n + 1, std::memory_order_release);
+        return n;
+    }
+
+    // 按序号读取一条记录(i必须小于某次size()的返回值)
+    // 已封存的记录需解码所在的块；已压缩而未保留的记录不可读，抛出std::out_of_range
+    Transaction operator[](std::size_t i) const {
+        if (i >= sealedEnd) return raw(i);
+        const Segment& s = *segments[segmentOf(i, segmentCount.load(std::memory_order_acquire))].load();
+        if (s.state == SegmentState::compacted) {
+            auto it = std::lower_bound(s.retained.begin(), s.retained.end(), i,
+                [](const auto& r, std::size_t seq) { return r.first < seq; });
+            if (it == s.retained.end() || it->first != i) {
+                throw std::out_of_range("借阅记录已压缩为摘要");
+            }
+            return it->second;
+        }
+        SegmentBlock block;
+        std::size_t offset = i - s.first;
+        s.sealed->decodeBlock(offset / SealedSegment::kBlockRecords, block);
+        std::size_t k = offset % SealedSegment::kBlockRecords;
+        return Transaction{block.books[k], block.patrons[k], block.dates[k], static_cast<TransactionType>(block.types[k])};
+    }
+
+    // 已追加的记录总数(含已压缩的)
+    std::size_t size() const { return count.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+
+    // 仍可读取的记录数
+    std::size_t storedCount() const { return size() - droppedRecords; }
+
+    // 迭代范围在调用begin/end时确定，期间新追加的记录不可见
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+    // 按序号顺序扫描[from, to)内满足条件的记录，回调f(序号, 记录)，f返回false时停止
+    // 返回停止处的序号(即下一次扫描的起点)，扫描完时返回to；to不得大于调用前取得的size()
+    // 日期范围或布隆过滤器表明不含匹配记录的分段整段跳过；已压缩分段只扫描保留的记录
+    template <typename F>
+    std::size_t scan(const HistoryFilter& filter, std::size_t from, std::size_t to, F&& f) const {
+        std::size_t segs = segmentCount.load(std::memory_order_acquire);
+        if (segs == 0 || from >= to) return to;
+        SegmentBlock block;
+        for (std::size_t k = segmentOf(from, segs); k < segs && from < to; ++k) {
+            const Segment& s = *segments[k].load(std::memory_order_acquire);
+            std::size_t end = std::min(to, segmentEnd(k, segs, to));
+            if (from >= end) continue;
+            if (!mayMatch(s, filter)) {
+                from = end;
+                continue;
+            }
+            if (s.state == SegmentState::compacted) {
+                auto it = std::lower_bound(s.retained.begin(), s.retained.end(), from,
+                    [](const auto& r, std::size_t seq) { return r.first < seq; });
+                for (; it != s.retained.end() && it->first < end; ++it) {
+                    if (filter.matches(it->second) && !f(it->first, it->second)) return it->first;
+                }
+            } else if (s.state == SegmentState::sealed) {
+                for (std::size_t b = (from - s.first) / SealedSegment::kBlockRecords;
+                     s.first + b * SealedSegment::kBlockRecords < end; ++b) {
+                    s.sealed->decodeBlock(b, block);
+                    std::size_t base = s.first + b * SealedSegment::kBlockRecords;
+                    for (std::size_t j = std::max(from, base) - base; j < block.count && base + j < end; ++j) {
+                        Transaction t{block.books[j], block.patrons[j], block.dates[j],
+                                      static_cast<TransactionType>(block.types[j])};
+                        if (filter.matches(t) && !f(base + j, t)) return base + j;
+                    }
+                }
+            } else {
+                for (std::size_t i = from; i < end; ++i) {
+                    Transaction t = raw(i);
+                    if (filter.matches(t) && !f(i, t)) return i;
+                }
+            }
+            from = end;
+        }
+        return to;
+    }
+
+    // 设置封存分段的落盘目录(须已存在)，空串表示保留在内存中；只影响之后封存的分段
+    void setSpillDirectory(std::string directory) { spillDirectory = std::move(directory); }
+
+    // 封存全部已关闭的分段，释放已被封存覆盖的原始块，返回本次封存的分段数
+    std::size_t seal() {
+        std::size_t n = size();
+        std::size_t segs = segmentCount.load(std::memory_order_acquire);
+        std::size_t sealedCount = 0;
+        for (std::size_t k = 0; k + 1 < segs; ++k) {
+            Segment& s = *segments[k].load();
+            std::size_t end = segmentEnd(k, segs, n);
+            if (s.state == SegmentState::open) {
+                sealSegment(s, end);
+                ++sealedCount;
+            }
+            sealedEnd = end;
+        }
+        for (; (freedChunks + 1) * kChunkSize <= sealedEnd; ++freedChunks) {
+            delete chunks[freedChunks].exchange(nullptr);
+        }
+        return sealedCount;
+    }
+
+    // 把最晚记录早于beforeDay的已关闭分段压缩为摘要(先封存)，keep为须保留的记录序号(升序)
+    // 返回被压缩分段压缩后的概况
+    std::vector<HistorySegmentInfo> compact(std::int32_t beforeDay, const std::vector<std::size_t>& keep) {
+        seal();
+        std::size_t n = size();
+        std::size_t segs = segmentCount.load(std::memory_order_acquire);
+        std::vector<HistorySegmentInfo> result;
+        for (std::size_t k = 0; k + 1 < segs; ++k) {
+            Segment& s = *segments[k].load();
+            if (s.state != SegmentState::sealed || s.sealed->stats().maxDay >= beforeDay) continue;
+            std::size_t end = segmentEnd(k, segs, n);
+            auto it = std::lower_bound(keep.begin(), keep.end(), s.first);
+            for (; it != keep.end() && *it < end; ++it) s.retained.emplace_back(*it, (*this)[*it]);
+            s.summary = s.sealed->stats();
+            s.sealed.reset();
+            s.state = SegmentState::compacted;
+            droppedRecords += (end - s.first) - s.retained.size();
+            result.push_back(describe(k, segs, n));
+        }
+        return result;
+    }
+
+    // 依次回调f(概况)：先是从快照恢复的摘要，再是现有的各分段
+    template <typename F>
+    void forEachSegment(F&& f) const {
+        for (const Summary& a : archived) {
+            HistorySegmentInfo info;
+            info.month = a.month;
+            info.state = SegmentState::compacted;
+            info.stats = a.stats;
+            f(static_cast<const HistorySegmentInfo&>(info));
+        }
+        std::size_t n = size();
+        std::size_t segs = segmentCount.load(std::memory_order_acquire);
+        for (std::size_t k = 0; k < segs; ++k) f(static_cast<const HistorySegmentInfo&>(describe(k, segs, n)));
+    }
+
+    // 全部已压缩分段的摘要(写入快照用)
+    std::vector<Summary> summaries() const {
+        std::vector<Summary> result = archived;
+        std::size_t segs = segmentCount.load(std::memory_order_acquire);
+        for (std::size_t k = 0; k < segs; ++k) {
+            const Segment& s = *segments[k].load();
+            if (s.state == SegmentState::compacted) result.push_back(Summary{s.month, s.summary});
+        }
+        return result;
+    }
+
+    // 恢复快照中的摘要
+    void restoreSummaries(std::vector<Summary> list) { archived = std::move(list); }
+};
+
+#endif // TRANSACTION_LOG_H